@@ -0,0 +1,22 @@
+#ifndef ADDRESS_H
+#define ADDRESS_H
+
+#include <stdint.h>
+#include <inttypes.h>
+
+// Width of simulated addresses, shared by the trace, cache and DRAM paths.
+// The default 32-bit build keeps 4-byte cache tags; build with
+// -DADDRESS_64 for traces of 64-bit programs.
+#ifdef ADDRESS_64
+typedef uint64_t address_t;
+#define ADDRESS_BITS 64
+#define ADDRESS_FORMAT "%016" PRIX64
+#define ADDRESS_SCAN "%" SCNx64
+#else
+typedef uint32_t address_t;
+#define ADDRESS_BITS 32
+#define ADDRESS_FORMAT "%08" PRIX32
+#define ADDRESS_SCAN "%" SCNx32
+#endif
+
+#endif // ADDRESS_H
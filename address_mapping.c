@@ -0,0 +1,219 @@
+#include "address_mapping.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Named mappings. A spec lists the fields from the most significant
+// address bits down: row, rank, bank, channel, col and offset (bits the
+// DRAM ignores), each optionally as name:bits. channel, rank and bank
+// default to the organisation's widths and one row without a width takes
+// whatever is left. A term field^row XORs the field with the lowest bits
+// of the row; field^N XORs it with the address bits starting at bit N.
+static const struct {
+    const char* name;
+    const char* spec;
+} builtin_mappings[] = {
+    // Rows of 4KB; consecutive rows spread over channels, ranks and banks
+    { "row_interleaving", "row,channel,rank,bank,col:10,offset:2" },
+    // Consecutive cache blocks go to different channels, then banks
+    { "cache_block_interleaving", "row,rank,bank,channel,col:6" },
+    // Cache-block interleaving with the bank hashed by the row, so blocks
+    // that share a bank in one row spread out in the next
+    { "xor_bank", "row,rank,bank,channel,col:6,bank^row" },
+    // Permutation-based page interleaving: row interleaving with the bank
+    // index XORed with the low row bits, keeping row-buffer locality while
+    // spreading conflicting rows over banks
+    { "permutation", "row,channel,rank,bank,col:10,offset:2,bank^row,channel^row" },
+};
+
+#define NUM_BUILTIN_MAPPINGS ((int)(sizeof(builtin_mappings) / sizeof(builtin_mappings[0])))
+
+// Returns the spec of a named mapping, or NULL.
+const char* builtin_mapping_spec(const char* name) {
+    for (int i = 0; i < NUM_BUILTIN_MAPPINGS; i++) {
+        if (strcmp(name, builtin_mappings[i].name) == 0) {
+            return builtin_mappings[i].spec;
+        }
+    }
+    return NULL;
+}
+
+// Name of the index-th built-in mapping, or NULL past the last one.
+const char* builtin_mapping_name(int index) {
+    return index >= 0 && index < NUM_BUILTIN_MAPPINGS ? builtin_mappings[index].name : NULL;
+}
+
+static const char* field_names[] = { "channel", "rank", "bank", "row", "col" };
+
+static int parse_field(const char* name, size_t length) {
+    for (int i = 0; i < NUM_DRAM_FIELDS; i++) {
+        if (strlen(field_names[i]) == length && strncmp(name, field_names[i], length) == 0) {
+            return i;
+        }
+    }
+    if (length == 6 && strncmp(name, "offset", 6) == 0) {
+        return NUM_DRAM_FIELDS;
+    }
+    return -1;
+}
+
+typedef struct {
+    int field; // NUM_DRAM_FIELDS for offset bits
+    int width; // -1 until known
+} SpecPiece;
+
+typedef struct {
+    int field;
+    int source; // Address bit, or -1 for the low bits of the row
+} SpecXor;
+
+static uint64_t low_mask(int width) {
+    return width >= 64 ? UINT64_MAX : ((uint64_t)1 << width) - 1;
+}
+
+// Compiles a spec (or the name of a built-in mapping) for an organisation
+// with the given channel, rank and bank index widths. Returns 0 and prints
+// why if the spec does not describe a usable mapping.
+int compile_address_mapping(const char* spec, int channel_bits, int rank_bits, int bank_bits, AddressMapping* mapping) {
+    const char* text = builtin_mapping_spec(spec);
+    if (text == NULL) {
+        text = spec;
+    }
+    memset(mapping, 0, sizeof(AddressMapping));
+    strncpy(mapping->spec, spec, sizeof(mapping->spec) - 1);
+
+    SpecPiece pieces[16];
+    SpecXor xors[8];
+    int num_pieces = 0, num_xors = 0;
+    const int default_bits[NUM_DRAM_FIELDS] = { channel_bits, rank_bits, bank_bits, -1, -1 };
+
+    const char* p = text;
+    while (*p != '\0') {
+        while (*p == ',' || *p == ' ' || *p == '\t') {
+            p++;
+        }
+        if (*p == '\0') {
+            break;
+        }
+        const char* start = p;
+        while (*p != '\0' && *p != ',' && *p != ' ' && *p != '\t' && *p != ':' && *p != '^') {
+            p++;
+        }
+        int field = parse_field(start, (size_t)(p - start));
+        if (field < 0) {
+            fprintf(stderr, "DRAM mapping \"%s\": unknown field \"%.*s\"\n", spec, (int)(p - start), start);
+            return 0;
+        }
+        if (*p == '^') {
+            p++;
+            if (field == NUM_DRAM_FIELDS || num_xors == 8) {
+                fprintf(stderr, "DRAM mapping \"%s\": bad hash term\n", spec);
+                return 0;
+            }
+            int source = -1;
+            if (strncmp(p, "row", 3) == 0) {
+                p += 3;
+            } else {
+                char* end;
+                source = (int)strtol(p, &end, 10);
+                if (end == p || source < 0 || source >= ADDRESS_BITS) {
+                    fprintf(stderr, "DRAM mapping \"%s\": bad hash source\n", spec);
+                    return 0;
+                }
+                p = end;
+            }
+            xors[num_xors].field = field;
+            xors[num_xors++].source = source;
+            continue;
+        }
+        int width = field < NUM_DRAM_FIELDS ? default_bits[field] : -1;
+        if (*p == ':') {
+            char* end;
+            width = (int)strtol(p + 1, &end, 10);
+            if (end == p + 1 || width < 0 || width > ADDRESS_BITS) {
+                fprintf(stderr, "DRAM mapping \"%s\": bad width\n", spec);
+                return 0;
+            }
+            p = end;
+        }
+        if (num_pieces == 16) {
+            fprintf(stderr, "DRAM mapping \"%s\": too many fields\n", spec);
+            return 0;
+        }
+        pieces[num_pieces].field = field;
+        pieces[num_pieces++].width = width;
+    }
+
+    // Only one open-ended row is allowed; it takes the remaining bits
+    int used = 0, open_row = -1;
+    for (int i = 0; i < num_pieces; i++) {
+        if (pieces[i].width >= 0) {
+            used += pieces[i].width;
+        } else if (pieces[i].field == FIELD_ROW && open_row < 0) {
+            open_row = i;
+        } else {
+            fprintf(stderr, "DRAM mapping \"%s\": %s needs a width\n", spec,
+                    pieces[i].field < NUM_DRAM_FIELDS ? field_names[pieces[i].field] : "offset");
+            return 0;
+        }
+    }
+    if (used > ADDRESS_BITS) {
+        fprintf(stderr, "DRAM mapping \"%s\" uses %d bits of %d-bit addresses\n", spec, used, ADDRESS_BITS);
+        return 0;
+    }
+    if (open_row >= 0) {
+        pieces[open_row].width = ADDRESS_BITS - used;
+    }
+
+    // Lay the pieces out from bit 0 upwards; lower pieces of a split field
+    // are its lower bits. Rows are ints, so row bits past 31 are dropped.
+    int row_source = -1;
+    int position = 0;
+    for (int i = num_pieces - 1; i >= 0; i--) {
+        int width = pieces[i].width;
+        if (pieces[i].field < NUM_DRAM_FIELDS && width > 0) {
+            FieldMapping* field = &mapping->fields[pieces[i].field];
+            int limit = pieces[i].field == FIELD_ROW ? 31 : 30;
+            int kept = field->width + width > limit ? limit - field->width : width;
+            if (pieces[i].field == FIELD_ROW && row_source < 0) {
+                row_source = position;
+            }
+            if (kept > 0) {
+                if (field->num_slices == MAX_FIELD_SLICES) {
+                    fprintf(stderr, "DRAM mapping \"%s\": %s is split too often\n", spec, field_names[pieces[i].field]);
+                    return 0;
+                }
+                field->slices[field->num_slices++] = (BitSlice){ position, low_mask(kept), field->width };
+                field->width += kept;
+            }
+        }
+        position += width;
+    }
+
+    const int required[NUM_DRAM_FIELDS] = { channel_bits, rank_bits, bank_bits, -1, -1 };
+    for (int f = 0; f < NUM_DRAM_FIELDS; f++) {
+        if (required[f] >= 0 && mapping->fields[f].width != required[f]) {
+            fprintf(stderr, "DRAM mapping \"%s\": %s has %d bits, the organisation needs %d\n",
+                    spec, field_names[f], mapping->fields[f].width, required[f]);
+            return 0;
+        }
+    }
+    if (mapping->fields[FIELD_ROW].width == 0) {
+        fprintf(stderr, "DRAM mapping \"%s\" has no row bits\n", spec);
+        return 0;
+    }
+
+    for (int i = 0; i < num_xors; i++) {
+        FieldMapping* field = &mapping->fields[xors[i].field];
+        int source = xors[i].source >= 0 ? xors[i].source : row_source;
+        if (field->width == 0) {
+            continue; // Nothing to hash, e.g. channel^row with one channel
+        }
+        if (field->num_xors == MAX_FIELD_XORS) {
+            fprintf(stderr, "DRAM mapping \"%s\": too many hash terms for %s\n", spec, field_names[xors[i].field]);
+            return 0;
+        }
+        field->xors[field->num_xors++] = (BitSlice){ source, low_mask(field->width), 0 };
+    }
+    return 1;
+}
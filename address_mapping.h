@@ -0,0 +1,60 @@
+#ifndef ADDRESS_MAPPING_H
+#define ADDRESS_MAPPING_H
+
+#include <stdint.h>
+#include "address.h"
+
+#define MAX_MAPPING_SPEC 128
+#define MAX_FIELD_SLICES 4 // Pieces one field may be split into
+#define MAX_FIELD_XORS 4   // Hash terms XORed into one field
+
+typedef enum {
+    FIELD_CHANNEL,
+    FIELD_RANK,
+    FIELD_BANK,
+    FIELD_ROW,
+    FIELD_COL,
+    NUM_DRAM_FIELDS
+} DramField;
+
+// Contiguous address bits copied into a field: ((address >> shift) & mask) << dest
+typedef struct {
+    int shift;
+    uint64_t mask;
+    int dest;
+} BitSlice;
+
+// How one field of a DRAM location is computed from an address: its
+// slices OR'ed together, then each hash term (address >> shift) & mask
+// XOR'ed in.
+typedef struct {
+    int width;
+    int num_slices;
+    BitSlice slices[MAX_FIELD_SLICES];
+    int num_xors;
+    BitSlice xors[MAX_FIELD_XORS];
+} FieldMapping;
+
+// A mapping spec compiled once into shifts and masks, so translating an
+// address costs a few shifts, ANDs and XORs per field.
+typedef struct {
+    char spec[MAX_MAPPING_SPEC];
+    FieldMapping fields[NUM_DRAM_FIELDS];
+} AddressMapping;
+
+static inline int map_address_field(const FieldMapping* field, address_t address) {
+    uint64_t value = 0;
+    for (int i = 0; i < field->num_slices; i++) {
+        value |= (((uint64_t)address >> field->slices[i].shift) & field->slices[i].mask) << field->slices[i].dest;
+    }
+    for (int i = 0; i < field->num_xors; i++) {
+        value ^= ((uint64_t)address >> field->xors[i].shift) & field->xors[i].mask;
+    }
+    return (int)value;
+}
+
+const char* builtin_mapping_spec(const char* name);
+const char* builtin_mapping_name(int index);
+int compile_address_mapping(const char* spec, int channel_bits, int rank_bits, int bank_bits, AddressMapping* mapping);
+
+#endif // ADDRESS_MAPPING_H
@@ -0,0 +1,193 @@
+#include "benchmark.h"
+#include "simulator.h"
+#include "trace_stream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+static double wall_seconds(void) {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+// Peak resident set size in KB, or 0 where it is not available
+static long peak_rss_kb(void) {
+#ifdef _WIN32
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; // Bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+static void add_measurement(BenchmarkMeasurement* measurements, int* count, const char* workload,
+                            const char* stage, double ns) {
+    if (*count == MAX_BENCH_MEASUREMENTS) {
+        return;
+    }
+    BenchmarkMeasurement* m = &measurements[(*count)++];
+    snprintf(m->workload, sizeof(m->workload), "%s", workload);
+    snprintf(m->stage, sizeof(m->stage), "%s", stage);
+    m->ns = ns;
+}
+
+// Times the cache and DRAM stages on one generated workload
+static void bench_workload(const SimConfig* config, const WorkloadConfig* workload,
+                           BenchmarkMeasurement* measurements, int* count) {
+    address_t* addresses;
+    unsigned char* types;
+    long long n = generate_workload(workload, &addresses, &types);
+
+    Simulator* simulator = create_simulator(config);
+    double start = wall_seconds();
+    for (long long i = 0; i < n; i += TRACE_CHUNK_SIZE) {
+        int chunk = n - i < TRACE_CHUNK_SIZE ? (int)(n - i) : TRACE_CHUNK_SIZE;
+        simulator_step_batch(simulator, addresses + i, types + i, chunk);
+    }
+    double cache_seconds = wall_seconds() - start;
+    const CacheStats* stats = simulator_stats(simulator);
+    double miss_ratio = stats->total_commands > 0 ? (double)stats->misses / (double)stats->total_commands : 0.0;
+    destroy_simulator(simulator);
+
+    DRAM dram;
+    init_dram(&dram, &config->dram);
+    start = wall_seconds();
+    for (long long i = 0; i < n; i++) {
+        simulate_dram_access(&dram, addresses[i]);
+    }
+    double dram_seconds = wall_seconds() - start;
+    free_dram(&dram);
+    free(addresses);
+    free(types);
+
+    double cache_ns = n > 0 ? cache_seconds * 1e9 / (double)n : 0.0;
+    double dram_ns = n > 0 ? dram_seconds * 1e9 / (double)n : 0.0;
+    printf("%-13s %10lld %8.2f%% %10.1f %12.2f %9.1f\n", workload_name(workload->type), n, 100.0 * miss_ratio,
+           cache_ns, cache_ns > 0.0 ? 1e3 / cache_ns : 0.0, dram_ns);
+    add_measurement(measurements, count, workload_name(workload->type), "cache", cache_ns);
+    add_measurement(measurements, count, workload_name(workload->type), "dram", dram_ns);
+}
+
+// Reads "workload,stage,ns" lines as written by save_measurements
+static int load_baseline(const char* filename, BenchmarkMeasurement* baseline) {
+    FILE* file = fopen(filename, "r");
+    if (file == NULL) {
+        perror("Error opening benchmark baseline");
+        return -1;
+    }
+    char line[128];
+    int count = 0;
+    while (fgets(line, sizeof(line), file) && count < MAX_BENCH_MEASUREMENTS) {
+        BenchmarkMeasurement* m = &baseline[count];
+        if (sscanf(line, "%31[^,],%7[^,],%lf", m->workload, m->stage, &m->ns) == 3) {
+            count++;
+        }
+    }
+    fclose(file);
+    return count;
+}
+
+static int save_measurements(const char* filename, const BenchmarkMeasurement* measurements, int count) {
+    FILE* file = fopen(filename, "w");
+    if (file == NULL) {
+        perror("Error opening benchmark output");
+        return 0;
+    }
+    fprintf(file, "workload,stage,ns_per_access\n");
+    for (int i = 0; i < count; i++) {
+        fprintf(file, "%s,%s,%.3f\n", measurements[i].workload, measurements[i].stage, measurements[i].ns);
+    }
+    fclose(file);
+    return 1;
+}
+
+// Returns the number of measurements more than tolerance percent slower
+// than the baseline.
+static int compare_with_baseline(const BenchmarkMeasurement* measurements, int count,
+                                 const BenchmarkMeasurement* baseline, int baseline_count, double tolerance) {
+    int regressions = 0;
+    printf("Against baseline (regression above +%.0f%%):\n", tolerance);
+    for (int i = 0; i < count; i++) {
+        const BenchmarkMeasurement* m = &measurements[i];
+        const BenchmarkMeasurement* b = NULL;
+        for (int j = 0; j < baseline_count && b == NULL; j++) {
+            if (strcmp(baseline[j].workload, m->workload) == 0 && strcmp(baseline[j].stage, m->stage) == 0) {
+                b = &baseline[j];
+            }
+        }
+        if (b == NULL || b->ns <= 0.0) {
+            printf("  %-13s %-5s %9.1f ns (no baseline)\n", m->workload, m->stage, m->ns);
+            continue;
+        }
+        double change = 100.0 * (m->ns - b->ns) / b->ns;
+        int regressed = change > tolerance;
+        regressions += regressed;
+        printf("  %-13s %-5s %9.1f ns vs %9.1f ns %+7.1f%%%s\n", m->workload, m->stage, m->ns, b->ns, change,
+               regressed ? "  REGRESSION" : "");
+    }
+    return regressions;
+}
+
+// Runs every synthetic workload with accesses accesses through the
+// configured hierarchy and times the parser on trace_file (skipped if it
+// cannot be opened). Returns 1 if any stage regressed past tolerance
+// against baseline_file, 0 otherwise.
+int run_benchmarks(const SimConfig* config, const char* trace_file, long long accesses,
+                   const char* baseline_file, const char* save_file, double tolerance) {
+    BenchmarkMeasurement measurements[MAX_BENCH_MEASUREMENTS];
+    BenchmarkMeasurement baseline[MAX_BENCH_MEASUREMENTS];
+    int count = 0;
+    int baseline_count = 0;
+    if (baseline_file != NULL && (baseline_count = load_baseline(baseline_file, baseline)) < 0) {
+        return 1;
+    }
+
+    printf("workload        accesses    miss%%   cache ns  Maccesses/s   dram ns\n");
+    for (int type = 0; type < NUM_WORKLOADS; type++) {
+        WorkloadConfig workload;
+        default_workload_config(&workload, (WorkloadType)type);
+        workload.accesses = accesses;
+        bench_workload(config, &workload, measurements, &count);
+    }
+
+    FILE* trace = trace_file != NULL ? fopen(trace_file, "rb") : NULL;
+    if (trace != NULL) {
+        fclose(trace);
+        address_t* addresses;
+        double start = wall_seconds();
+        long long records = load_trace(trace_file, 1, &addresses, NULL);
+        double seconds = wall_seconds() - start;
+        free(addresses);
+        if (records > 0) {
+            double parse_ns = seconds * 1e9 / (double)records;
+            printf("parse %s: %lld records, %.1f ns per record\n", trace_file, records, parse_ns);
+            add_measurement(measurements, &count, "trace", "parse", parse_ns);
+        }
+    } else {
+        printf("parse: skipped, no trace\n");
+    }
+    long rss = peak_rss_kb();
+    if (rss > 0) {
+        printf("peak RSS: %ld KB\n", rss);
+    }
+
+    if (save_file != NULL && !save_measurements(save_file, measurements, count)) {
+        return 1;
+    }
+    if (baseline_file != NULL) {
+        return compare_with_baseline(measurements, count, baseline, baseline_count, tolerance) > 0;
+    }
+    return 0;
+}
@@ -0,0 +1,23 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "sim_config.h"
+#include "workload.h"
+
+#define BENCH_TOLERANCE 10.0 // Percent slower than the baseline that counts as a regression
+#define MAX_BENCH_MEASUREMENTS 32
+
+// One timed stage: "parse" is the text trace parser (per record),
+// "cache" is full_cache_logic with the DRAM model behind it (per access)
+// and "dram" is simulate_dram_access fed every address directly (per
+// request).
+typedef struct {
+    char workload[32];
+    char stage[8];
+    double ns;
+} BenchmarkMeasurement;
+
+int run_benchmarks(const SimConfig* config, const char* trace_file, long long accesses,
+                   const char* baseline_file, const char* save_file, double tolerance);
+
+#endif // BENCHMARK_H
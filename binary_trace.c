@@ -0,0 +1,292 @@
+// posix_madvise is POSIX, not ISO C
+#define _POSIX_C_SOURCE 200112L
+#include "binary_trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define WRITE_BUFFER_SIZE (1 << 16)
+
+static void put_le32(unsigned char *p, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+static void put_le64(unsigned char *p, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        p[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+static uint32_t get_le32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t get_le64(const unsigned char *p) {
+    return (uint64_t)get_le32(p) | ((uint64_t)get_le32(p + 4) << 32);
+}
+
+static void write_header(FILE *file, uint64_t num_records) {
+    unsigned char header[BINARY_TRACE_HEADER_SIZE];
+    memcpy(header, BINARY_TRACE_MAGIC, 4);
+    put_le32(header + 4, BINARY_TRACE_VERSION);
+    put_le64(header + 8, num_records);
+    put_le32(header + 16, ADDRESS_BITS);
+    put_le32(header + 20, 0);
+    fwrite(header, 1, sizeof(header), file);
+}
+
+// Encodes one record; returns the number of bytes written to out. A 64-bit
+// zigzag delta shifted left by 4 needs 68 bits, so the first byte carries
+// the nibble and the low 3 delta bits and the rest follows as LEB128.
+static int encode_record(unsigned char *out, address_t previous, const TraceAccess *access) {
+#if ADDRESS_BITS == 64
+    int64_t delta = (int64_t)(access->address - previous);
+#else
+    int64_t delta = (int32_t)(access->address - previous);
+#endif
+    uint64_t zigzag = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+    int log2_size = access->size >= 8 ? 3 : access->size >= 4 ? 2 : access->size >= 2 ? 1 : 0;
+    unsigned char first = (unsigned char)(TRACE_ACCESS(access->type, log2_size) | ((zigzag & 7) << 4));
+    uint64_t value = zigzag >> 3;
+    int length = 0;
+    if (value == 0) {
+        out[length++] = first;
+        return length;
+    }
+    out[length++] = (unsigned char)(first | 0x80);
+    while (value >= 0x80) {
+        out[length++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = (unsigned char)value;
+    return length;
+}
+
+// Parses a text trace once and writes it as a binary trace. Returns the
+// number of records written, or -1 on error.
+long long convert_trace_to_binary(const char *text_filename, const char *binary_filename) {
+    FILE *inputFile = fopen(text_filename, "r");
+    if (inputFile == NULL) {
+        perror("Error opening input file");
+        return -1;
+    }
+    FILE *outputFile = fopen(binary_filename, "wb");
+    if (outputFile == NULL) {
+        perror("Error opening output file");
+        fclose(inputFile);
+        return -1;
+    }
+
+    write_header(outputFile, 0);
+
+    TraceResolver resolver;
+    init_trace_resolver(&resolver);
+    unsigned char buffer[WRITE_BUFFER_SIZE];
+    size_t used = 0;
+    uint64_t num_records = 0;
+    address_t previous = 0;
+    char line[MAX_LINE_LENGTH];
+    TraceOp op;
+    TraceAccess access;
+    int more = 1;
+
+    while (more) {
+        int ready;
+        if (fgets(line, sizeof(line), inputFile)) {
+            size_t length = strlen(line);
+            if (length > 0 && line[length - 1] == '\n') {
+                line[length - 1] = '\0';  // Remove newline character
+            }
+            decode_command(line, &op);
+            ready = resolve_trace_line(&resolver, &op, &access);
+        } else {
+            ready = flush_trace_resolver(&resolver, &access);
+            more = 0;
+        }
+        if (!ready) {
+            continue;
+        }
+        if (used + 10 > sizeof(buffer)) {
+            fwrite(buffer, 1, used, outputFile);
+            used = 0;
+        }
+        used += (size_t)encode_record(buffer + used, previous, &access);
+        previous = access.address;
+        num_records++;
+    }
+    fwrite(buffer, 1, used, outputFile);
+    fclose(inputFile);
+
+    // Now that the count is known, fill it into the header
+    rewind(outputFile);
+    write_header(outputFile, num_records);
+    if (ferror(outputFile)) {
+        fprintf(stderr, "Error writing %s\n", binary_filename);
+        fclose(outputFile);
+        return -1;
+    }
+    fclose(outputFile);
+    return (long long)num_records;
+}
+
+int is_binary_trace(const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        return 0;
+    }
+    char magic[4];
+    int matches = fread(magic, 1, 4, file) == 4 && memcmp(magic, BINARY_TRACE_MAGIC, 4) == 0;
+    fclose(file);
+    return matches;
+}
+
+BinaryTrace* open_binary_trace(const char *filename) {
+    BinaryTrace *trace = (BinaryTrace *)malloc(sizeof(BinaryTrace));
+    if (trace == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "Error opening input file %s\n", filename);
+        free(trace);
+        return NULL;
+    }
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file, &file_size);
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    const unsigned char *data = mapping ? (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (data == NULL) {
+        fprintf(stderr, "Failed to map %s\n", filename);
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        free(trace);
+        return NULL;
+    }
+    trace->file_handle = file;
+    trace->mapping_handle = mapping;
+    trace->size = (size_t)file_size.QuadPart;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        perror("Error opening input file");
+        free(trace);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < BINARY_TRACE_HEADER_SIZE) {
+        fprintf(stderr, "%s is not a binary trace\n", filename);
+        close(fd);
+        free(trace);
+        return NULL;
+    }
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("Failed to map input file");
+        free(trace);
+        return NULL;
+    }
+    posix_madvise(data, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+    trace->size = (size_t)st.st_size;
+#endif
+    trace->data = (const unsigned char *)data;
+
+    if (trace->size < BINARY_TRACE_HEADER_SIZE || memcmp(trace->data, BINARY_TRACE_MAGIC, 4) != 0 ||
+        get_le32(trace->data + 4) != BINARY_TRACE_VERSION) {
+        fprintf(stderr, "%s is not a version %d binary trace\n", filename, BINARY_TRACE_VERSION);
+        close_binary_trace(trace);
+        return NULL;
+    }
+    uint32_t address_bits = get_le32(trace->data + 16);
+    if (address_bits != 32 && address_bits != 64) {
+        fprintf(stderr, "%s has unsupported %u-bit addresses\n", filename, address_bits);
+        close_binary_trace(trace);
+        return NULL;
+    }
+    if (address_bits > ADDRESS_BITS) {
+        fprintf(stderr, "%s has 64-bit addresses; rebuild with -DADDRESS_64\n", filename);
+        close_binary_trace(trace);
+        return NULL;
+    }
+    trace->address_mask = (address_t)(address_bits == 64 ? UINT64_MAX : UINT32_MAX);
+    trace->num_records = get_le64(trace->data + 8);
+    trace->end = trace->data + trace->size;
+    rewind_binary_trace(trace);
+    return trace;
+}
+
+static int truncated_trace(const BinaryTrace *trace) {
+    fprintf(stderr, "Binary trace is truncated: it ends after %llu of its %llu records\n",
+            (unsigned long long)trace->decoded, (unsigned long long)trace->num_records);
+    return -1;
+}
+
+// Decodes the next record straight out of the mapping. Returns 0 at the
+// end of the trace, and -1 if the file holds fewer or more records than
+// its header says.
+int next_binary_access(BinaryTrace *trace, TraceAccess *access) {
+    const unsigned char *p = trace->cursor;
+    if (trace->decoded == trace->num_records) {
+        if (p < trace->end) {
+            fprintf(stderr, "Binary trace has data after its %llu records\n", (unsigned long long)trace->num_records);
+            return -1;
+        }
+        return 0;
+    }
+    if (p >= trace->end) {
+        return truncated_trace(trace);
+    }
+    unsigned char byte = *p++;
+    unsigned char nibble = (unsigned char)(byte & 0xF);
+    uint64_t zigzag = (uint64_t)((byte >> 4) & 7);
+    int shift = 3;
+    while (byte & 0x80) {
+        if (p >= trace->end) {
+            // Cut off in the middle of a record
+            return truncated_trace(trace);
+        }
+        byte = *p++;
+        if (shift < 64) {
+            zigzag |= (uint64_t)(byte & 0x7F) << shift;
+        }
+        shift += 7;
+    }
+    uint64_t delta = (zigzag >> 1) ^ (0 - (zigzag & 1));
+    trace->last_address = (trace->last_address + (address_t)delta) & trace->address_mask;
+    access->address = trace->last_address;
+    access->type = (unsigned char)ACCESS_TYPE(nibble);
+    access->size = (unsigned char)ACCESS_SIZE(nibble);
+    trace->cursor = p;
+    trace->decoded++;
+    return 1;
+}
+
+void rewind_binary_trace(BinaryTrace *trace) {
+    trace->cursor = trace->data + BINARY_TRACE_HEADER_SIZE;
+    trace->last_address = 0;
+    trace->decoded = 0;
+}
+
+void close_binary_trace(BinaryTrace *trace) {
+#ifdef _WIN32
+    UnmapViewOfFile(trace->data);
+    CloseHandle(trace->mapping_handle);
+    CloseHandle(trace->file_handle);
+#else
+    munmap((void *)trace->data, trace->size);
+#endif
+    free(trace);
+}
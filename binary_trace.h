@@ -0,0 +1,48 @@
+#ifndef BINARY_TRACE_H
+#define BINARY_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "extract_address_trace.h"
+
+#define BINARY_TRACE_MAGIC "MTRC"
+#define BINARY_TRACE_VERSION 1
+#define BINARY_TRACE_HEADER_SIZE 24
+
+// File layout (all fields little-endian):
+//   0  magic "MTRC"
+//   4  uint32 version
+//   8  uint64 number of records
+//   16 uint32 address bits (32, or 64 from an ADDRESS_64 build)
+//   20 uint32 reserved (0)
+// followed by one LEB128 varint per record holding
+//   (zigzag(address - previous address) << 4) | access
+// (up to 68 bits, so at most 10 bytes, for 64-bit addresses)
+// where access is the TRACE_ACCESS() nibble (type and log2 size).
+
+// Read-only view of a binary trace, mapped into memory. Records are
+// decoded in place, so opening costs the same for any trace length. The
+// record count in the header is checked against the data as it is read.
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+    uint64_t num_records;
+    uint64_t decoded; // Records returned since the last rewind
+    const unsigned char *cursor;
+    const unsigned char *end;
+    address_t last_address;
+    address_t address_mask; // Deltas wrap at the width the trace was written with
+#ifdef _WIN32
+    void *file_handle;
+    void *mapping_handle;
+#endif
+} BinaryTrace;
+
+long long convert_trace_to_binary(const char *text_filename, const char *binary_filename);
+int is_binary_trace(const char *filename);
+BinaryTrace* open_binary_trace(const char *filename);
+int next_binary_access(BinaryTrace *trace, TraceAccess *access);
+void rewind_binary_trace(BinaryTrace *trace);
+void close_binary_trace(BinaryTrace *trace);
+
+#endif // BINARY_TRACE_H
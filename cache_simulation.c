@@ -1,238 +1,1247 @@
 #include "cache_simulation.h"
 #include <stdio.h>
 #include <stdlib.h>
-#include <math.h>
+#include <string.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "dram_simulation.h"
 
-//----------------------------------------------------------------//
-//Global Variables
-unsigned int hits = 0;
-unsigned int misses = 0;
-unsigned int total_commands = 0;
-unsigned int cycles = 0;
-unsigned int DRAM_Cycle = 0;
-unsigned int oldL1Address;
-unsigned int oldL2Address;
-unsigned int oldL3Address;
-unsigned int misses_L1 =0;
-unsigned int misses_L2 =0;
-unsigned int misses_L3 =0;
-unsigned int hit_L1 =0;
-unsigned int hit_L2 =0;
-unsigned int hit_L3 =0;
-// end of global variables
-//----------------------------------------------------------------
+unsigned long long get_total_cycles(const CacheHierarchy* hierarchy) {
+    return hierarchy->stats.cycles;
+}
+
+unsigned long long get_hits(const CacheHierarchy* hierarchy) {
+    return hierarchy->stats.hits;
+}
+
+unsigned long long get_misses(const CacheHierarchy* hierarchy) {
+    return hierarchy->stats.misses;
+}
+
+unsigned long long get_total_commands(const CacheHierarchy* hierarchy) {
+    return hierarchy->stats.total_commands;
+}
+
+static int is_power_of_two(int value) {
+    return value > 0 && (value & (value - 1)) == 0;
+}
+
+static int log2_int(int value) {
+    int bits = 0;
+    while ((1 << bits) < value) {
+        bits++;
+    }
+    return bits;
+}
+
+static const char* policy_names[] = { "lru", "plru", "srrip", "brrip" };
+
+const char* replacement_policy_name(ReplacementPolicy policy) {
+    return policy_names[policy];
+}
+
+int parse_replacement_policy(const char* name, ReplacementPolicy* policy) {
+    for (int i = 0; i < (int)(sizeof(policy_names) / sizeof(policy_names[0])); i++) {
+        if (strcmp(name, policy_names[i]) == 0) {
+            *policy = (ReplacementPolicy)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static const char* write_policy_names[] = { "writeback", "writethrough" };
 
-unsigned int get_total_cycles() {
-    return cycles;
+const char* write_policy_name(WritePolicy policy) {
+    return write_policy_names[policy];
 }
 
-unsigned int get_hits() {
-    return hits;
+int parse_write_policy(const char* name, WritePolicy* policy) {
+    for (int i = 0; i < (int)(sizeof(write_policy_names) / sizeof(write_policy_names[0])); i++) {
+        if (strcmp(name, write_policy_names[i]) == 0) {
+            *policy = (WritePolicy)i;
+            return 1;
+        }
+    }
+    return 0;
 }
 
-unsigned int get_misses() {
-    return misses;
+static const char* inclusion_names[] = { "exclusive", "inclusive", "nine" };
+
+const char* inclusion_policy_name(InclusionPolicy policy) {
+    return inclusion_names[policy];
 }
 
-unsigned int get_total_commands() {
-    return total_commands;
+int parse_inclusion_policy(const char* name, InclusionPolicy* policy) {
+    for (int i = 0; i < (int)(sizeof(inclusion_names) / sizeof(inclusion_names[0])); i++) {
+        if (strcmp(name, inclusion_names[i]) == 0) {
+            *policy = (InclusionPolicy)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int validate_inclusion_config(const InclusionConfig* config) {
+    if (config->victim_entries < 0 || config->victim_entries > MAX_VICTIM_ENTRIES) {
+        fprintf(stderr, "Victim cache entries must be between 0 and %d\n", MAX_VICTIM_ENTRIES);
+        return 0;
+    }
+    if (config->victim_latency < 0 || config->back_invalidate_latency < 0) {
+        fprintf(stderr, "Victim cache and back-invalidation latencies must not be negative\n");
+        return 0;
+    }
+    return 1;
+}
+
+// Returns 1 if the geometry can be simulated, otherwise prints why not.
+int validate_cache_config(const CacheConfig* config, const char* cache_name) {
+    if (!is_power_of_two(config->line_size)) {
+        fprintf(stderr, "%s: line size %d is not a power of two\n", cache_name, config->line_size);
+        return 0;
+    }
+    if (config->associativity < 1 || config->associativity > MAX_ASSOCIATIVITY) {
+        fprintf(stderr, "%s: associativity must be between 1 and %d\n", cache_name, MAX_ASSOCIATIVITY);
+        return 0;
+    }
+    if (config->policy == REPLACE_PLRU && !is_power_of_two(config->associativity)) {
+        fprintf(stderr, "%s: tree-PLRU needs a power-of-two associativity\n", cache_name);
+        return 0;
+    }
+    if (config->size < config->line_size * config->associativity ||
+        !is_power_of_two(config->size / (config->line_size * config->associativity)) ||
+        config->size % (config->line_size * config->associativity) != 0) {
+        fprintf(stderr, "%s: size %d does not give a power-of-two number of sets\n", cache_name, config->size);
+        return 0;
+    }
+    if (config->latency < 0) {
+        fprintf(stderr, "%s: latency %d is negative\n", cache_name, config->latency);
+        return 0;
+    }
+    if (config->prefetch.type != PREFETCH_NONE &&
+        (config->prefetch.degree < 1 || config->prefetch.degree > MAX_PREFETCH_DEGREE)) {
+        fprintf(stderr, "%s: prefetch degree must be between 1 and %d\n", cache_name, MAX_PREFETCH_DEGREE);
+        return 0;
+    }
+    if (config->mshrs < 1 || config->mshrs > MAX_MSHRS) {
+        fprintf(stderr, "%s: MSHRs must be between 1 and %d\n", cache_name, MAX_MSHRS);
+        return 0;
+    }
+    return 1;
 }
 
-CacheLine* initialize_cache(int cache_size) {
-    int num_lines = cache_size / BLOCK_SIZE;
-    CacheLine* cache = (CacheLine*)malloc((size_t)num_lines * sizeof(CacheLine));
-    if (cache == NULL) {
+static void* allocate_array(size_t count, size_t size) {
+    void* array = calloc(count, size);
+    if (array == NULL) {
         fprintf(stderr, "Memory allocation failed\n");
         exit(EXIT_FAILURE);
     }
-    for (int i = 0; i < num_lines; i++) {
-        cache[i].valid = 0;
-        cache[i].tag = 0;
+    return array;
+}
+
+Cache* initialize_cache(const CacheConfig* config) {
+    Cache* cache = (Cache*)allocate_array(1, sizeof(Cache));
+    cache->config = *config;
+    cache->ways = config->associativity;
+    cache->num_lines = config->size / config->line_size;
+    cache->num_sets = cache->num_lines / cache->ways;
+    cache->offset_bits = log2_int(config->line_size);
+    cache->index_bits = log2_int(cache->num_sets);
+    cache->tag_shift = cache->offset_bits + cache->index_bits;
+    cache->index_mask = (1U << cache->index_bits) - 1;
+
+    cache->tags = (address_t*)allocate_array((size_t)cache->num_lines, sizeof(address_t));
+    cache->valid = (uint32_t*)allocate_array((size_t)cache->num_sets, sizeof(uint32_t));
+    cache->dirty = (uint32_t*)allocate_array((size_t)cache->num_sets, sizeof(uint32_t));
+    cache->rank = (unsigned char*)allocate_array((size_t)cache->num_lines, sizeof(unsigned char));
+    if (config->policy == REPLACE_PLRU) {
+        cache->plru = (uint32_t*)allocate_array((size_t)cache->num_sets, sizeof(uint32_t));
+    }
+    if (config->prefetch.type != PREFETCH_NONE) {
+        cache->prefetched = (uint32_t*)allocate_array((size_t)cache->num_sets, sizeof(uint32_t));
+    }
+    // LRU ranks start as a permutation of 0..ways-1 in every set
+    for (int i = 0; i < cache->num_lines; i++) {
+        cache->rank[i] = config->policy == REPLACE_LRU ? (unsigned char)(i % cache->ways) : 0;
     }
     return cache;
 }
 
-void update_cache(CacheLine* cache, unsigned int address, int cache_size) {
-    int index_bits = (int)log2(cache_size / BLOCK_SIZE);
-    unsigned int index_mask = (1U << index_bits) - 1;
-    unsigned int index = (address >> (int)log2(BLOCK_SIZE)) & index_mask;
-    unsigned int tag = address >> (index_bits + (int)log2(BLOCK_SIZE));
-
-    cache[index].valid = 1;
-    cache[index].tag = tag;
+void free_cache(Cache* cache) {
+    free(cache->tags);
+    free(cache->valid);
+    free(cache->dirty);
+    free(cache->rank);
+    free(cache->plru);
+    free(cache->prefetched);
+    free(cache);
 }
 
-void reset_cache(CacheLine* cache, unsigned int address, int cache_size) {
-    int index_bits = (int)log2(cache_size / BLOCK_SIZE);
-    unsigned int index_mask = (1U << index_bits) - 1;
-    unsigned int index = (address >> (int)log2(BLOCK_SIZE)) & index_mask;
+// Compares the tag against every way of the set. The set's tags are
+// contiguous, so SSE2/AVX2 check 4/8 ways per instruction (SSE4.1/AVX2
+// check 2/4 with 64-bit tags).
+int cache_find_way(const Cache* cache, unsigned int set, address_t tag) {
+    const address_t* tags = cache->tags + (size_t)set * (size_t)cache->ways;
+    int ways = cache->ways;
+    uint32_t matches = 0;
+    int way = 0;
+#if ADDRESS_BITS == 64
+#if defined(__AVX2__)
+    __m256i key4 = _mm256_set1_epi64x((long long)tag);
+    for (; way + 4 <= ways; way += 4) {
+        __m256i line_tags = _mm256_loadu_si256((const __m256i*)(tags + way));
+        matches |= (uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(line_tags, key4))) << way;
+    }
+#endif
+#if defined(__SSE4_1__)
+    __m128i key2 = _mm_set1_epi64x((long long)tag);
+    for (; way + 2 <= ways; way += 2) {
+        __m128i line_tags = _mm_loadu_si128((const __m128i*)(tags + way));
+        matches |= (uint32_t)_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(line_tags, key2))) << way;
+    }
+#endif
+#else
+#if defined(__AVX2__)
+    __m256i key8 = _mm256_set1_epi32((int)tag);
+    for (; way + 8 <= ways; way += 8) {
+        __m256i line_tags = _mm256_loadu_si256((const __m256i*)(tags + way));
+        matches |= (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(line_tags, key8))) << way;
+    }
+#endif
+#if defined(__SSE2__)
+    __m128i key4 = _mm_set1_epi32((int)tag);
+    for (; way + 4 <= ways; way += 4) {
+        __m128i line_tags = _mm_loadu_si128((const __m128i*)(tags + way));
+        matches |= (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(line_tags, key4))) << way;
+    }
+#endif
+#endif
+    for (; way < ways; way++) {
+        if (tags[way] == tag) {
+            matches |= 1U << way;
+        }
+    }
+    matches &= cache->valid[set];
+    return matches ? __builtin_ctz(matches) : -1;
+}
 
-    cache[index].valid = 0;
-    cache[index].tag = 0;
+// Marks a way as just used.
+static void touch_way(Cache* cache, unsigned int set, int way) {
+    unsigned char* rank = cache->rank + (size_t)set * (size_t)cache->ways;
+    switch (cache->config.policy) {
+        case REPLACE_LRU: {
+            unsigned char old_rank = rank[way];
+            for (int i = 0; i < cache->ways; i++) {
+                if (rank[i] < old_rank) {
+                    rank[i]++;
+                }
+            }
+            rank[way] = 0;
+            break;
+        }
+        case REPLACE_PLRU: {
+            // Point every node on the path away from this way
+            uint32_t bits = cache->plru[set];
+            int node = 1;
+            for (int level = log2_int(cache->ways) - 1; level >= 0; level--) {
+                int branch = (way >> level) & 1;
+                bits = branch ? bits & ~(1U << node) : bits | (1U << node);
+                node = 2 * node + branch;
+            }
+            cache->plru[set] = bits;
+            break;
+        }
+        case REPLACE_SRRIP:
+        case REPLACE_BRRIP:
+            rank[way] = 0;
+            break;
+    }
 }
 
-void update_cache_L1(CacheLine* L1, unsigned int address) {
-    update_cache(L1, address, L1_SIZE);
+// Sets the state of a newly filled way.
+static void insert_way(Cache* cache, unsigned int set, int way) {
+    switch (cache->config.policy) {
+        case REPLACE_SRRIP:
+            cache->rank[(size_t)set * (size_t)cache->ways + (size_t)way] = 2;
+            break;
+        case REPLACE_BRRIP:
+            // Distant re-reference, except for one fill in 32
+            cache->rank[(size_t)set * (size_t)cache->ways + (size_t)way] = (cache->brrip_fills++ & 31) == 0 ? 2 : 3;
+            break;
+        default:
+            touch_way(cache, set, way);
+            break;
+    }
 }
 
-void update_cache_L2(CacheLine* L2, unsigned int address) {
-    update_cache(L2, address, L2_SIZE);
+// Picks the way to evict from a full set.
+static int choose_victim(Cache* cache, unsigned int set) {
+    unsigned char* rank = cache->rank + (size_t)set * (size_t)cache->ways;
+    switch (cache->config.policy) {
+        case REPLACE_LRU:
+            for (int i = 0; i < cache->ways; i++) {
+                if (rank[i] == cache->ways - 1) {
+                    return i;
+                }
+            }
+            return 0;
+        case REPLACE_PLRU: {
+            uint32_t bits = cache->plru[set];
+            int node = 1;
+            while (node < cache->ways) {
+                node = 2 * node + (int)((bits >> node) & 1);
+            }
+            return node - cache->ways;
+        }
+        default:
+            // RRIP: first way predicted for distant re-reference, aging the
+            // set until one is
+            for (;;) {
+                for (int i = 0; i < cache->ways; i++) {
+                    if (rank[i] >= 3) {
+                        return i;
+                    }
+                }
+                for (int i = 0; i < cache->ways; i++) {
+                    rank[i]++;
+                }
+            }
+    }
 }
 
-void update_cache_L3(CacheLine* L3, unsigned int address) {
-    update_cache(L3, address, L3_SIZE);
+// Brings the line holding address into the cache, or marks it used if it
+// is already there. Returns CACHE_EVICTED_CLEAN or CACHE_EVICTED_DIRTY and
+// stores the evicted line's address in *victim when a valid line had to
+// make room. A filled line starts clean.
+int update_cache(Cache* cache, address_t address, address_t* victim) {
+    unsigned int set = cache_index(cache, address);
+    address_t tag = cache_tag(cache, address);
+    int way = cache_find_way(cache, set, tag);
+    if (way >= 0) {
+        touch_way(cache, set, way);
+        return 0;
+    }
+
+    int evicted = 0;
+    uint32_t free_ways = ~cache->valid[set] & (cache->ways == 32 ? 0xFFFFFFFFU : (1U << cache->ways) - 1);
+    if (free_ways) {
+        way = __builtin_ctz(free_ways);
+    } else {
+        way = choose_victim(cache, set);
+        if (victim != NULL) {
+            *victim = get_full_address(cache, set, cache->tags[(size_t)set * (size_t)cache->ways + (size_t)way]);
+        }
+        evicted = (cache->dirty[set] >> way) & 1 ? CACHE_EVICTED_DIRTY : CACHE_EVICTED_CLEAN;
+    }
+    cache->tags[(size_t)set * (size_t)cache->ways + (size_t)way] = tag;
+    cache->valid[set] |= 1U << way;
+    cache->dirty[set] &= ~(1U << way);
+    if (cache->prefetched != NULL) {
+        cache->prefetched[set] &= ~(1U << way);
+    }
+    insert_way(cache, set, way);
+    return evicted;
 }
 
-int is_in_cache(CacheLine* cache, unsigned int address, int cache_size) {
-    int index_bits = (int)log2(cache_size / BLOCK_SIZE);
-    unsigned int index_mask = (1U << index_bits) - 1;
-    unsigned int index = (address >> (int)log2(BLOCK_SIZE)) & index_mask;
-    unsigned int tag = address >> (index_bits + (int)log2(BLOCK_SIZE));
+void reset_cache(Cache* cache, address_t address) {
+    unsigned int set = cache_index(cache, address);
+    int way = cache_find_way(cache, set, cache_tag(cache, address));
+    if (way >= 0) {
+        cache->valid[set] &= ~(1U << way);
+        cache->dirty[set] &= ~(1U << way);
+        if (cache->prefetched != NULL) {
+            cache->prefetched[set] &= ~(1U << way);
+        }
+        cache->tags[(size_t)set * (size_t)cache->ways + (size_t)way] = 0;
+    }
+}
 
-    return cache[index].valid && (cache[index].tag == tag);
+// Records a write to the line holding address, if it is cached.
+void mark_dirty(Cache* cache, address_t address) {
+    unsigned int set = cache_index(cache, address);
+    int way = cache_find_way(cache, set, cache_tag(cache, address));
+    if (way >= 0) {
+        cache->dirty[set] |= 1U << way;
+    }
 }
 
-int is_valid_bit_set(CacheLine* cache, unsigned int address, int cache_size) {
-    int index_bits = (int)log2(cache_size / BLOCK_SIZE);
-    unsigned int index_mask = (1U << index_bits) - 1;
-    unsigned int index = (address >> (int)log2(BLOCK_SIZE)) & index_mask;
+int is_dirty(const Cache* cache, address_t address) {
+    unsigned int set = cache_index(cache, address);
+    int way = cache_find_way(cache, set, cache_tag(cache, address));
+    return way >= 0 && ((cache->dirty[set] >> way) & 1);
+}
 
-    return cache[index].valid;
+static void mark_prefetched(Cache* cache, address_t address) {
+    unsigned int set = cache_index(cache, address);
+    int way = cache_find_way(cache, set, cache_tag(cache, address));
+    if (way >= 0) {
+        cache->prefetched[set] |= 1U << way;
+    }
 }
 
-int is_in_cache_L1(CacheLine* L1, unsigned int address) {
-    return is_in_cache(L1, address, L1_SIZE);
+// Clears the line's prefetched bit; 1 if it was set.
+static int take_prefetched(Cache* cache, address_t address) {
+    unsigned int set = cache_index(cache, address);
+    int way = cache_find_way(cache, set, cache_tag(cache, address));
+    if (way < 0 || !((cache->prefetched[set] >> way) & 1)) {
+        return 0;
+    }
+    cache->prefetched[set] &= ~(1U << way);
+    return 1;
 }
 
-int is_in_cache_L2(CacheLine* L2, unsigned int address) {
-    return is_in_cache(L2, address, L2_SIZE);
+int is_in_cache(Cache* cache, address_t address) {
+    return cache_find_way(cache, cache_index(cache, address), cache_tag(cache, address)) >= 0;
 }
 
-int is_in_cache_L3(CacheLine* L3, unsigned int address) {
-    return is_in_cache(L3, address, L3_SIZE);
+// 1 when every way of the address's set holds a line
+int is_set_full(Cache* cache, address_t address) {
+    uint32_t all_ways = cache->ways == 32 ? 0xFFFFFFFFU : (1U << cache->ways) - 1;
+    return cache->valid[cache_index(cache, address)] == all_ways;
 }
 /*/
-void print_cache_values(CacheLine* cache, int cache_size, const char* cache_name) {
-    int num_lines = cache_size / BLOCK_SIZE;
+void print_cache_values(Cache* cache, const char* cache_name) {
     printf("%s Cache Contents:\n", cache_name);
-    printf("Index | Valid | Tag\n");
-    for (int i = 0; i < num_lines; i++) {
-        if (cache[i].valid != 0)
-            printf("%5d | %5d | %08X\n", i, cache[i].valid, cache[i].tag);
+    printf("Set | Way | Tag\n");
+    for (int i = 0; i < cache->num_lines; i++) {
+        if (cache->valid[i / cache->ways] & (1U << (i % cache->ways)))
+            printf("%5d | %3d | " ADDRESS_FORMAT "\n", i / cache->ways, i % cache->ways, cache->tags[i]);
     }
 }
 
-void print_cache_info(int cache_size, const char* cache_name) {
-    int num_lines = cache_size / BLOCK_SIZE;
-    int offset_bits = (int)log2(BLOCK_SIZE);
-    int index_bits = (int)log2(num_lines);
-    int tag_bits = ADDRESS_BITS - index_bits - offset_bits;
-    //printf("%s: %d Index Bits, %d Tag Bits, %d Offset Bits, 1 Valid Bit\n",cache_name, index_bits, tag_bits, offset_bits);
+void print_cache_info(Cache* cache, const char* cache_name) {
+    int tag_bits = ADDRESS_BITS - cache->tag_shift;
+    //printf("%s: %d Index Bits, %d Tag Bits, %d Offset Bits, 1 Valid Bit\n",cache_name, cache->index_bits, tag_bits, cache->offset_bits);
 }
 
-void print_index_and_tag(unsigned int address, int cache_size, const char* cache_name) {
-    int index_bits = (int)log2(cache_size / BLOCK_SIZE);
-    unsigned int index_mask = (1U << index_bits) - 1;
-    unsigned int index = (address >> (int)log2(BLOCK_SIZE)) & index_mask;
-    unsigned int tag = address >> (index_bits + (int)log2(BLOCK_SIZE));
+void print_index_and_tag(Cache* cache, address_t address, const char* cache_name) {
+    unsigned int index = cache_index(cache, address);
+    address_t tag = cache_tag(cache, address);
 
     //printf("%s Address %08X: Index = %u, Tag = %08X\n", cache_name, address, index, tag);
 }
 /*/
-unsigned int get_full_address(unsigned int index, unsigned int tag, int cache_size) {
-    int index_bits = (int)log2(cache_size / BLOCK_SIZE);
-    int offset_bits = (int)log2(BLOCK_SIZE);
-
-    unsigned int address = tag << (index_bits + offset_bits);
-    address |= (index << offset_bits);
+address_t get_full_address(Cache* cache, unsigned int index, address_t tag) {
+    address_t address = (address_t)((uint64_t)tag << cache->tag_shift);
+    address |= ((address_t)index << cache->offset_bits);
 
     return address;
 }
 
-void moveToDram(unsigned int address) {
-     cycles += (unsigned int)simulate_dram_access(address);
+// Builds the three levels and the DRAM model with zeroed statistics.
+// Each hierarchy is independent, so several can run on different threads.
+void init_hierarchy(CacheHierarchy* hierarchy, const CacheConfig* l1, const CacheConfig* l2,
+                    const CacheConfig* l3, const DramConfig* dram, const WriteConfig* write) {
+    hierarchy->L1 = initialize_cache(l1);
+    hierarchy->L2 = initialize_cache(l2);
+    hierarchy->L3 = initialize_cache(l3);
+    init_dram(&hierarchy->dram, dram);
+    hierarchy->write = *write;
+    hierarchy->prefetchers[0] = create_prefetcher(&l1->prefetch, l1->line_size);
+    hierarchy->prefetchers[1] = create_prefetcher(&l2->prefetch, l2->line_size);
+    hierarchy->prefetchers[2] = create_prefetcher(&l3->prefetch, l3->line_size);
+    hierarchy->core = NULL;
+    hierarchy->inclusion = (InclusionConfig){ INCLUSION_EXCLUSIVE, 0, VICTIM_CACHE_LATENCY, BACK_INVALIDATE_CYCLES };
+    hierarchy->victim = NULL;
+    hierarchy->tlb = NULL;
+    memset(&hierarchy->stats, 0, sizeof(hierarchy->stats));
+    hierarchy->dram_log = NULL;
+#ifdef INSTRUMENT
+    int num_sets[NUM_CACHE_LEVELS] = { hierarchy->L1->num_sets, hierarchy->L2->num_sets, hierarchy->L3->num_sets };
+    hierarchy->instrument = create_instrumentation(num_sets, hierarchy->L1->offset_bits);
+#endif
+}
+
+void free_hierarchy(CacheHierarchy* hierarchy) {
+    free_cache(hierarchy->L1);
+    free_cache(hierarchy->L2);
+    free_cache(hierarchy->L3);
+    for (int level = 0; level < NUM_CACHE_LEVELS; level++) {
+        destroy_prefetcher(hierarchy->prefetchers[level]);
+    }
+    destroy_core_model(hierarchy->core);
+    if (hierarchy->victim != NULL) {
+        free(hierarchy->victim->entries);
+        free(hierarchy->victim);
+    }
+    destroy_tlb(hierarchy->tlb);
+#ifdef INSTRUMENT
+    destroy_instrumentation(hierarchy->instrument);
+#endif
+    free_dram(&hierarchy->dram);
+}
+
+static Cache* level_cache(const CacheHierarchy* hierarchy, int level) {
+    return level == 0 ? hierarchy->L1 : level == 1 ? hierarchy->L2 : hierarchy->L3;
+}
+
+// Selects how the levels share lines and adds the victim cache, if any.
+// Call before the first access.
+void set_inclusion(CacheHierarchy* hierarchy, const InclusionConfig* config) {
+    hierarchy->inclusion = *config;
+    if (config->victim_entries > 0) {
+        VictimCache* victim = (VictimCache*)allocate_array(1, sizeof(VictimCache));
+        victim->entries = (VictimEntry*)allocate_array((size_t)config->victim_entries, sizeof(VictimEntry));
+        victim->num_entries = config->victim_entries;
+        victim->offset_bits = hierarchy->L1->offset_bits;
+        hierarchy->victim = victim;
+    }
+}
+
+// Puts a translation stage in front of L1 when config enables one. Call
+// before the first access.
+void set_translation(CacheHierarchy* hierarchy, const TlbConfig* config) {
+    if (config->enabled) {
+        hierarchy->tlb = create_tlb(config);
+    }
+}
+
+static int victim_find(const VictimCache* victim, address_t address) {
+    address_t line = address >> victim->offset_bits;
+    for (int i = 0; i < victim->num_entries; i++) {
+        if (victim->entries[i].valid && victim->entries[i].line == line) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int victim_holds(const VictimCache* victim, address_t address) {
+    return victim != NULL && victim_find(victim, address) >= 0;
+}
+
+// Removes the line from the victim cache. Returns CACHE_EVICTED_CLEAN or
+// CACHE_EVICTED_DIRTY if it was there, 0 otherwise.
+static int victim_take(VictimCache* victim, address_t address) {
+    int i = victim != NULL ? victim_find(victim, address) : -1;
+    if (i < 0) {
+        return 0;
+    }
+    victim->entries[i].valid = 0;
+    return victim->entries[i].dirty ? CACHE_EVICTED_DIRTY : CACHE_EVICTED_CLEAN;
+}
+
+// Keeps a line L1 evicted, displacing the least recently inserted entry
+// when full. Returns what update_cache would for the displaced line,
+// whose address goes to *displaced.
+static int victim_insert(VictimCache* victim, address_t address, int dirty, address_t* displaced) {
+    int slot = 0;
+    for (int i = 0; i < victim->num_entries; i++) {
+        if (!victim->entries[i].valid) {
+            slot = i;
+            break;
+        }
+        if (victim->entries[i].used < victim->entries[slot].used) {
+            slot = i;
+        }
+    }
+    VictimEntry* entry = &victim->entries[slot];
+    int evicted = 0;
+    if (entry->valid) {
+        *displaced = (address_t)((uint64_t)entry->line << victim->offset_bits);
+        evicted = entry->dirty ? CACHE_EVICTED_DIRTY : CACHE_EVICTED_CLEAN;
+    }
+    entry->line = address >> victim->offset_bits;
+    entry->used = ++victim->clock;
+    entry->valid = 1;
+    entry->dirty = (unsigned char)dirty;
+    return evicted;
+}
+
+#ifdef INSTRUMENT
+// A demand access found its line at level found (NUM_CACHE_LEVELS = DRAM)
+static void instrument_lookup(CacheHierarchy* hierarchy, address_t address, int found) {
+    unsigned int sets[NUM_CACHE_LEVELS];
+    for (int level = 0; level < NUM_CACHE_LEVELS; level++) {
+        sets[level] = cache_index(level_cache(hierarchy, level), address);
+    }
+    record_instrumented_access(hierarchy->instrument, address, sets, found);
+}
+
+// A fill at level displaced victim
+static void instrument_eviction(CacheHierarchy* hierarchy, int level, address_t victim) {
+    record_instrumented_eviction(hierarchy->instrument, level, cache_index(level_cache(hierarchy, level), victim));
+}
+#else
+#define instrument_lookup(hierarchy, address, found) ((void)0)
+#define instrument_eviction(hierarchy, level, victim) ((void)0)
+#endif
+
+// Sends one read or write request to the DRAM model at cycle issue and
+// returns the cycle it completes.
+static long long issue_memory(CacheHierarchy* hierarchy, address_t address, int write, long long issue) {
+    long long done = dram_access_at(&hierarchy->dram, address, issue);
+    if (write) {
+        hierarchy->stats.dram_writes++;
+    } else {
+        hierarchy->stats.dram_reads++;
+    }
+    if (hierarchy->dram_log != NULL) {
+        record_dram_request(hierarchy->dram_log, address, hierarchy->stats.cycles);
+    }
+    return done;
+}
+
+// Same, for a request the core waits on: issued at the current cycle,
+// returns its latency.
+static unsigned long long access_memory(CacheHierarchy* hierarchy, address_t address, int write) {
+    long long issue = (long long)hierarchy->stats.cycles;
+    long long latency = issue_memory(hierarchy, address, write, issue) - issue;
+    if (hierarchy->dram_log != NULL) {
+        hierarchy->dram_log->stall_cycles += (unsigned long long)latency;
+    }
+    return (unsigned long long)latency;
+}
+
+// Shows the demand access to the prefetcher of each level it reached:
+// levels above found missed and found hit (found is NUM_CACHE_LEVELS when
+// the line came from DRAM). A hit on a prefetched line whose fill is
+// still in flight waits for the rest of it.
+static void observe_levels(CacheHierarchy* hierarchy, address_t address, int found) {
+    for (int level = 0; level <= found && level < NUM_CACHE_LEVELS; level++) {
+        Prefetcher* prefetcher = hierarchy->prefetchers[level];
+        if (prefetcher == NULL) {
+            continue;
+        }
+        PrefetchStats* stats = &hierarchy->stats.prefetch[level];
+        address_t line = address >> prefetcher->line_bits;
+        int hit = level == found;
+        int prefetch_hit = hit && take_prefetched(level_cache(hierarchy, level), address);
+        if (prefetch_hit) {
+            long long now = (long long)hierarchy->stats.cycles;
+            long long ready = prefetch_in_flight(prefetcher, line, now);
+            stats->useful++;
+            if (ready > now) {
+                stats->late++;
+                hierarchy->stats.cycles += (unsigned long long)(ready - now);
+            }
+        } else if (!hit) {
+            stats->demand_misses++;
+            if (prefetch_evicted(prefetcher, line)) {
+                stats->pollution++;
+            }
+        }
+        prefetcher->trigger = (PrefetchTrigger){ line, !hit, prefetch_hit };
+        prefetcher->triggered = 1;
+    }
+}
+
+static void shared_victim(CacheHierarchy* hierarchy, int level, address_t victim, int evicted, int counted);
+
+// Installs a line at level under the inclusive and NINE policies, where
+// the levels below keep their copies.
+static void install_shared(CacheHierarchy* hierarchy, int level, address_t address, int counted) {
+    address_t victim;
+    int evicted = update_cache(level_cache(hierarchy, level), address, &victim);
+    if (evicted) {
+        if (counted) {
+            instrument_eviction(hierarchy, level, victim);
+        }
+        shared_victim(hierarchy, level, victim, evicted, counted);
+    }
+}
+
+// Removes a line an inclusive level evicted from every level above it,
+// including the victim cache. Returns CACHE_EVICTED_DIRTY if any copy
+// held newer data.
+static int back_invalidate(CacheHierarchy* hierarchy, int level, address_t victim, int evicted, int counted) {
+    int removed = 0;
+    for (int upper = 0; upper < level; upper++) {
+        Cache* cache = level_cache(hierarchy, upper);
+        if (is_in_cache(cache, victim)) {
+            if (is_dirty(cache, victim)) {
+                evicted = CACHE_EVICTED_DIRTY;
+            }
+            reset_cache(cache, victim);
+            removed++;
+        }
+    }
+    int held = victim_take(hierarchy->victim, victim);
+    if (held) {
+        evicted = held == CACHE_EVICTED_DIRTY ? CACHE_EVICTED_DIRTY : evicted;
+        removed++;
+    }
+    if (counted && removed > 0) {
+        hierarchy->stats.back_invalidations += (unsigned long long)removed;
+        hierarchy->stats.cycles += (unsigned long long)(removed * hierarchy->inclusion.back_invalidate_latency);
+    }
+    return evicted;
+}
+
+// A line leaving level under the inclusive and NINE policies. L1's victims
+// go to the victim cache first. Clean lines are dropped, since the level
+// below has a copy or can do without one; dirty lines are written into
+// the level below, or to DRAM from the last level.
+static void shared_victim(CacheHierarchy* hierarchy, int level, address_t victim, int evicted, int counted) {
+    if (level == 0 && hierarchy->victim != NULL) {
+        evicted = victim_insert(hierarchy->victim, victim, evicted == CACHE_EVICTED_DIRTY, &victim);
+        if (!evicted) {
+            return;
+        }
+    }
+    if (hierarchy->inclusion.policy == INCLUSION_INCLUSIVE && level > 0) {
+        evicted = back_invalidate(hierarchy, level, victim, evicted, counted);
+    }
+    if (evicted != CACHE_EVICTED_DIRTY) {
+        return;
+    }
+    if (level + 1 < NUM_CACHE_LEVELS) {
+        Cache* lower = level_cache(hierarchy, level + 1);
+        if (!is_in_cache(lower, victim)) {
+            install_shared(hierarchy, level + 1, victim, counted);
+        }
+        mark_dirty(lower, victim);
+    } else if (counted) {
+        moveToDram(hierarchy, victim);
+    }
+}
+
+// Installs a line at level and cascades the victim down. Dirty victims of
+// the last level are written back without stalling the core.
+static void fill_line(CacheHierarchy* hierarchy, int level, address_t address, int dirty, int prefetched) {
+    Cache* cache = level_cache(hierarchy, level);
+    address_t victim;
+    int evicted = update_cache(cache, address, &victim);
+    if (dirty) {
+        mark_dirty(cache, address);
+    }
+    if (prefetched) {
+        mark_prefetched(cache, address);
+        if (evicted) {
+            Prefetcher* prefetcher = hierarchy->prefetchers[level];
+            remember_prefetch_victim(prefetcher, victim >> prefetcher->line_bits);
+        }
+    }
+    if (!evicted) {
+        return;
+    }
+    instrument_eviction(hierarchy, level, victim);
+    if (hierarchy->inclusion.policy != INCLUSION_EXCLUSIVE) {
+        shared_victim(hierarchy, level, victim, evicted, 1);
+        return;
+    }
+    if (level == 0 && hierarchy->victim != NULL) {
+        evicted = victim_insert(hierarchy->victim, victim, evicted == CACHE_EVICTED_DIRTY, &victim);
+        if (!evicted) {
+            return;
+        }
+    }
+    if (level + 1 < NUM_CACHE_LEVELS) {
+        fill_line(hierarchy, level + 1, victim, evicted == CACHE_EVICTED_DIRTY, 0);
+    } else if (evicted == CACHE_EVICTED_DIRTY) {
+        issue_memory(hierarchy, victim, 1, (long long)hierarchy->stats.cycles);
+    }
+}
+
+// Fetches a line into level from the nearest lower level holding it, or
+// from DRAM. Prefetches run off the critical path: they occupy DRAM banks
+// but the core only waits if it needs the line before the fill is done.
+// Under the exclusive policy the line moves out of the lower level; under
+// the others it is also installed in the levels between.
+static void issue_prefetch(CacheHierarchy* hierarchy, int level, address_t line) {
+    Prefetcher* prefetcher = hierarchy->prefetchers[level];
+    PrefetchStats* stats = &hierarchy->stats.prefetch[level];
+    address_t address = (address_t)((uint64_t)line << prefetcher->line_bits);
+    long long now = (long long)hierarchy->stats.cycles;
+    if (is_in_cache(level_cache(hierarchy, level), address) || prefetch_queue_full(prefetcher, now)) {
+        stats->dropped++;
+        return;
+    }
+    long long ready = now;
+    int dirty = 0;
+    int exclusive = hierarchy->inclusion.policy == INCLUSION_EXCLUSIVE;
+    int source = level + 1;
+    for (; source < NUM_CACHE_LEVELS; source++) {
+        Cache* lower = level_cache(hierarchy, source);
+        ready += lower->config.latency;
+        if (is_in_cache(lower, address)) {
+            if (exclusive) {
+                dirty = is_dirty(lower, address);
+                reset_cache(lower, address);
+            }
+            break;
+        }
+    }
+    if (source == NUM_CACHE_LEVELS) {
+        ready = issue_memory(hierarchy, address, 0, ready);
+    }
+    for (int between = source - 1; !exclusive && between > level; between--) {
+        install_shared(hierarchy, between, address, 1);
+    }
+    stats->issued++;
+    prefetch_enqueue(prefetcher, line, ready);
+    fill_line(hierarchy, level, address, dirty, 1);
+}
+
+// Lets every prefetcher the last access triggered request its lines.
+static void run_prefetchers(CacheHierarchy* hierarchy) {
+    for (int level = 0; level < NUM_CACHE_LEVELS; level++) {
+        Prefetcher* prefetcher = hierarchy->prefetchers[level];
+        if (prefetcher == NULL || !prefetcher->triggered) {
+            continue;
+        }
+        address_t lines[MAX_PREFETCH_DEGREE];
+        int count = prefetch_candidates(prefetcher, lines);
+        for (int i = 0; i < count; i++) {
+            issue_prefetch(hierarchy, level, lines[i]);
+        }
+    }
+}
+
+// Writes a dirty line back to DRAM. An out-of-order core leaves it to the
+// write buffer instead of waiting.
+void moveToDram(CacheHierarchy* hierarchy, address_t address) {
+    if (hierarchy->core != NULL) {
+        issue_memory(hierarchy, address, 1, (long long)hierarchy->stats.cycles);
+        return;
+    }
+     hierarchy->stats.cycles += access_memory(hierarchy, address, 1);
     //printf("moveToDram , %08X\n", address);
 }
 
-void hit_miss_finder(CacheLine* L1, CacheLine* L2, CacheLine* L3, unsigned int address) {
-    if (is_in_cache_L1(L1, address)) {
+// Charges the lookup of address level by level. Returns the level that
+// holds the line, or NULL when it has to come from DRAM. Only demand
+// accesses train the prefetchers and are instrumented; page-walk reads
+// are not.
+static Cache* lookup(CacheHierarchy* hierarchy, address_t address, int demand) {
+    Cache* L1 = hierarchy->L1;
+    Cache* L2 = hierarchy->L2;
+    Cache* L3 = hierarchy->L3;
+    CacheStats* stats = &hierarchy->stats;
+    unsigned long long l1_cycles = (unsigned long long)L1->config.latency;
+    unsigned long long l2_cycles = (unsigned long long)L2->config.latency;
+    unsigned long long l3_cycles = (unsigned long long)L3->config.latency;
+    Cache* level;
+    int found;
+
+    if (is_in_cache(L1, address)) {
         //printf("Hit on L1 for address %08X\n", address);
-        hits++;
-        hit_L1++;
-        cycles += L1_cycles;
-    } else if (is_in_cache_L2(L2, address)) {
+        stats->hits++;
+        stats->hit_L1++;
+        stats->cycles += l1_cycles;
+        level = L1;
+        found = 0;
+    } else if (victim_holds(hierarchy->victim, address)) {
+        // A slower L1 hit; the line is swapped back into L1 on the fill
+        stats->hits++;
+        stats->victim_hits++;
+        stats->misses_L1++;
+        stats->cycles += l1_cycles + (unsigned long long)hierarchy->inclusion.victim_latency;
+        level = L1;
+        found = 0;
+    } else if (is_in_cache(L2, address)) {
         //printf("Hit on L2 for address %08X\n", address);
-        hits++;
-        hit_L2++;
-        misses_L1++;
-        cycles += L2_cycles + L1_cycles;
-    } else if (is_in_cache_L3(L3, address)) {
+        stats->hits++;
+        stats->hit_L2++;
+        stats->misses_L1++;
+        stats->cycles += l2_cycles + l1_cycles;
+        level = L2;
+        found = 1;
+    } else if (is_in_cache(L3, address)) {
         //printf("Hit on L3 for address %08X\n", address);
-        hits++;
-        hit_L3++;
-        misses_L1++;
-        misses_L2++;
-        cycles += L3_cycles + L1_cycles + L2_cycles;
+        stats->hits++;
+        stats->hit_L3++;
+        stats->misses_L1++;
+        stats->misses_L2++;
+        stats->cycles += l3_cycles + l1_cycles + l2_cycles;
+        level = L3;
+        found = 2;
     } else {
         //printf("Not found in cache. Upload from DRAM %08X\n", address);
-        misses++;
-        misses_L1++;
-        misses_L2++;
-        misses_L3++;
-        cycles += (unsigned int)simulate_dram_access(address) + L3_cycles + L1_cycles + L2_cycles;
+        stats->misses++;
+        stats->misses_L1++;
+        stats->misses_L2++;
+        stats->misses_L3++;
+        stats->cycles += l3_cycles + l1_cycles + l2_cycles;
+        level = NULL;
+        found = NUM_CACHE_LEVELS;
+    }
+    if (demand) {
+        observe_levels(hierarchy, address, found);
+        instrument_lookup(hierarchy, address, found);
+    }
+    return level;
+}
+
+void hit_miss_finder(CacheHierarchy* hierarchy, address_t address) {
+    if (lookup(hierarchy, address, 1) == NULL) {
+        hierarchy->stats.cycles += access_memory(hierarchy, address, 0);
+    }
+}
+
+// Fills every level from the one holding the line (or DRAM) up to L1; the
+// level that hit only has its recency updated. A line coming back from
+// the victim cache goes to L1 alone.
+static void fill_shared(CacheHierarchy* hierarchy, address_t address, int dirty, int counted) {
+    int found = 0;
+    int held = victim_take(hierarchy->victim, address);
+    if (held) {
+        dirty = dirty || held == CACHE_EVICTED_DIRTY;
+        found = 1;
+    } else {
+        while (found < NUM_CACHE_LEVELS && !is_in_cache(level_cache(hierarchy, found), address)) {
+            found++;
+        }
+        if (found < NUM_CACHE_LEVELS) {
+            update_cache(level_cache(hierarchy, found), address, NULL);
+        }
+    }
+    for (int level = found - 1; level >= 0; level--) {
+        install_shared(hierarchy, level, address, counted);
+    }
+    if (dirty) {
+        mark_dirty(hierarchy->L1, address);
     }
 }
 
-void LRU(CacheLine* L1, CacheLine* L2, CacheLine* L3, unsigned int address) {
-    if (!is_valid_bit_set(L1, address, L1_SIZE)) {
-        update_cache_L1(L1, address);
+// Fills L1 and cascades victims down: L1's victim moves to L2, L2's to L3
+// and L3's is written back to DRAM if it is dirty. A line promoted out of
+// L2/L3 is removed there, so the levels stay mostly exclusive; dirty bits
+// move with the line. dirty marks the L1 copy as written. Without counted
+// the L3 victim is dropped and nothing is recorded. A victim cache sits
+// between L1 and L2. The inclusive and NINE policies go to fill_shared.
+static void fill_levels(CacheHierarchy* hierarchy, address_t address, int dirty, int counted) {
+    Cache* L1 = hierarchy->L1;
+    Cache* L2 = hierarchy->L2;
+    Cache* L3 = hierarchy->L3;
+    address_t oldL1Address, oldL2Address, oldL3Address;
+
+    if (hierarchy->inclusion.policy != INCLUSION_EXCLUSIVE) {
+        fill_shared(hierarchy, address, dirty, counted);
         return;
+    }
+    if (victim_take(hierarchy->victim, address) == CACHE_EVICTED_DIRTY) {
+        dirty = 1;
+    }
+    if (!is_set_full(L1, address) || is_in_cache(L1, address)) {
+        update_cache(L1, address, NULL);
+        if (dirty) {
+            mark_dirty(L1, address);
+        }
+        return;
+    }
+    dirty = dirty || is_dirty(L2, address) || is_dirty(L3, address);
+    int evicted_L1 = update_cache(L1, address, &oldL1Address);
+    if (dirty) {
+        mark_dirty(L1, address);
+    }
+    if (evicted_L1) {
+        if (counted) {
+            instrument_eviction(hierarchy, 0, oldL1Address);
+        }
+        if (hierarchy->victim != NULL) {
+            evicted_L1 = victim_insert(hierarchy->victim, oldL1Address, evicted_L1 == CACHE_EVICTED_DIRTY, &oldL1Address);
+        }
+    }
+    if (evicted_L1) {
+        int evicted_L2 = update_cache(L2, oldL1Address, &oldL2Address);
+        if (evicted_L1 == CACHE_EVICTED_DIRTY) {
+            mark_dirty(L2, oldL1Address);
+        }
+        if (evicted_L2) {
+            if (counted) {
+                instrument_eviction(hierarchy, 1, oldL2Address);
+            }
+            int evicted_L3 = update_cache(L3, oldL2Address, &oldL3Address);
+            if (evicted_L2 == CACHE_EVICTED_DIRTY) {
+                mark_dirty(L3, oldL2Address);
+            }
+            if (evicted_L3 && counted) {
+                instrument_eviction(hierarchy, 2, oldL3Address);
+            }
+            if (evicted_L3 == CACHE_EVICTED_DIRTY && address != oldL3Address && counted) {
+                moveToDram(hierarchy, oldL3Address);
+            }
+        }
+    }
+
+    if (is_in_cache(L2, address)) {
+        reset_cache(L2, address);
+    }
+
+    if (is_in_cache(L3, address)) {
+        reset_cache(L3, address);
+    }
+}
+
+void LRU(CacheHierarchy* hierarchy, address_t address, int dirty) {
+    fill_levels(hierarchy, address, dirty, 1);
+}
+
+// With write-allocate a store fetches its line like a load. Without it, a
+// cached line is updated where it is and a miss is written straight to
+// DRAM. Write-through also sends every store to DRAM.
+static void store(CacheHierarchy* hierarchy, address_t address) {
+    int write_back = hierarchy->write.policy == WRITE_BACK;
+    hierarchy->stats.stores++;
+    if (hierarchy->write.allocate) {
+        hit_miss_finder(hierarchy, address);
+        LRU(hierarchy, address, write_back);
     } else {
-        if (is_in_cache_L1(L1, address))
+        Cache* level = lookup(hierarchy, address, 1);
+        if (level == NULL) {
+            hierarchy->stats.cycles += access_memory(hierarchy, address, 1);
             return;
-        else {
-            unsigned int l1_index = (address >> (int)log2(BLOCK_SIZE)) & ((1U << (int)log2(L1_SIZE / BLOCK_SIZE)) - 1);
-            unsigned int l1_storedTag = L1[l1_index].tag;
-            oldL1Address = get_full_address(l1_index, l1_storedTag, L1_SIZE);
-            update_cache_L1(L1, address);
-            if (!is_valid_bit_set(L2, oldL1Address, L2_SIZE)) {
-                update_cache_L2(L2, oldL1Address);
-            } else {
-                unsigned int l2_index = (oldL1Address >> (int)log2(BLOCK_SIZE)) & ((1U << (int)log2(L2_SIZE / BLOCK_SIZE)) - 1);
-                unsigned int l2_storedTag = L2[l2_index].tag;
-                oldL2Address = get_full_address(l2_index, l2_storedTag, L2_SIZE);
-                update_cache_L2(L2, oldL1Address);
-                if (!is_valid_bit_set(L3, oldL2Address, L3_SIZE)) {
-                    update_cache_L3(L3, oldL2Address);
-                } else {
-                    unsigned int l3_index = (oldL2Address >> (int)log2(BLOCK_SIZE)) & ((1U << (int)log2(L3_SIZE / BLOCK_SIZE)) - 1);
-                    unsigned int l3_storedTag = L3[l3_index].tag;
-                    oldL3Address = get_full_address(l3_index, l3_storedTag, L3_SIZE);
-                    update_cache_L3(L3, oldL2Address);
-                    if (address != oldL3Address)
-                        moveToDram(oldL3Address);
-                }
+        }
+        if (level == hierarchy->L1 && !is_in_cache(level, address)) {
+            // Victim cache hit: the line returns to L1
+            fill_levels(hierarchy, address, write_back, 1);
+        } else {
+            update_cache(level, address, NULL);
+            if (write_back) {
+                mark_dirty(level, address);
             }
         }
     }
+    if (!write_back) {
+        hierarchy->stats.cycles += access_memory(hierarchy, address, 1);
+    }
+}
 
-    if (is_in_cache_L2(L2, address)) {
-        reset_cache(L2, address, L2_SIZE);
+static void run_access(CacheHierarchy* hierarchy, address_t address, int write) {
+    if (write) {
+        store(hierarchy, address);
+    } else {
+        hit_miss_finder(hierarchy, address);
+        LRU(hierarchy, address, 0);
     }
+    run_prefetchers(hierarchy);
+}
 
-    if (is_in_cache_L3(L3, address)) {
-        reset_cache(L3, address, L3_SIZE);
+// Number of levels the access will miss in: 0 for an L1 hit,
+// NUM_CACHE_LEVELS when the line has to come from DRAM.
+static int levels_missed(CacheHierarchy* hierarchy, address_t address) {
+    int level = 0;
+    while (level < NUM_CACHE_LEVELS && !is_in_cache(level_cache(hierarchy, level), address)) {
+        if (level == 0 && victim_holds(hierarchy->victim, address)) {
+            return 0;
+        }
+        level++;
     }
+    return level;
 }
 
-void full_cache_logic(CacheLine* L1, CacheLine* L2, CacheLine* L3, unsigned int address) {
-    hit_miss_finder(L1, L2, L3, address);
-    LRU(L1, L2, L3, address);
-    total_commands++;
+// Reads one page-table entry through the caches. The read moves lines
+// and takes cycles like any load, but it is counted in the TLB statistics
+// rather than in the demand hit and miss counts, and the prefetchers do
+// not see it. With out-of-order timing
+// a miss issues in order with the demand misses and holds MSHRs like
+// them. Each read waits for the one before, so the clock ends up at the
+// cycle the entry arrives.
+static void walk_read(CacheHierarchy* hierarchy, address_t address) {
+    CacheStats* stats = &hierarchy->stats;
+    CacheStats demand = *stats;
+    CoreModel* core = hierarchy->core;
+    address_t line = address >> hierarchy->L1->offset_bits;
+    long long start = (long long)stats->cycles;
+    long long pending = 0;
+    int missed = 0;
+    if (core != NULL) {
+        pending = mshr_in_flight(core, 0, line, start);
+        missed = pending ? 0 : levels_missed(hierarchy, address);
+        if (missed) {
+            stats->cycles = (unsigned long long)core_issue_miss(core, missed, start);
+            stats->timing.mshr_stall_cycles += stats->cycles - (unsigned long long)start;
+        }
+    }
+    long long issue = (long long)stats->cycles;
+    if (lookup(hierarchy, address, 0) == NULL) {
+        stats->cycles += access_memory(hierarchy, address, 0);
+    }
+    LRU(hierarchy, address, 0);
+    if (core != NULL) {
+        long long done = (long long)stats->cycles;
+        if (pending > done) {
+            done = pending;
+        }
+        for (int level = 0; level < missed; level++) {
+            mshr_allocate(core, level, line, issue, done);
+        }
+        if (missed == NUM_CACHE_LEVELS) {
+            record_dram_miss(core, &stats->timing, issue, done);
+        }
+        stats->cycles = (unsigned long long)done;
+    }
+    int served = stats->hit_L1 + stats->victim_hits > demand.hit_L1 + demand.victim_hits ? 0
+               : stats->hit_L2 > demand.hit_L2 ? 1
+               : stats->hit_L3 > demand.hit_L3 ? 2 : 3;
+    stats->tlb.walk_served[served]++;
+    stats->tlb.walk_reads++;
+    stats->hits = demand.hits;
+    stats->misses = demand.misses;
+    stats->misses_L1 = demand.misses_L1;
+    stats->misses_L2 = demand.misses_L2;
+    stats->misses_L3 = demand.misses_L3;
+    stats->hit_L1 = demand.hit_L1;
+    stats->hit_L2 = demand.hit_L2;
+    stats->hit_L3 = demand.hit_L3;
+    stats->victim_hits = demand.victim_hits;
+}
+
+// Translation stage: an L1 TLB hit overlaps the L1 cache access, an L2
+// TLB hit costs its latency and a miss in both also waits for the walk's
+// reads, one after the other. The delay is what the access waits for its
+// physical address from the current clock. Returns the physical address.
+static address_t translate_access(CacheHierarchy* hierarchy, address_t address) {
+    Translation translation;
+    unsigned long long start = hierarchy->stats.cycles;
+    translate(hierarchy->tlb, address, &translation, &hierarchy->stats.tlb);
+    if (translation.level > 0) {
+        hierarchy->stats.cycles += (unsigned long long)hierarchy->tlb->config.l2_latency;
+    }
+    for (int step = 0; step < translation.steps; step++) {
+        walk_read(hierarchy, translation.walk[step]);
+    }
+    record_translation(hierarchy->tlb, &hierarchy->stats.tlb, start, hierarchy->stats.cycles);
+    return translation.physical;
 }
 
-void print_simulation_results() {
-    printf("Total Hits: %u, Misses: %u, Total Commands: %u, Total Cycles: %u\n  Misses L1 : %u , Misses L2 : %u, Misses L3 : %u\n,  Hits L1 : %u , Hits L2 : %u, Hits L3 : %u\n",
-           get_hits(), get_misses(), get_total_commands(), get_total_cycles(), misses_L1,misses_L2,misses_L3,hit_L1,hit_L2,hit_L3);
+// Out-of-order timing. The access issues once the window has room and,
+// for a miss, once each level it misses in has a free MSHR. It runs with
+// the hierarchy clock set to that cycle, so DRAM sees requests overlap. A
+// miss on a line whose L1 fill is still in flight merges with it. Loads
+// leave the window when their data arrives, stores as soon as they issue
+// (store buffer). Afterwards the clock holds the latest retire cycle.
+// With a translation stage the access is ready only once it has its
+// physical address.
+static void timed_access(CacheHierarchy* hierarchy, address_t address, int write) {
+    CoreModel* core = hierarchy->core;
+    TimingStats* timing = &hierarchy->stats.timing;
+    long long dispatch = core_dispatch(core, timing);
+    long long ready = dispatch;
+    if (hierarchy->tlb != NULL) {
+        hierarchy->stats.cycles = (unsigned long long)dispatch;
+        address = translate_access(hierarchy, address);
+        ready = (long long)hierarchy->stats.cycles;
+    }
+    address_t line = address >> hierarchy->L1->offset_bits;
+    long long pending = mshr_in_flight(core, 0, line, ready);
+    int bypass = write && !hierarchy->write.allocate;
+    int missed = pending || bypass ? 0 : levels_missed(hierarchy, address);
+    long long issue = missed ? core_issue_miss(core, missed, ready) : ready;
+    timing->mshr_stall_cycles += (unsigned long long)(issue - ready);
+
+    hierarchy->stats.cycles = (unsigned long long)issue;
+    run_access(hierarchy, address, write);
+    long long done = (long long)hierarchy->stats.cycles;
+    if (pending) {
+        timing->merged++;
+        if (pending > done) {
+            done = pending;
+        }
+    }
+    for (int level = 0; level < missed; level++) {
+        mshr_allocate(core, level, line, issue, done);
+    }
+    if (missed == NUM_CACHE_LEVELS) {
+        record_dram_miss(core, timing, issue, done);
+    }
+    timing->accesses++;
+    timing->latency_cycles += (unsigned long long)(done - dispatch);
+    hierarchy->stats.cycles = (unsigned long long)core_retire(core, write ? issue : done);
+}
+
+// Runs one access; write is set for stores.
+void full_cache_logic(CacheHierarchy* hierarchy, address_t address, int write) {
+    if (hierarchy->core != NULL) {
+        timed_access(hierarchy, address, write);
+    } else {
+        run_access(hierarchy, hierarchy->tlb != NULL ? translate_access(hierarchy, address) : address, write);
+    }
+    hierarchy->stats.total_commands++;
+}
+
+// Bytes of distinct lines held across the levels and the victim cache: a
+// line in several levels counts once, at the highest level holding it.
+// Compared with the summed capacities it shows what duplication costs.
+unsigned long long effective_capacity(const CacheHierarchy* hierarchy) {
+    unsigned long long bytes = 0;
+    const VictimCache* victim = hierarchy->victim;
+    for (int i = 0; victim != NULL && i < victim->num_entries; i++) {
+        bytes += victim->entries[i].valid ? (unsigned long long)hierarchy->L1->config.line_size : 0;
+    }
+    for (int level = 0; level < NUM_CACHE_LEVELS; level++) {
+        Cache* cache = level_cache(hierarchy, level);
+        for (int set = 0; set < cache->num_sets; set++) {
+            for (int way = 0; way < cache->ways; way++) {
+                if (!((cache->valid[set] >> way) & 1)) {
+                    continue;
+                }
+                address_t address = get_full_address(cache, (unsigned int)set, cache->tags[(size_t)set * (size_t)cache->ways + (size_t)way]);
+                int above = level > 0 && victim_holds(victim, address);
+                for (int upper = 0; upper < level && !above; upper++) {
+                    above = is_in_cache(level_cache(hierarchy, upper), address);
+                }
+                if (!above) {
+                    bytes += (unsigned long long)cache->config.line_size;
+                }
+            }
+        }
+    }
+    return bytes;
+}
+
+// Functional warming: leaves the levels holding the lines, replacement
+// state and dirty bits full_cache_logic would, but charges no cycles,
+// sends nothing to DRAM, trains no prefetcher and counts nothing. The
+// TLBs and the page-table lines a walk reads are warmed too.
+void warm_access(CacheHierarchy* hierarchy, address_t address, int write) {
+    int dirty = write && hierarchy->write.policy == WRITE_BACK;
+    if (hierarchy->tlb != NULL) {
+        Translation translation;
+        translate(hierarchy->tlb, address, &translation, NULL);
+        for (int step = 0; step < translation.steps; step++) {
+            fill_levels(hierarchy, translation.walk[step], 0, 0);
+        }
+        address = translation.physical;
+    }
+    if (write && !hierarchy->write.allocate) {
+        for (int level = 0; level < NUM_CACHE_LEVELS; level++) {
+            Cache* cache = level_cache(hierarchy, level);
+            if (is_in_cache(cache, address)) {
+                update_cache(cache, address, NULL);
+                if (dirty) {
+                    mark_dirty(cache, address);
+                }
+                return;
+            }
+        }
+        return;
+    }
+    fill_levels(hierarchy, address, dirty, 0);
+}
+
+void print_simulation_results(const CacheHierarchy* hierarchy) {
+    const CacheStats* stats = &hierarchy->stats;
+    printf("Total Hits: %llu, Misses: %llu, Total Commands: %llu, Total Cycles: %llu\n  Misses L1 : %llu , Misses L2 : %llu, Misses L3 : %llu\n,  Hits L1 : %llu , Hits L2 : %llu, Hits L3 : %llu\n",
+           get_hits(hierarchy), get_misses(hierarchy), get_total_commands(hierarchy), get_total_cycles(hierarchy),
+           stats->misses_L1, stats->misses_L2, stats->misses_L3, stats->hit_L1, stats->hit_L2, stats->hit_L3);
+    printf("  Stores : %llu, DRAM Reads : %llu, DRAM Writes : %llu, Memory Traffic : %llu bytes\n",
+           stats->stores, stats->dram_reads, stats->dram_writes,
+           (stats->dram_reads + stats->dram_writes) * (unsigned long long)hierarchy->L3->config.line_size);
+    unsigned long long nominal = (unsigned long long)hierarchy->L1->config.size + (unsigned long long)hierarchy->L2->config.size +
+                                 (unsigned long long)hierarchy->L3->config.size;
+    if (hierarchy->victim != NULL) {
+        nominal += (unsigned long long)hierarchy->victim->num_entries * (unsigned long long)hierarchy->L1->config.line_size;
+        printf("  Victim Cache : %d entries, Hits : %llu\n", hierarchy->victim->num_entries, stats->victim_hits);
+    }
+    printf("  Inclusion : %s, Back-Invalidations : %llu, Effective Capacity : %llu of %llu bytes\n",
+           inclusion_policy_name(hierarchy->inclusion.policy), stats->back_invalidations,
+           effective_capacity(hierarchy), nominal);
+    for (int level = 0; level < NUM_CACHE_LEVELS; level++) {
+        if (hierarchy->prefetchers[level] != NULL) {
+            print_prefetch_stats(&stats->prefetch[level], level_cache(hierarchy, level)->config.prefetch.type, level + 1, stdout);
+        }
+    }
+    if (hierarchy->core != NULL) {
+        print_timing_stats(&stats->timing, stats->cycles, stdout);
+    }
+    if (hierarchy->tlb != NULL) {
+        print_tlb_stats(hierarchy->tlb, &stats->tlb, stats->cycles, stdout);
+    }
 }
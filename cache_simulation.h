@@ -1,45 +1,203 @@
 #ifndef CACHE_SIMULATION_H
 #define CACHE_SIMULATION_H
 
+#include <stdint.h>
+#include "address.h"
+#include "dram_simulation.h"
+#include "dram_scheduler.h"
+#include "prefetch.h"
+#include "core_model.h"
+#include "instrument.h"
+#include "tlb.h"
+
+// Default geometry, used unless overridden with --config / --set
 #define L1_SIZE (16 * 1024) // 16KB
 #define L2_SIZE (32 * 1024) // 32KB
 #define L3_SIZE (1024 * 1024 * 2) // 2MB
 #define BLOCK_SIZE 64 // Assuming block size is 64 bytes
-#define ADDRESS_BITS 32 // Assuming a 32-bit address space
 
 #define L1_cycles 1 // L1 access time in cycles
 #define L2_cycles 6 // L2 access time in cycles
 #define L3_cycles 30 // L3 access time in cycles
 
+#define MAX_ASSOCIATIVITY 32 // Ways per set are tracked in 32-bit masks
+#define NUM_CACHE_LEVELS 3
+
+typedef enum {
+    REPLACE_LRU,   // True LRU, per-line recency rank
+    REPLACE_PLRU,  // Tree pseudo-LRU, one bit per tree node
+    REPLACE_SRRIP, // Static re-reference interval prediction (2-bit RRPV)
+    REPLACE_BRRIP  // Bimodal RRIP: most fills predicted distant
+} ReplacementPolicy;
+
+typedef enum {
+    WRITE_BACK,   // Stores dirty the line; only dirty victims reach DRAM
+    WRITE_THROUGH // Every store is also written to DRAM; lines stay clean
+} WritePolicy;
+
+// How the hierarchy handles stores
+typedef struct {
+    WritePolicy policy;
+    int allocate; // 1: a store miss fetches the line; 0: it goes straight to DRAM
+} WriteConfig;
+
+typedef enum {
+    INCLUSION_EXCLUSIVE, // Victims cascade down and a promoted line leaves the lower levels
+    INCLUSION_INCLUSIVE, // Each level holds every line above it; evictions back-invalidate
+    INCLUSION_NINE       // Fills go to every level, evictions leave the levels above alone
+} InclusionPolicy;
+
+#define VICTIM_CACHE_LATENCY 1   // Extra cycles of a victim cache hit over an L1 hit
+#define MAX_VICTIM_ENTRIES 64
+#define BACK_INVALIDATE_CYCLES 2 // Per line an inclusive level invalidates above it
+
+// How the levels share lines, and the optional fully associative victim
+// cache that catches L1's evictions
+typedef struct {
+    InclusionPolicy policy;
+    int victim_entries; // 0 = no victim cache
+    int victim_latency;
+    int back_invalidate_latency;
+} InclusionConfig;
+
+typedef struct {
+    address_t line;          // Address >> L1 offset bits
+    unsigned long long used; // Recency stamp
+    unsigned char valid;
+    unsigned char dirty;
+} VictimEntry;
+
+typedef struct {
+    VictimEntry* entries;
+    int num_entries;
+    int offset_bits;
+    unsigned long long clock;
+} VictimCache;
+
+// update_cache results
+#define CACHE_EVICTED_CLEAN 1
+#define CACHE_EVICTED_DIRTY 2
+
+// Geometry and timing of one cache level
+typedef struct {
+    int size;          // Capacity in bytes
+    int line_size;     // Bytes per line
+    int associativity; // Ways per set (1 = direct-mapped)
+    int latency;       // Access time in cycles
+    ReplacementPolicy policy;
+    PrefetchConfig prefetch;
+    int mshrs;         // Misses in flight at once (out-of-order timing only)
+} CacheConfig;
+
+// A set-associative cache level. Shifts and masks are derived from the
+// config once in initialize_cache, so locating a set is a shift and a
+// mask per access. Each set's tags are stored contiguously so the whole
+// set is compared at once; valid and dirty bits are one mask per set.
 typedef struct {
-    int valid; // Valid bit
-    unsigned int tag; // Tag
-} CacheLine;
-
-CacheLine* initialize_cache(int cache_size);
-void update_cache(CacheLine* cache, unsigned int address, int cache_size);
-void reset_cache(CacheLine* cache, unsigned int address, int cache_size);
-void update_cache_L1(CacheLine* L1, unsigned int address);
-void update_cache_L2(CacheLine* L2, unsigned int address);
-void update_cache_L3(CacheLine* L3, unsigned int address);
-int is_in_cache(CacheLine* cache, unsigned int address, int cache_size);
-int is_valid_bit_set(CacheLine* cache, unsigned int address, int cache_size);
-int is_in_cache_L1(CacheLine* L1, unsigned int address);
-int is_in_cache_L2(CacheLine* L2, unsigned int address);
-int is_in_cache_L3(CacheLine* L3, unsigned int address);
-void print_cache_values(CacheLine* cache, int cache_size, const char* cache_name);
-void print_cache_info(int cache_size, const char* cache_name);
-void print_index_and_tag(unsigned int address, int cache_size, const char* cache_name);
-unsigned int get_full_address(unsigned int index, unsigned int tag, int cache_size);
-void moveToDram(unsigned int address);
-void hit_miss_finder(CacheLine* L1, CacheLine* L2, CacheLine* L3, unsigned int address);
-void LRU(CacheLine* L1, CacheLine* L2, CacheLine* L3, unsigned int address);
-void full_cache_logic(CacheLine* L1, CacheLine* L2, CacheLine* L3, unsigned int address);
-void print_simulation_results();
-
-unsigned int get_total_cycles();
-unsigned int get_hits();
-unsigned int get_misses();
-unsigned int get_total_commands();
+    CacheConfig config;
+    int num_lines;
+    int num_sets;
+    int ways;
+    int offset_bits;
+    int index_bits;
+    int tag_shift;           // offset_bits + index_bits
+    unsigned int index_mask;
+    address_t* tags;         // num_sets * ways, set-major
+    uint32_t* valid;         // Per set, bit w = way w holds a line
+    uint32_t* dirty;         // Per set, bit w = way w was written since it was filled
+    uint32_t* prefetched;    // Per set, bit w = way w was prefetched and not yet used (prefetching levels only)
+    unsigned char* rank;     // Per line: LRU recency rank or RRPV
+    uint32_t* plru;          // Per set tree bits (tree-PLRU only)
+    unsigned int brrip_fills; // Drives BRRIP's occasional near insertion
+} Cache;
+
+static inline unsigned int cache_index(const Cache* cache, address_t address) {
+    return (unsigned int)(address >> cache->offset_bits) & cache->index_mask;
+}
+
+static inline address_t cache_tag(const Cache* cache, address_t address) {
+    return (address_t)((uint64_t)address >> cache->tag_shift);
+}
+
+const char* replacement_policy_name(ReplacementPolicy policy);
+int parse_replacement_policy(const char* name, ReplacementPolicy* policy);
+const char* write_policy_name(WritePolicy policy);
+int parse_write_policy(const char* name, WritePolicy* policy);
+const char* inclusion_policy_name(InclusionPolicy policy);
+int parse_inclusion_policy(const char* name, InclusionPolicy* policy);
+int validate_inclusion_config(const InclusionConfig* config);
+int validate_cache_config(const CacheConfig* config, const char* cache_name);
+Cache* initialize_cache(const CacheConfig* config);
+void free_cache(Cache* cache);
+int cache_find_way(const Cache* cache, unsigned int set, address_t tag);
+int update_cache(Cache* cache, address_t address, address_t* victim);
+void reset_cache(Cache* cache, address_t address);
+void mark_dirty(Cache* cache, address_t address);
+int is_dirty(const Cache* cache, address_t address);
+int is_in_cache(Cache* cache, address_t address);
+int is_set_full(Cache* cache, address_t address);
+void print_cache_values(Cache* cache, const char* cache_name);
+void print_cache_info(Cache* cache, const char* cache_name);
+void print_index_and_tag(Cache* cache, address_t address, const char* cache_name);
+address_t get_full_address(Cache* cache, unsigned int index, address_t tag);
+
+typedef struct {
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long total_commands;
+    unsigned long long cycles;
+    unsigned long long misses_L1;
+    unsigned long long misses_L2;
+    unsigned long long misses_L3;
+    unsigned long long hit_L1;
+    unsigned long long hit_L2;
+    unsigned long long hit_L3;
+    unsigned long long stores;
+    unsigned long long dram_reads;  // Line fills
+    unsigned long long dram_writes; // Dirty write-backs and write-through stores
+    PrefetchStats prefetch[NUM_CACHE_LEVELS];
+    TimingStats timing; // Out-of-order timing only
+    unsigned long long victim_hits;        // L1 misses found in the victim cache
+    unsigned long long back_invalidations; // Lines an inclusive level's evictions removed above it
+    TlbStats tlb; // Translation stage only; its walk reads are not in the hit and miss counts
+} CacheStats;
+
+// One simulated memory system: the three levels, the DRAM behind them and
+// the counters of everything run through it
+typedef struct {
+    Cache* L1;
+    Cache* L2;
+    Cache* L3;
+    DRAM dram;
+    WriteConfig write;
+    Prefetcher* prefetchers[NUM_CACHE_LEVELS]; // Per level, NULL when it has none
+    CoreModel* core; // Out-of-order timing; NULL when every access stalls the core
+    InclusionConfig inclusion;
+    VictimCache* victim; // NULL without a victim cache
+    Tlb* tlb; // NULL when trace addresses are used as physical addresses
+    CacheStats stats;
+    DramRequestLog* dram_log; // When set, every DRAM request is recorded here
+#ifdef INSTRUMENT
+    Instrumentation* instrument;
+#endif
+} CacheHierarchy;
+
+void init_hierarchy(CacheHierarchy* hierarchy, const CacheConfig* l1, const CacheConfig* l2,
+                    const CacheConfig* l3, const DramConfig* dram, const WriteConfig* write);
+void free_hierarchy(CacheHierarchy* hierarchy);
+void moveToDram(CacheHierarchy* hierarchy, address_t address);
+void hit_miss_finder(CacheHierarchy* hierarchy, address_t address);
+void LRU(CacheHierarchy* hierarchy, address_t address, int dirty);
+void full_cache_logic(CacheHierarchy* hierarchy, address_t address, int write);
+void warm_access(CacheHierarchy* hierarchy, address_t address, int write);
+void set_inclusion(CacheHierarchy* hierarchy, const InclusionConfig* config);
+void set_translation(CacheHierarchy* hierarchy, const TlbConfig* config);
+unsigned long long effective_capacity(const CacheHierarchy* hierarchy);
+void print_simulation_results(const CacheHierarchy* hierarchy);
+
+unsigned long long get_total_cycles(const CacheHierarchy* hierarchy);
+unsigned long long get_hits(const CacheHierarchy* hierarchy);
+unsigned long long get_misses(const CacheHierarchy* hierarchy);
+unsigned long long get_total_commands(const CacheHierarchy* hierarchy);
 
 #endif // CACHE_SIMULATION_H
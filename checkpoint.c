@@ -0,0 +1,219 @@
+#include "checkpoint.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// The same walk over the simulator saves and restores it, so the two
+// cannot drift apart
+typedef struct {
+    FILE* file;
+    int writing;
+    int failed;
+} SnapshotFile;
+
+static void transfer(SnapshotFile* snapshot, void* data, size_t size) {
+    if (snapshot->failed || size == 0) {
+        return;
+    }
+    size_t done = snapshot->writing ? fwrite(data, 1, size, snapshot->file) : fread(data, 1, size, snapshot->file);
+    if (done != size) {
+        snapshot->failed = 1;
+    }
+}
+
+static void transfer_cache(SnapshotFile* snapshot, Cache* cache) {
+    size_t lines = (size_t)cache->num_lines;
+    size_t sets = (size_t)cache->num_sets;
+    transfer(snapshot, cache->tags, lines * sizeof(address_t));
+    transfer(snapshot, cache->valid, sets * sizeof(uint32_t));
+    transfer(snapshot, cache->dirty, sets * sizeof(uint32_t));
+    if (cache->prefetched != NULL) {
+        transfer(snapshot, cache->prefetched, sets * sizeof(uint32_t));
+    }
+    transfer(snapshot, cache->rank, lines);
+    if (cache->plru != NULL) {
+        transfer(snapshot, cache->plru, sets * sizeof(uint32_t));
+    }
+    transfer(snapshot, &cache->brrip_fills, sizeof(cache->brrip_fills));
+}
+
+static void transfer_dram(SnapshotFile* snapshot, DRAM* dram) {
+    size_t ranks = (size_t)(dram->config.channels * dram->config.ranks);
+    transfer(snapshot, dram->banks, (size_t)dram->num_banks * sizeof(DRAMBank));
+    transfer(snapshot, dram->ranks, ranks * sizeof(DRAMRank));
+    transfer(snapshot, dram->channels, (size_t)dram->config.channels * sizeof(DRAMChannel));
+    transfer(snapshot, &dram->time, sizeof(dram->time));
+    transfer(snapshot, &dram->last_accessed_address, sizeof(dram->last_accessed_address));
+    transfer(snapshot, &dram->stats, sizeof(dram->stats));
+}
+
+static void transfer_prefetcher(SnapshotFile* snapshot, Prefetcher* prefetcher) {
+    transfer(snapshot, prefetcher->state, prefetcher->ops->state_size);
+    transfer(snapshot, prefetcher->queue, sizeof(prefetcher->queue));
+    transfer(snapshot, &prefetcher->queued, sizeof(prefetcher->queued));
+    transfer(snapshot, prefetcher->evicted, PREFETCH_FILTER_SIZE * sizeof(address_t));
+    transfer(snapshot, &prefetcher->trigger, sizeof(prefetcher->trigger));
+    transfer(snapshot, &prefetcher->triggered, sizeof(prefetcher->triggered));
+}
+
+static void transfer_core(SnapshotFile* snapshot, CoreModel* core) {
+    transfer(snapshot, core->rob, (size_t)core->config.rob_size * sizeof(long long));
+    transfer(snapshot, &core->instructions, sizeof(core->instructions));
+    transfer(snapshot, &core->dispatch_cycle, sizeof(core->dispatch_cycle));
+    transfer(snapshot, &core->dispatched, sizeof(core->dispatched));
+    transfer(snapshot, &core->retire_cycle, sizeof(core->retire_cycle));
+    transfer(snapshot, &core->retired, sizeof(core->retired));
+    for (int level = 0; level < 3; level++) {
+        transfer(snapshot, core->mshrs[level], (size_t)core->num_mshrs[level] * sizeof(MshrEntry));
+    }
+    transfer(snapshot, &core->miss_issue, sizeof(core->miss_issue));
+    transfer(snapshot, &core->dram_busy_until, sizeof(core->dram_busy_until));
+}
+
+// The page map's size depends on the run, so it is saved first and the
+// map of a simulator being restored is resized to match
+static void transfer_tlb(SnapshotFile* snapshot, Tlb* tlb) {
+    TlbLevel* levels[2] = { &tlb->l1, &tlb->l2 };
+    for (int i = 0; i < 2; i++) {
+        transfer(snapshot, levels[i]->pages, (size_t)levels[i]->entries * sizeof(uint64_t));
+        transfer(snapshot, levels[i]->frames, (size_t)levels[i]->entries * sizeof(uint64_t));
+        transfer(snapshot, levels[i]->used, (size_t)levels[i]->entries * sizeof(unsigned long long));
+    }
+    transfer(snapshot, &tlb->clock, sizeof(tlb->clock));
+    uint64_t capacity = tlb->map.capacity;
+    uint64_t count = tlb->map.count;
+    transfer(snapshot, &capacity, sizeof(capacity));
+    transfer(snapshot, &count, sizeof(count));
+    if (!snapshot->writing && !snapshot->failed) {
+        if (capacity == 0 || (capacity & (capacity - 1)) != 0 || count >= capacity) {
+            snapshot->failed = 1;
+            return;
+        }
+        resize_page_map(&tlb->map, (size_t)capacity);
+        tlb->map.count = (size_t)count;
+    }
+    transfer(snapshot, tlb->map.keys, tlb->map.capacity * sizeof(uint64_t));
+    transfer(snapshot, tlb->map.values, tlb->map.capacity * sizeof(uint64_t));
+    transfer(snapshot, &tlb->next_frame, sizeof(tlb->next_frame));
+    if (tlb->frame_used != NULL) {
+        transfer(snapshot, tlb->frame_used, (size_t)(tlb->num_frames / 8 + 1));
+    }
+    transfer(snapshot, &tlb->table_next, sizeof(tlb->table_next));
+    transfer(snapshot, &tlb->rng, sizeof(tlb->rng));
+    transfer(snapshot, &tlb->pages_mapped, sizeof(tlb->pages_mapped));
+    transfer(snapshot, &tlb->overcommitted, sizeof(tlb->overcommitted));
+    transfer(snapshot, &tlb->busy_until, sizeof(tlb->busy_until));
+}
+
+// Everything the config does not determine. Arrays are sized by the
+// simulator they are read into, which was built from the saved config.
+static void transfer_simulator(SnapshotFile* snapshot, Simulator* simulator) {
+    CacheHierarchy* hierarchy = &simulator->hierarchy;
+    transfer_cache(snapshot, hierarchy->L1);
+    transfer_cache(snapshot, hierarchy->L2);
+    transfer_cache(snapshot, hierarchy->L3);
+    transfer_dram(snapshot, &hierarchy->dram);
+    for (int level = 0; level < NUM_CACHE_LEVELS; level++) {
+        if (hierarchy->prefetchers[level] != NULL) {
+            transfer_prefetcher(snapshot, hierarchy->prefetchers[level]);
+        }
+    }
+    if (hierarchy->core != NULL) {
+        transfer_core(snapshot, hierarchy->core);
+    }
+    if (hierarchy->victim != NULL) {
+        transfer(snapshot, hierarchy->victim->entries, (size_t)hierarchy->victim->num_entries * sizeof(VictimEntry));
+        transfer(snapshot, &hierarchy->victim->clock, sizeof(hierarchy->victim->clock));
+    }
+    if (hierarchy->tlb != NULL) {
+        transfer_tlb(snapshot, hierarchy->tlb);
+    }
+    transfer(snapshot, &hierarchy->stats, sizeof(hierarchy->stats));
+    transfer(snapshot, &simulator->resolver, sizeof(simulator->resolver));
+}
+
+static void layout(uint32_t header[5]) {
+    header[0] = CHECKPOINT_VERSION;
+    header[1] = (uint32_t)(sizeof(address_t) * 8);
+    header[2] = (uint32_t)sizeof(SimConfig);
+    header[3] = (uint32_t)sizeof(CacheStats);
+    header[4] = (uint32_t)sizeof(DRAMBank);
+}
+
+// trace_offset is how many trace accesses the simulator has consumed, so
+// a restored run knows where to pick up. Returns 1 on success.
+int save_checkpoint(const Simulator* simulator, long long trace_offset, const char* filename) {
+    SnapshotFile snapshot = { fopen(filename, "wb"), 1, 0 };
+    if (snapshot.file == NULL) {
+        perror("Error opening checkpoint file");
+        return 0;
+    }
+    char magic[4];
+    uint32_t header[5];
+    int64_t offset = trace_offset;
+    SimConfig config = simulator->config;
+    memcpy(magic, CHECKPOINT_MAGIC, sizeof(magic));
+    layout(header);
+    transfer(&snapshot, magic, sizeof(magic));
+    transfer(&snapshot, header, sizeof(header));
+    transfer(&snapshot, &offset, sizeof(offset));
+    transfer(&snapshot, &config, sizeof(config));
+    // Writing only reads from the simulator
+    transfer_simulator(&snapshot, (Simulator*)simulator);
+    if (fclose(snapshot.file) != 0) {
+        snapshot.failed = 1;
+    }
+    if (snapshot.failed) {
+        fprintf(stderr, "Error writing checkpoint %s\n", filename);
+        return 0;
+    }
+    return 1;
+}
+
+// Builds a simulator from the configuration saved in the checkpoint and
+// restores its state; NULL if the file is missing, truncated or from an
+// incompatible build.
+Simulator* load_checkpoint(const char* filename, long long* trace_offset) {
+    SnapshotFile snapshot = { fopen(filename, "rb"), 0, 0 };
+    if (snapshot.file == NULL) {
+        perror("Error opening checkpoint file");
+        return NULL;
+    }
+    char magic[4];
+    uint32_t header[5];
+    uint32_t expected[5];
+    int64_t offset;
+    SimConfig config;
+    layout(expected);
+    transfer(&snapshot, magic, sizeof(magic));
+    transfer(&snapshot, header, sizeof(header));
+    transfer(&snapshot, &offset, sizeof(offset));
+    if (snapshot.failed || memcmp(magic, CHECKPOINT_MAGIC, 4) != 0) {
+        fprintf(stderr, "%s is not a checkpoint\n", filename);
+        fclose(snapshot.file);
+        return NULL;
+    }
+    if (memcmp(header, expected, sizeof(header)) != 0) {
+        fprintf(stderr, "Checkpoint %s was written by an incompatible build (version %u, %u-bit addresses)\n",
+                filename, header[0], header[1]);
+        fclose(snapshot.file);
+        return NULL;
+    }
+    transfer(&snapshot, &config, sizeof(config));
+    if (snapshot.failed || !validate_sim_config(&config)) {
+        fprintf(stderr, "Checkpoint %s holds no usable configuration\n", filename);
+        fclose(snapshot.file);
+        return NULL;
+    }
+    Simulator* simulator = create_simulator(&config);
+    transfer_simulator(&snapshot, simulator);
+    fclose(snapshot.file);
+    if (snapshot.failed) {
+        fprintf(stderr, "Checkpoint %s is truncated\n", filename);
+        destroy_simulator(simulator);
+        return NULL;
+    }
+    *trace_offset = (long long)offset;
+    return simulator;
+}
@@ -0,0 +1,26 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "simulator.h"
+
+#define CHECKPOINT_MAGIC "MSNP"
+#define CHECKPOINT_VERSION 1
+
+// File layout, in the byte order of the build that wrote it:
+//   0  magic "MSNP"
+//   4  uint32 version
+//   8  uint32 address bits (32, or 64 from an ADDRESS_64 build)
+//   12 uint32 sizeof(SimConfig), uint32 sizeof(CacheStats), uint32 sizeof(DRAMBank)
+//   24 int64 trace offset: accesses of the trace already simulated
+// followed by the SimConfig, then the state of each part: per level the
+// tag, valid, dirty, prefetched, replacement and tree-PLRU arrays; the
+// DRAM banks, ranks, channels and clock; each prefetcher's table and
+// fills in flight; the out-of-order window and MSHRs; the victim cache;
+// the TLBs, page table and frame allocator; the counters; and the parser
+// register file. The sizes in the header reject snapshots of a build with
+// a different layout. Instrumentation and DRAM request logs are not saved.
+
+int save_checkpoint(const Simulator* simulator, long long trace_offset, const char* filename);
+Simulator* load_checkpoint(const char* filename, long long* trace_offset);
+
+#endif // CHECKPOINT_H
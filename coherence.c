@@ -0,0 +1,153 @@
+#include "coherence.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DIRECTORY_INITIAL_CAPACITY 4096
+
+static const char* protocol_names[] = { "mesi", "moesi" };
+static const char* mechanism_names[] = { "snoop", "directory" };
+
+const char* coherence_protocol_name(CoherenceProtocol protocol) {
+    return protocol_names[protocol];
+}
+
+int parse_coherence_protocol(const char* name, CoherenceProtocol* protocol) {
+    for (int i = 0; i < (int)(sizeof(protocol_names) / sizeof(protocol_names[0])); i++) {
+        if (strcmp(name, protocol_names[i]) == 0) {
+            *protocol = (CoherenceProtocol)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+const char* coherence_mechanism_name(CoherenceMechanism mechanism) {
+    return mechanism_names[mechanism];
+}
+
+int parse_coherence_mechanism(const char* name, CoherenceMechanism* mechanism) {
+    for (int i = 0; i < (int)(sizeof(mechanism_names) / sizeof(mechanism_names[0])); i++) {
+        if (strcmp(name, mechanism_names[i]) == 0) {
+            *mechanism = (CoherenceMechanism)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void default_coherence_config(CoherenceConfig* config) {
+    config->protocol = PROTOCOL_MESI;
+    config->mechanism = COHERENCE_DIRECTORY;
+    config->snoop_latency = SNOOP_LATENCY;
+    config->directory_latency = DIRECTORY_LATENCY;
+    config->transfer_latency = TRANSFER_LATENCY;
+}
+
+static DirectoryEntry* allocate_entries(size_t capacity) {
+    DirectoryEntry* entries = (DirectoryEntry*)calloc(capacity, sizeof(DirectoryEntry));
+    if (entries == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return entries;
+}
+
+static size_t home_slot(const Directory* directory, address_t line) {
+    return (size_t)(((uint64_t)line * 0x9E3779B97F4A7C15ULL) >> 32) & (directory->capacity - 1);
+}
+
+void init_directory(Directory* directory) {
+    directory->capacity = DIRECTORY_INITIAL_CAPACITY;
+    directory->count = 0;
+    directory->entries = allocate_entries(directory->capacity);
+}
+
+void free_directory(Directory* directory) {
+    free(directory->entries);
+    directory->entries = NULL;
+}
+
+DirectoryEntry* directory_find(Directory* directory, address_t line) {
+    size_t mask = directory->capacity - 1;
+    for (size_t slot = home_slot(directory, line);; slot = (slot + 1) & mask) {
+        DirectoryEntry* entry = &directory->entries[slot];
+        if (entry->sharers == 0) {
+            return NULL;
+        }
+        if (entry->line == line) {
+            return entry;
+        }
+    }
+}
+
+static void grow_directory(Directory* directory) {
+    DirectoryEntry* old = directory->entries;
+    size_t old_capacity = directory->capacity;
+    directory->capacity *= 2;
+    directory->entries = allocate_entries(directory->capacity);
+    size_t mask = directory->capacity - 1;
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old[i].sharers != 0) {
+            size_t slot = home_slot(directory, old[i].line);
+            while (directory->entries[slot].sharers != 0) {
+                slot = (slot + 1) & mask;
+            }
+            directory->entries[slot] = old[i];
+        }
+    }
+    free(old);
+}
+
+// Returns the entry of line, adding an empty one (no sharers, no owner)
+// if it has none. The caller must give it at least one sharer.
+DirectoryEntry* directory_insert(Directory* directory, address_t line) {
+    DirectoryEntry* entry = directory_find(directory, line);
+    if (entry != NULL) {
+        return entry;
+    }
+    if ((directory->count + 1) * 4 > directory->capacity * 3) {
+        grow_directory(directory);
+    }
+    size_t mask = directory->capacity - 1;
+    size_t slot = home_slot(directory, line);
+    while (directory->entries[slot].sharers != 0) {
+        slot = (slot + 1) & mask;
+    }
+    entry = &directory->entries[slot];
+    entry->line = line;
+    entry->owner = -1;
+    entry->owner_state = LINE_INVALID;
+    directory->count++;
+    return entry;
+}
+
+// Frees the entry, shifting later entries of the probe run back so that
+// lookups never need tombstones.
+void directory_remove(Directory* directory, DirectoryEntry* entry) {
+    size_t mask = directory->capacity - 1;
+    size_t hole = (size_t)(entry - directory->entries);
+    size_t slot = hole;
+    for (;;) {
+        slot = (slot + 1) & mask;
+        DirectoryEntry* next = &directory->entries[slot];
+        if (next->sharers == 0) {
+            break;
+        }
+        size_t home = home_slot(directory, next->line);
+        // Move it back unless its home lies cyclically in (hole, slot]
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            directory->entries[hole] = *next;
+            hole = slot;
+        }
+    }
+    memset(&directory->entries[hole], 0, sizeof(DirectoryEntry));
+    directory->count--;
+}
+
+LineState line_state(const DirectoryEntry* entry, int core) {
+    if (entry == NULL || !((entry->sharers >> core) & 1)) {
+        return LINE_INVALID;
+    }
+    return entry->owner == core ? (LineState)entry->owner_state : LINE_SHARED;
+}
@@ -0,0 +1,69 @@
+#ifndef COHERENCE_H
+#define COHERENCE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "address.h"
+
+#define MAX_CORES 64 // Sharers are tracked in a 64-bit mask
+
+#define SNOOP_LATENCY 15     // Broadcast on the shared bus
+#define DIRECTORY_LATENCY 10 // Directory lookup at the shared level
+#define TRANSFER_LATENCY 25  // Line sent from one core's caches to another's
+
+typedef enum {
+    PROTOCOL_MESI,
+    PROTOCOL_MOESI // Dirty lines can be shared in the Owned state instead of written back
+} CoherenceProtocol;
+
+typedef enum {
+    COHERENCE_SNOOP,    // Every private miss or upgrade is broadcast to all cores
+    COHERENCE_DIRECTORY // Requests go to the directory, which contacts only the sharers
+} CoherenceMechanism;
+
+typedef struct {
+    CoherenceProtocol protocol;
+    CoherenceMechanism mechanism;
+    int snoop_latency;
+    int directory_latency;
+    int transfer_latency;
+} CoherenceConfig;
+
+typedef enum {
+    LINE_INVALID,
+    LINE_SHARED,
+    LINE_EXCLUSIVE,
+    LINE_OWNED,
+    LINE_MODIFIED
+} LineState;
+
+// Where a line lives among the private caches. Every sharer holds it in
+// Shared state except the owner, which holds it in owner_state
+// (Exclusive, Owned or Modified).
+typedef struct {
+    address_t line;
+    uint64_t sharers; // Bit c = core c holds the line; 0 = free slot
+    signed char owner; // -1 when every holder is Shared
+    unsigned char owner_state;
+} DirectoryEntry;
+
+// Open-addressed table of the lines held by at least one private cache
+typedef struct {
+    DirectoryEntry* entries;
+    size_t capacity; // Power of two
+    size_t count;
+} Directory;
+
+const char* coherence_protocol_name(CoherenceProtocol protocol);
+int parse_coherence_protocol(const char* name, CoherenceProtocol* protocol);
+const char* coherence_mechanism_name(CoherenceMechanism mechanism);
+int parse_coherence_mechanism(const char* name, CoherenceMechanism* mechanism);
+void default_coherence_config(CoherenceConfig* config);
+void init_directory(Directory* directory);
+void free_directory(Directory* directory);
+DirectoryEntry* directory_find(Directory* directory, address_t line);
+DirectoryEntry* directory_insert(Directory* directory, address_t line);
+void directory_remove(Directory* directory, DirectoryEntry* entry);
+LineState line_state(const DirectoryEntry* entry, int core);
+
+#endif // COHERENCE_H
@@ -0,0 +1,178 @@
+#include "core_model.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char* model_names[] = { "serial", "ooo" };
+
+const char* core_model_name(CoreModelType model) {
+    return model_names[model];
+}
+
+int parse_core_model(const char* name, CoreModelType* model) {
+    for (int i = 0; i < (int)(sizeof(model_names) / sizeof(model_names[0])); i++) {
+        if (strcmp(name, model_names[i]) == 0) {
+            *model = (CoreModelType)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Returns 1 if the core can be simulated, otherwise prints why not.
+int validate_core_config(const CoreConfig* config) {
+    if (config->rob_size < 1) {
+        fprintf(stderr, "core: reorder buffer needs at least one entry\n");
+        return 0;
+    }
+    if (config->width < 1) {
+        fprintf(stderr, "core: width must be at least 1\n");
+        return 0;
+    }
+    return 1;
+}
+
+static void* allocate_array(size_t count, size_t size) {
+    void* array = calloc(count, size);
+    if (array == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return array;
+}
+
+// mshrs holds the MSHR count of L1, L2 and L3, each 1 to MAX_MSHRS.
+CoreModel* create_core_model(const CoreConfig* config, const int mshrs[3]) {
+    CoreModel* core = (CoreModel*)allocate_array(1, sizeof(CoreModel));
+    core->config = *config;
+    core->rob = (long long*)allocate_array((size_t)config->rob_size, sizeof(long long));
+    for (int level = 0; level < 3; level++) {
+        core->num_mshrs[level] = mshrs[level];
+        core->mshrs[level] = (MshrEntry*)allocate_array((size_t)mshrs[level], sizeof(MshrEntry));
+    }
+    return core;
+}
+
+void destroy_core_model(CoreModel* core) {
+    if (core == NULL) {
+        return;
+    }
+    for (int level = 0; level < 3; level++) {
+        free(core->mshrs[level]);
+    }
+    free(core->rob);
+    free(core);
+}
+
+// Returns the cycle the next instruction enters the window: width per
+// cycle, and not before the instruction rob_size earlier has retired.
+long long core_dispatch(CoreModel* core, TimingStats* stats) {
+    long long cycle = core->dispatch_cycle;
+    if (core->dispatched == core->config.width) {
+        cycle++;
+    }
+    long long slot_free = core->rob[core->instructions % (unsigned long long)core->config.rob_size];
+    if (slot_free > cycle) {
+        stats->rob_stall_cycles += (unsigned long long)(slot_free - cycle);
+        cycle = slot_free;
+    }
+    if (cycle != core->dispatch_cycle) {
+        core->dispatch_cycle = cycle;
+        core->dispatched = 0;
+    }
+    core->dispatched++;
+    return cycle;
+}
+
+// Completion cycle of line's fill if an MSHR of level still tracks it at
+// now, otherwise 0.
+long long mshr_in_flight(const CoreModel* core, int level, address_t line, long long now) {
+    const MshrEntry* entries = core->mshrs[level];
+    for (int i = 0; i < core->num_mshrs[level]; i++) {
+        if (entries[i].ready > now && entries[i].line == line) {
+            return entries[i].ready;
+        }
+    }
+    return 0;
+}
+
+// First cycle from now at which level has a free MSHR
+static long long mshr_wait(CoreModel* core, int level, long long now) {
+    const MshrEntry* entries = core->mshrs[level];
+    long long earliest = -1;
+    for (int i = 0; i < core->num_mshrs[level]; i++) {
+        if (entries[i].ready <= now) {
+            return now;
+        }
+        if (earliest < 0 || entries[i].ready < earliest) {
+            earliest = entries[i].ready;
+        }
+    }
+    return earliest;
+}
+
+// Returns the cycle a miss dispatched at dispatch and missing in the
+// first levels levels can issue: after the previous miss (misses issue in
+// order, hits need not wait for them) and once each of those levels has a
+// free MSHR.
+long long core_issue_miss(CoreModel* core, int levels, long long dispatch) {
+    long long issue = dispatch > core->miss_issue ? dispatch : core->miss_issue;
+    for (int level = 0; level < levels; level++) {
+        issue = mshr_wait(core, level, issue);
+    }
+    core->miss_issue = issue;
+    return issue;
+}
+
+// Holds an MSHR of level for line until ready. One must be free at now
+// (see core_issue_miss).
+void mshr_allocate(CoreModel* core, int level, address_t line, long long now, long long ready) {
+    MshrEntry* entries = core->mshrs[level];
+    for (int i = 0; i < core->num_mshrs[level]; i++) {
+        if (entries[i].ready <= now) {
+            entries[i].line = line;
+            entries[i].ready = ready;
+            return;
+        }
+    }
+}
+
+// Retires the instruction last dispatched, which can leave the window
+// once ready. Retirement is in order, width per cycle. Returns the retire
+// cycle.
+long long core_retire(CoreModel* core, long long ready) {
+    long long cycle = ready > core->retire_cycle ? ready : core->retire_cycle;
+    if (cycle > core->retire_cycle) {
+        core->retire_cycle = cycle;
+        core->retired = 0;
+    }
+    if (core->retired == core->config.width) {
+        core->retire_cycle++;
+        core->retired = 0;
+    }
+    core->retired++;
+    core->rob[core->instructions % (unsigned long long)core->config.rob_size] = core->retire_cycle;
+    core->instructions++;
+    return core->retire_cycle;
+}
+
+// Misses issue in order, so the busy time is the union of
+// [issue, done) grown from its end.
+void record_dram_miss(CoreModel* core, TimingStats* stats, long long issue, long long done) {
+    stats->dram_misses++;
+    stats->dram_miss_cycles += (unsigned long long)(done - issue);
+    long long start = issue > core->dram_busy_until ? issue : core->dram_busy_until;
+    if (done > start) {
+        stats->dram_busy_cycles += (unsigned long long)(done - start);
+        core->dram_busy_until = done;
+    }
+}
+
+void print_timing_stats(const TimingStats* stats, unsigned long long cycles, FILE* out) {
+    double accesses = stats->accesses > 0 ? (double)stats->accesses : 1.0;
+    fprintf(out, "  Out-of-order core : AMAT %.2f cycles, MLP %.2f, %.2f accesses per cycle, merged misses %llu, "
+                 "ROB stall cycles %llu, MSHR stall cycles %llu\n",
+            (double)stats->latency_cycles / accesses,
+            stats->dram_busy_cycles > 0 ? (double)stats->dram_miss_cycles / (double)stats->dram_busy_cycles : 0.0,
+            cycles > 0 ? (double)stats->accesses / (double)cycles : 0.0,
+            stats->merged, stats->rob_stall_cycles, stats->mshr_stall_cycles);
+}
@@ -0,0 +1,77 @@
+#ifndef CORE_MODEL_H
+#define CORE_MODEL_H
+
+#include <stdio.h>
+#include "address.h"
+
+#define CORE_ROB_SIZE 128 // Default reorder-buffer entries
+#define CORE_WIDTH 4      // Default instructions dispatched and retired per cycle
+#define MAX_MSHRS 64
+
+// Default miss status holding registers per level
+#define L1_MSHRS 8
+#define L2_MSHRS 16
+#define L3_MSHRS 32
+
+typedef enum {
+    CORE_SERIAL, // Every access stalls the core for its full latency
+    CORE_OOO     // Out-of-order window: independent misses overlap
+} CoreModelType;
+
+typedef struct {
+    CoreModelType model;
+    int rob_size;
+    int width;
+} CoreConfig;
+
+// Counters of the out-of-order timing mode. AMAT is latency_cycles /
+// accesses; achieved MLP is dram_miss_cycles / dram_busy_cycles, the mean
+// number of DRAM misses in flight while there is at least one.
+typedef struct {
+    unsigned long long accesses;
+    unsigned long long latency_cycles;   // Dispatch to data, summed over accesses
+    unsigned long long merged;           // Misses on a line already in flight at L1
+    unsigned long long rob_stall_cycles; // Dispatch held back by a full reorder buffer
+    unsigned long long mshr_stall_cycles; // Miss issue held back by a level with no free MSHR
+    unsigned long long dram_misses;
+    unsigned long long dram_miss_cycles;
+    unsigned long long dram_busy_cycles; // Cycles with at least one DRAM miss in flight
+} TimingStats;
+
+typedef struct {
+    address_t line;
+    long long ready; // Cycle the fill completes; the entry is free from then on
+} MshrEntry;
+
+// State of the out-of-order core: the retire times of the last rob_size
+// instructions and an MSHR file per cache level. Each trace record is one
+// memory instruction; the traces carry no register dependencies, so every
+// access is independent and only the window and the MSHRs limit overlap.
+typedef struct {
+    CoreConfig config;
+    long long* rob;        // Retire time per slot, indexed by instruction number mod rob_size
+    unsigned long long instructions;
+    long long dispatch_cycle;
+    int dispatched;        // Instructions dispatched in dispatch_cycle
+    long long retire_cycle;
+    int retired;           // Instructions retired in retire_cycle
+    MshrEntry* mshrs[3];
+    int num_mshrs[3];
+    long long miss_issue;  // Issue cycle of the latest miss
+    long long dram_busy_until;
+} CoreModel;
+
+const char* core_model_name(CoreModelType model);
+int parse_core_model(const char* name, CoreModelType* model);
+int validate_core_config(const CoreConfig* config);
+CoreModel* create_core_model(const CoreConfig* config, const int mshrs[3]);
+void destroy_core_model(CoreModel* core);
+long long core_dispatch(CoreModel* core, TimingStats* stats);
+long long mshr_in_flight(const CoreModel* core, int level, address_t line, long long now);
+long long core_issue_miss(CoreModel* core, int levels, long long dispatch);
+void mshr_allocate(CoreModel* core, int level, address_t line, long long now, long long ready);
+long long core_retire(CoreModel* core, long long ready);
+void record_dram_miss(CoreModel* core, TimingStats* stats, long long issue, long long done);
+void print_timing_stats(const TimingStats* stats, unsigned long long cycles, FILE* out);
+
+#endif // CORE_MODEL_H
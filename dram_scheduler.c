@@ -0,0 +1,406 @@
+#include "dram_scheduler.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_POOL_SIZE 1024
+#define INITIAL_BUCKETS 256
+
+static void* reallocate(void* memory, size_t size) {
+    void* grown = realloc(memory, size);
+    if (grown == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return grown;
+}
+
+void init_dram_request_log(DramRequestLog* log) {
+    log->requests = NULL;
+    log->count = 0;
+    log->capacity = 0;
+    log->stall_cycles = 0;
+}
+
+// cycles is the run's cycle count when the request is sent; the DRAM
+// latency already charged is taken out to get its arrival time.
+void record_dram_request(DramRequestLog* log, address_t address, unsigned long long cycles) {
+    if (log->count == log->capacity) {
+        log->capacity = log->capacity ? log->capacity * 2 : INITIAL_POOL_SIZE;
+        log->requests = (DramRequest*)reallocate(log->requests, sizeof(DramRequest) * log->capacity);
+    }
+    log->requests[log->count].address = address;
+    log->requests[log->count].arrival = (long long)(cycles - log->stall_cycles);
+    log->count++;
+}
+
+void free_dram_request_log(DramRequestLog* log) {
+    free(log->requests);
+    init_dram_request_log(log);
+}
+
+static const char* scheduler_names[] = { "fcfs", "frfcfs", "batch" };
+
+const char* scheduler_policy_name(SchedulerPolicy policy) {
+    return scheduler_names[policy];
+}
+
+int parse_scheduler_policy(const char* name, SchedulerPolicy* policy) {
+    for (int i = 0; i < (int)(sizeof(scheduler_names) / sizeof(scheduler_names[0])); i++) {
+        if (strcmp(name, scheduler_names[i]) == 0) {
+            *policy = (SchedulerPolicy)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+DramScheduler* create_dram_scheduler(const DramConfig* config, SchedulerPolicy policy, int batch_cap) {
+    DramScheduler* scheduler = (DramScheduler*)calloc(1, sizeof(DramScheduler));
+    if (scheduler == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    scheduler->policy = policy;
+    scheduler->batch_cap = batch_cap > 0 ? batch_cap : SCHEDULER_BATCH_CAP;
+    init_dram(&scheduler->dram, config);
+    scheduler->num_banks = scheduler->dram.num_banks;
+    scheduler->banks = (BankQueue*)reallocate(NULL, sizeof(BankQueue) * (size_t)scheduler->num_banks);
+    memset(scheduler->banks, 0, sizeof(BankQueue) * (size_t)scheduler->num_banks);
+    for (int b = 0; b < scheduler->num_banks; b++) {
+        scheduler->banks[b].head = -1;
+        scheduler->banks[b].tail = -1;
+    }
+    scheduler->free_request = -1;
+    scheduler->free_row = -1;
+    scheduler->num_buckets = INITIAL_BUCKETS;
+    scheduler->buckets = (int*)reallocate(NULL, sizeof(int) * (size_t)scheduler->num_buckets);
+    memset(scheduler->buckets, 0xFF, sizeof(int) * (size_t)scheduler->num_buckets);
+    return scheduler;
+}
+
+static int row_bucket(const DramScheduler* scheduler, int bank, int row) {
+    unsigned long long key = ((unsigned long long)(unsigned int)row * (unsigned int)scheduler->num_banks + (unsigned int)bank) * 0x9E3779B97F4A7C15ULL;
+    return (int)(key >> 32) & (scheduler->num_buckets - 1);
+}
+
+static int find_row_queue(const DramScheduler* scheduler, int bank, int row) {
+    int index = scheduler->buckets[row_bucket(scheduler, bank, row)];
+    while (index >= 0 && (scheduler->rows[index].bank != bank || scheduler->rows[index].row != row)) {
+        index = scheduler->rows[index].next;
+    }
+    return index;
+}
+
+// Doubles the bucket array once rows outnumber it, keeping chains short.
+static void grow_buckets(DramScheduler* scheduler) {
+    scheduler->num_buckets *= 2;
+    scheduler->buckets = (int*)reallocate(scheduler->buckets, sizeof(int) * (size_t)scheduler->num_buckets);
+    memset(scheduler->buckets, 0xFF, sizeof(int) * (size_t)scheduler->num_buckets);
+    for (int i = 0; i < scheduler->rows_capacity; i++) {
+        RowQueue* queue = &scheduler->rows[i];
+        if (queue->head >= 0) {
+            int bucket = row_bucket(scheduler, queue->bank, queue->row);
+            queue->next = scheduler->buckets[bucket];
+            scheduler->buckets[bucket] = i;
+        }
+    }
+}
+
+static int add_row_queue(DramScheduler* scheduler, int bank, int row) {
+    if (scheduler->free_row < 0) {
+        int old_capacity = scheduler->rows_capacity;
+        scheduler->rows_capacity = old_capacity ? old_capacity * 2 : INITIAL_POOL_SIZE;
+        scheduler->rows = (RowQueue*)reallocate(scheduler->rows, sizeof(RowQueue) * (size_t)scheduler->rows_capacity);
+        for (int i = scheduler->rows_capacity - 1; i >= old_capacity; i--) {
+            scheduler->rows[i].head = -1;
+            scheduler->rows[i].next = scheduler->free_row;
+            scheduler->free_row = i;
+        }
+    }
+    if (scheduler->live_rows + 1 > scheduler->num_buckets) {
+        grow_buckets(scheduler);
+    }
+    int index = scheduler->free_row;
+    RowQueue* queue = &scheduler->rows[index];
+    scheduler->free_row = queue->next;
+    queue->bank = bank;
+    queue->row = row;
+    queue->head = -1;
+    queue->tail = -1;
+    int bucket = row_bucket(scheduler, bank, row);
+    queue->next = scheduler->buckets[bucket];
+    scheduler->buckets[bucket] = index;
+    scheduler->live_rows++;
+    return index;
+}
+
+static void remove_row_queue(DramScheduler* scheduler, int index) {
+    RowQueue* queue = &scheduler->rows[index];
+    int* link = &scheduler->buckets[row_bucket(scheduler, queue->bank, queue->row)];
+    while (*link != index) {
+        link = &scheduler->rows[*link].next;
+    }
+    *link = queue->next;
+    queue->head = -1;
+    queue->next = scheduler->free_row;
+    scheduler->free_row = index;
+    scheduler->live_rows--;
+}
+
+// Queues a request. Requests must be enqueued in arrival order.
+void enqueue_dram_request(DramScheduler* scheduler, address_t address, long long arrival) {
+    if (scheduler->free_request < 0) {
+        int old_capacity = scheduler->pool_capacity;
+        scheduler->pool_capacity = old_capacity ? old_capacity * 2 : INITIAL_POOL_SIZE;
+        scheduler->pool = (QueuedRequest*)reallocate(scheduler->pool, sizeof(QueuedRequest) * (size_t)scheduler->pool_capacity);
+        for (int i = scheduler->pool_capacity - 1; i >= old_capacity; i--) {
+            scheduler->pool[i].next = scheduler->free_request;
+            scheduler->free_request = i;
+        }
+    }
+    int index = scheduler->free_request;
+    QueuedRequest* request = &scheduler->pool[index];
+    scheduler->free_request = request->next;
+
+    DramLocation location;
+    map_dram_address(&scheduler->dram, address, &location);
+    request->address = address;
+    request->arrival = arrival;
+    request->marked = 0;
+    request->bank = dram_bank_index(&scheduler->dram, &location);
+    request->row = location.row;
+
+    BankQueue* bank = &scheduler->banks[request->bank];
+    request->prev = bank->tail;
+    request->next = -1;
+    if (bank->tail >= 0) {
+        scheduler->pool[bank->tail].next = index;
+    } else {
+        bank->head = index;
+    }
+    bank->tail = index;
+    bank->count++;
+
+    int row_queue = find_row_queue(scheduler, request->bank, request->row);
+    if (row_queue < 0) {
+        row_queue = add_row_queue(scheduler, request->bank, request->row);
+    }
+    RowQueue* queue = &scheduler->rows[row_queue];
+    request->row_queue = row_queue;
+    request->row_prev = queue->tail;
+    request->row_next = -1;
+    if (queue->tail >= 0) {
+        scheduler->pool[queue->tail].row_next = index;
+    } else {
+        queue->head = index;
+    }
+    queue->tail = index;
+    scheduler->pending++;
+}
+
+static void unlink_request(DramScheduler* scheduler, int index) {
+    QueuedRequest* request = &scheduler->pool[index];
+    BankQueue* bank = &scheduler->banks[request->bank];
+    if (request->prev >= 0) scheduler->pool[request->prev].next = request->next; else bank->head = request->next;
+    if (request->next >= 0) scheduler->pool[request->next].prev = request->prev; else bank->tail = request->prev;
+    bank->count--;
+
+    RowQueue* queue = &scheduler->rows[request->row_queue];
+    if (request->row_prev >= 0) scheduler->pool[request->row_prev].row_next = request->row_next; else queue->head = request->row_next;
+    if (request->row_next >= 0) scheduler->pool[request->row_next].row_prev = request->row_prev; else queue->tail = request->row_prev;
+    if (queue->head < 0) {
+        remove_row_queue(scheduler, request->row_queue);
+    }
+
+    if (request->marked) {
+        bank->marked--;
+        scheduler->batch_remaining--;
+    }
+    request->next = scheduler->free_request;
+    scheduler->free_request = index;
+    scheduler->pending--;
+}
+
+// Marks the batch_cap oldest requests of every bank.
+static void form_batch(DramScheduler* scheduler) {
+    for (int b = 0; b < scheduler->num_banks; b++) {
+        BankQueue* bank = &scheduler->banks[b];
+        for (int index = bank->head; index >= 0 && bank->marked < scheduler->batch_cap; index = scheduler->pool[index].next) {
+            scheduler->pool[index].marked = 1;
+            bank->marked++;
+            scheduler->batch_remaining++;
+        }
+    }
+    scheduler->stats.batches++;
+}
+
+// The request this bank would serve next under the policy, or -1.
+static int bank_candidate(const DramScheduler* scheduler, int b) {
+    const BankQueue* bank = &scheduler->banks[b];
+    if (bank->head < 0 || scheduler->policy == SCHED_FCFS) {
+        return bank->head;
+    }
+    int active_row = dram_open_row(&scheduler->dram, b, scheduler->now);
+    int row_queue = active_row >= 0 ? find_row_queue(scheduler, b, active_row) : -1;
+    int row_hit = row_queue >= 0 ? scheduler->rows[row_queue].head : -1;
+    if (scheduler->policy == SCHED_BATCH && bank->marked > 0) {
+        // Marked requests are the oldest of the bank, so the row queue's
+        // head is marked whenever any of its requests is
+        return row_hit >= 0 && scheduler->pool[row_hit].marked ? row_hit : bank->head;
+    }
+    return row_hit >= 0 ? row_hit : bank->head;
+}
+
+// Issues one queued request to a bank that is ready at the controller's
+// current cycle. Returns 0 when no queued request can issue yet.
+int issue_dram_request(DramScheduler* scheduler) {
+    if (scheduler->pending == 0) {
+        return 0;
+    }
+    if (scheduler->policy == SCHED_BATCH && scheduler->batch_remaining == 0) {
+        form_batch(scheduler);
+    }
+
+    int best = -1;
+    int best_marked = 0, best_hit = 0;
+    for (int b = 0; b < scheduler->num_banks; b++) {
+        if (scheduler->dram.banks[b].ready > scheduler->now) {
+            continue;
+        }
+        int index = bank_candidate(scheduler, b);
+        if (index < 0) {
+            continue;
+        }
+        const QueuedRequest* request = &scheduler->pool[index];
+        int marked = request->marked;
+        int hit = scheduler->policy != SCHED_FCFS && dram_open_row(&scheduler->dram, b, scheduler->now) == request->row;
+        if (best < 0 || marked > best_marked || (marked == best_marked &&
+            (hit > best_hit || (hit == best_hit && request->arrival < scheduler->pool[best].arrival)))) {
+            best = index;
+            best_marked = marked;
+            best_hit = hit;
+        }
+    }
+
+    if (best < 0) {
+        return 0;
+    }
+
+    QueuedRequest request = scheduler->pool[best];
+    unlink_request(scheduler, best);
+    long long delay = scheduler->now - request.arrival;
+    long long done = dram_access_at(&scheduler->dram, request.address, scheduler->now);
+    scheduler->stats.requests++;
+    scheduler->stats.total_queue_delay += (unsigned long long)delay;
+    if (delay > scheduler->stats.max_queue_delay) {
+        scheduler->stats.max_queue_delay = delay;
+    }
+    scheduler->stats.total_latency += (unsigned long long)(done - request.arrival);
+    if (done > scheduler->stats.finish_time) {
+        scheduler->stats.finish_time = done;
+    }
+    return 1;
+}
+
+// Earliest cycle a bank with queued requests becomes ready, or -1.
+static long long next_bank_ready(const DramScheduler* scheduler) {
+    long long earliest = -1;
+    for (int b = 0; b < scheduler->num_banks; b++) {
+        long long ready = scheduler->dram.banks[b].ready;
+        if (scheduler->banks[b].count > 0 && (earliest < 0 || ready < earliest)) {
+            earliest = ready;
+        }
+    }
+    return earliest;
+}
+
+// Feeds a request stream (sorted by arrival) through the controller.
+// Requests are admitted once the clock reaches their arrival time; the
+// clock then skips to the next arrival or the next bank becoming ready.
+void run_dram_schedule(DramScheduler* scheduler, const DramRequest* requests, size_t count) {
+    size_t next = 0;
+    while (next < count || scheduler->pending > 0) {
+        while (next < count && requests[next].arrival <= scheduler->now) {
+            enqueue_dram_request(scheduler, requests[next].address, requests[next].arrival);
+            next++;
+        }
+        if (issue_dram_request(scheduler)) {
+            continue;
+        }
+        long long wake = next_bank_ready(scheduler);
+        if (next < count && (wake < 0 || requests[next].arrival < wake)) {
+            wake = requests[next].arrival;
+        }
+        scheduler->now = wake > scheduler->now ? wake : scheduler->now + 1;
+    }
+}
+
+void print_scheduler_stats(const DramScheduler* scheduler, FILE* out) {
+    const SchedulerStats* stats = &scheduler->stats;
+    const DramStats* dram = &scheduler->dram.stats;
+    double requests = stats->requests > 0 ? (double)stats->requests : 1.0;
+    double cycles = stats->finish_time > 0 ? (double)stats->finish_time : 1.0;
+    unsigned long long bus_busy = 0;
+    for (int c = 0; c < scheduler->dram.config.channels; c++) {
+        bus_busy += scheduler->dram.channels[c].busy_cycles;
+    }
+    fprintf(out, "%-7s requests %llu, row hits %.2f%%, conflicts %.2f%%, avg queue delay %.1f, max queue delay %lld, "
+                 "avg latency %.1f, finish %lld, %.3f bytes/cycle, bus busy %.1f%%",
+            scheduler_policy_name(scheduler->policy), stats->requests,
+            100.0 * (double)dram->row_hits / requests, 100.0 * (double)dram->row_conflicts / requests,
+            (double)stats->total_queue_delay / requests, stats->max_queue_delay,
+            (double)stats->total_latency / requests, stats->finish_time,
+            (double)stats->requests * CACHE_BLOCK_SIZE / cycles,
+            100.0 * (double)bus_busy / (cycles * scheduler->dram.config.channels));
+    if (scheduler->policy == SCHED_BATCH) {
+        fprintf(out, ", batches %llu", stats->batches);
+    }
+    if (dram->refreshes > 0) {
+        fprintf(out, ", refreshes %llu", dram->refreshes);
+    }
+    fprintf(out, "\n");
+}
+
+// One line of a mapping comparison: how the mapping spread the requests
+// over banks and how often it kept rows open for them.
+void print_mapping_stats(const DramScheduler* scheduler, FILE* out) {
+    const DramStats* dram = &scheduler->dram.stats;
+    double requests = dram->accesses > 0 ? (double)dram->accesses : 1.0;
+    unsigned long long busiest = 0;
+    int banks_used = 0;
+    for (int b = 0; b < scheduler->dram.num_banks; b++) {
+        unsigned long long accesses = scheduler->dram.banks[b].accesses;
+        busiest = accesses > busiest ? accesses : busiest;
+        banks_used += accesses > 0;
+    }
+    fprintf(out, "%-26s row hits %6.2f%%, misses %6.2f%%, conflicts %6.2f%%, banks used %d/%d, busiest bank %.2fx mean, "
+                 "avg latency %.1f, finish %lld\n",
+            scheduler->dram.mapping.spec, 100.0 * (double)dram->row_hits / requests,
+            100.0 * (double)dram->row_misses / requests, 100.0 * (double)dram->row_conflicts / requests,
+            banks_used, scheduler->dram.num_banks,
+            (double)busiest * scheduler->dram.num_banks / requests,
+            scheduler->stats.requests > 0 ? (double)scheduler->stats.total_latency / (double)scheduler->stats.requests : 0.0,
+            scheduler->stats.finish_time);
+}
+
+// One line of a page-policy comparison. baseline_latency is the average
+// latency under the open-page policy, to show what this one saves.
+void print_page_policy_stats(const DramScheduler* scheduler, double baseline_latency, FILE* out) {
+    const DramStats* dram = &scheduler->dram.stats;
+    double requests = dram->accesses > 0 ? (double)dram->accesses : 1.0;
+    double latency = scheduler->stats.requests > 0 ? (double)scheduler->stats.total_latency / (double)scheduler->stats.requests : 0.0;
+    fprintf(out, "%-8s row hits %6.2f%%, misses %6.2f%%, conflicts %6.2f%%, avg latency %.1f (%+.1f%% vs open), finish %lld\n",
+            page_policy_name(scheduler->dram.config.page_policy), 100.0 * (double)dram->row_hits / requests,
+            100.0 * (double)dram->row_misses / requests, 100.0 * (double)dram->row_conflicts / requests,
+            latency, baseline_latency > 0 ? 100.0 * (latency - baseline_latency) / baseline_latency : 0.0,
+            scheduler->stats.finish_time);
+}
+
+void destroy_dram_scheduler(DramScheduler* scheduler) {
+    free_dram(&scheduler->dram);
+    free(scheduler->banks);
+    free(scheduler->pool);
+    free(scheduler->rows);
+    free(scheduler->buckets);
+    free(scheduler);
+}
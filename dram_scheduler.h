@@ -0,0 +1,113 @@
+#ifndef DRAM_SCHEDULER_H
+#define DRAM_SCHEDULER_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "address.h"
+#include "dram_simulation.h"
+
+#define SCHEDULER_BATCH_CAP 5 // Requests per bank marked into one batch
+
+typedef enum {
+    SCHED_FCFS,    // Oldest request first
+    SCHED_FR_FCFS, // Requests to an open row first, then oldest
+    SCHED_BATCH    // PAR-BS style: oldest requests per bank form a batch
+                   // that is drained (row hits first) before newer ones
+} SchedulerPolicy;
+
+// One DRAM request as seen by the memory controller
+typedef struct {
+    address_t address;
+    long long arrival; // Cycle the request reached the controller
+} DramRequest;
+
+// Requests a simulation sent to DRAM, in issue order. Arrival times leave
+// out the cycles spent waiting on DRAM itself, so the log is the open-loop
+// request stream the caches generate.
+typedef struct {
+    DramRequest* requests;
+    size_t count;
+    size_t capacity;
+    unsigned long long stall_cycles; // DRAM latency already charged to the run
+} DramRequestLog;
+
+// A queued request. Requests sit in two intrusive lists: their bank's
+// queue in arrival order and the queue of requests to the same row.
+typedef struct {
+    address_t address;
+    long long arrival;
+    int bank; // dram_bank_index() of its location
+    int row;
+    int marked;
+    int prev, next;         // Bank queue
+    int row_prev, row_next; // Row queue
+    int row_queue;
+} QueuedRequest;
+
+// Requests to one (bank, row), oldest first; chained in a hash bucket
+typedef struct {
+    int bank;
+    int row;
+    int head;
+    int tail;
+    int next;
+} RowQueue;
+
+typedef struct {
+    int head; // Oldest request
+    int tail;
+    int count;
+    int marked; // Requests of the current batch still queued
+} BankQueue;
+
+typedef struct {
+    unsigned long long requests;
+    unsigned long long total_queue_delay; // Arrival to issue
+    long long max_queue_delay;
+    unsigned long long total_latency;     // Arrival to first data
+    unsigned long long batches;
+    long long finish_time;                // Last data returned
+} SchedulerStats;
+
+// Memory-controller stage in front of the DRAM model. Picking the next
+// request is O(1) per bank: the bank queue's head is its oldest request
+// and the open row's queue head is its oldest row hit. Each cycle the
+// controller may issue to any bank that is ready, so requests to
+// different banks overlap.
+typedef struct {
+    SchedulerPolicy policy;
+    int batch_cap;
+    DRAM dram;
+    BankQueue* banks; // One per DRAM bank
+    int num_banks;
+    QueuedRequest* pool;
+    int pool_capacity;
+    int free_request;
+    RowQueue* rows;
+    int rows_capacity;
+    int free_row;
+    int* buckets;
+    int num_buckets;
+    int live_rows;
+    int pending;
+    int batch_remaining;
+    long long now;
+    SchedulerStats stats;
+} DramScheduler;
+
+void init_dram_request_log(DramRequestLog* log);
+void record_dram_request(DramRequestLog* log, address_t address, unsigned long long cycles);
+void free_dram_request_log(DramRequestLog* log);
+
+const char* scheduler_policy_name(SchedulerPolicy policy);
+int parse_scheduler_policy(const char* name, SchedulerPolicy* policy);
+DramScheduler* create_dram_scheduler(const DramConfig* config, SchedulerPolicy policy, int batch_cap);
+void enqueue_dram_request(DramScheduler* scheduler, address_t address, long long arrival);
+int issue_dram_request(DramScheduler* scheduler);
+void run_dram_schedule(DramScheduler* scheduler, const DramRequest* requests, size_t count);
+void print_scheduler_stats(const DramScheduler* scheduler, FILE* out);
+void print_mapping_stats(const DramScheduler* scheduler, FILE* out);
+void print_page_policy_stats(const DramScheduler* scheduler, double baseline_latency, FILE* out);
+void destroy_dram_scheduler(DramScheduler* scheduler);
+
+#endif // DRAM_SCHEDULER_H
@@ -3,187 +3,228 @@
 #include <stdint.h> // for uint32_t
 #include <stdbool.h>
 #include <string.h>
-#include <math.h> // for log2 function
+#include "dram_simulation.h"
 
-#define BUS_WIDTH 4
-#define CHANNELS 1
-#define DIMMS 1
-#define BANKS 4
-#define ROWS 262144 // 2^18 rows
-#define COLUMNS 1024 // 2^10 columns
-#define RAS_TIME 100
-#define CAS_TIME 50
-#define RANK 1
-#define CACHE_BLOCK_SIZE 64 // Assuming 64 bytes cache block
-#define PRECHARGE_TIME 50 // Hypothetical precharge time
-#define MAX_REQUESTS 10000000
-#define Mapping_Method "Cache block interleaving" // Using string instead of char
-
-// Global variable to store the last accessed address
-uint32_t last_accessed_address = 0;
-
-// Structure representing a DRAM bank
-typedef struct {
-    int active_row;         // Currently active row in the bank (-1 if no row is active)
-    int time_last_accessed; // Time when the bank was last accessed
-} DRAMBank;
-
-// Structure representing the entire DRAM
-typedef struct {
-    DRAMBank banks[BANKS];  // Array of banks in the DRAM
-    int time;               // Global time counter
-} DRAM;
+// Function to calculate the number of bits needed for a given size
+static int calculate_bits_needed(int size) {
+    int bits = 0;
+    while ((1 << bits) < size) {
+        bits++;
+    }
+    return bits;
+}
 
-// Memory request structure and queue
-typedef struct {
-    uint32_t address;
-    int time_arrived;
-} MemoryRequest;
+// Hypothetical function to simulate sending the address to the cache
+int send_to_cache(address_t address, int latency) {
+    printf("Address 0x" ADDRESS_FORMAT " is sent to the cache with latency %d cycles.\n", address, latency);
+    return latency;
+}
 
-MemoryRequest request_queue[MAX_REQUESTS];
-int queue_size = 0;
+static const char* page_policy_names[] = { "open", "closed", "timeout", "adaptive" };
 
-void add_request(uint32_t address, int time_arrived) {
-    if (queue_size < MAX_REQUESTS) {
-        request_queue[queue_size].address = address;
-        request_queue[queue_size].time_arrived = time_arrived;
-        queue_size++;
-    } else {
-        printf("Request queue full!\n");
-    }
+const char* page_policy_name(PagePolicy policy) {
+    return page_policy_names[policy];
 }
 
-int get_next_request_index() {
-    if (queue_size == 0) return -1;
-    int oldest_index = 0;
-    for (int i = 1; i < queue_size; i++) {
-        if (request_queue[i].time_arrived < request_queue[oldest_index].time_arrived) {
-            oldest_index = i;
+int parse_page_policy(const char* name, PagePolicy* policy) {
+    for (int i = 0; i < (int)(sizeof(page_policy_names) / sizeof(page_policy_names[0])); i++) {
+        if (strcmp(name, page_policy_names[i]) == 0) {
+            *policy = (PagePolicy)i;
+            return 1;
         }
     }
-    return oldest_index;
+    return 0;
 }
 
-// Function to calculate the number of bits needed for a given size
-int calculate_bits_needed(int size) {
-    return (int)ceil(log2(size));
+void default_dram_config(DramConfig* config) {
+    strcpy(config->mapping, "cache_block_interleaving");
+    config->channels = CHANNELS;
+    config->ranks = RANK;
+    config->banks = BANKS;
+    config->timing = (DramTiming){ RAS_TIME, PRECHARGE_TIME, CAS_TIME, TRAS_TIME, TRRD_TIME,
+                                   TFAW_TIME, TBURST_TIME, TREFI_TIME, TRFC_TIME };
+    config->page_policy = PAGE_OPEN;
+    config->page_timeout = PAGE_TIMEOUT_CYCLES;
 }
 
-// Function for row interleaving: translate an address to bank, row, and column
-void row_interleaving(uint32_t address, int *bank, int *row, int *col) {
-    int col_bits = calculate_bits_needed(COLUMNS); // Bits needed for columns
-    int bank_bits = calculate_bits_needed(BANKS);  // Bits needed for banks
-    int row_bits = 32 - (col_bits + bank_bits + 2); // Remaining bits for rows (address is 32 bits)
-
-    *col = (int)((address >> 2) & ((uint32_t)(1 << col_bits) - 1));     // Column is determined by bits 2 to (2+col_bits-1)
-    *bank = (int)((address >> (2 + col_bits)) & ((uint32_t)(1 << bank_bits) - 1)); // Bank is determined by bits (2+col_bits) to (2+col_bits+bank_bits-1)
-    *row = (int)((address >> (2 + col_bits + bank_bits)) & ((uint32_t)(1 << row_bits) - 1));  // Row is determined by the remaining bits
+static int is_power_of_two(int value) {
+    return value > 0 && (value & (value - 1)) == 0;
 }
 
-// Function for cache block interleaving: translate an address to bank, row, and column
-void cache_block_interleaving(uint32_t address, int *bank, int *row, int *col) {
-    int cache_block_offset_bits = calculate_bits_needed(CACHE_BLOCK_SIZE); // Bits needed for cache block offset
-    int col_bits = calculate_bits_needed(COLUMNS); // Bits needed for columns
-    int bank_bits = calculate_bits_needed(BANKS);  // Bits needed for banks
-    int row_bits = 32 - (cache_block_offset_bits + bank_bits); // Remaining bits for rows
-
-    *bank = (int)((address >> cache_block_offset_bits) & ((uint32_t)(1 << bank_bits) - 1)); // Bank is determined by bits after cache block offset
-    *col = (int)((address & ((uint32_t)(1 << cache_block_offset_bits) - 1)) | ((address >> (cache_block_offset_bits + bank_bits)) & ((uint32_t)((1 << col_bits) - 1) << cache_block_offset_bits))); // Column determined by cache block offset and next bits
-    *row = (int)((address >> (cache_block_offset_bits + bank_bits)) & ((uint32_t)(1 << row_bits) - 1)); // Row is determined by remaining bits
-}
-// Hypothetical function to simulate sending the address to the cache
-int send_to_cache(uint32_t address, int latency) {
-    printf("Address 0x%08x is sent to the cache with latency %d cycles.\n", address, latency);
-    return latency;
+// Returns 1 if the organisation can be simulated, otherwise prints why not.
+int validate_dram_config(const DramConfig* config) {
+    if (!is_power_of_two(config->channels) || !is_power_of_two(config->ranks) || !is_power_of_two(config->banks)) {
+        fprintf(stderr, "DRAM: channels, ranks and banks must be powers of two\n");
+        return 0;
+    }
+    const DramTiming* t = &config->timing;
+    if (t->tRCD < 0 || t->tRP < 0 || t->tCL < 0 || t->tRAS < 0 || t->tRRD < 0 || t->tFAW < 0 ||
+        t->tBURST < 0 || t->tREFI < 0 || t->tRFC < 0 || config->page_timeout < 0) {
+        fprintf(stderr, "DRAM: timings must not be negative\n");
+        return 0;
+    }
+    if (t->tREFI > 0 && t->tRFC >= t->tREFI) {
+        fprintf(stderr, "DRAM: tRFC must be shorter than tREFI\n");
+        return 0;
+    }
+    AddressMapping mapping;
+    return compile_address_mapping(config->mapping, calculate_bits_needed(config->channels),
+                                   calculate_bits_needed(config->ranks), calculate_bits_needed(config->banks), &mapping);
 }
 
-// Function to access a specific address in DRAM through the controller
-uint32_t access_dram(DRAM *dram, uint32_t address, int *total_latency, void (*address_mapping)(uint32_t, int*, int*, int*)) {
-    int bank, row, col;
-    int latency = 0;
-
-    // Translate the address using the provided mapping function
-    address_mapping(address, &bank, &row, &col);
-
-    // Access the specified bank, row, and column
-    DRAMBank *current_bank = &dram->banks[bank];
-
-    // Store the previously active row
-    int previous_active_row = current_bank->active_row;
-
-    if (strcmp(Mapping_Method, "Cache block interleaving") == 0) {
-        // Cache block interleaving logic
-        if (current_bank->active_row != row) {
-            // If there was a previously active row, add precharge latency
-            if (previous_active_row != -1) {
-                latency += PRECHARGE_TIME;
-            }
-            // Add RAS latency to activate the new row
-            latency += RAS_TIME;
-            current_bank->active_row = row;
-        }
-    } else {
-        // Row interleaving logic
-        if (current_bank->active_row != row) {
-            // If there was a previously active row, add precharge latency
-            if (previous_active_row != -1) {
-                latency += PRECHARGE_TIME;
-            }
-            // Add RAS latency to activate the new row
-            latency += RAS_TIME;
-            current_bank->active_row = row;
+void init_dram(DRAM* dram, const DramConfig* config) {
+    memset(dram, 0, sizeof(DRAM));
+    dram->config = *config;
+    dram->channel_bits = calculate_bits_needed(config->channels);
+    dram->rank_bits = calculate_bits_needed(config->ranks);
+    dram->bank_bits = calculate_bits_needed(config->banks);
+    dram->num_banks = config->channels * config->ranks * config->banks;
+    dram->banks = (DRAMBank*)calloc((size_t)dram->num_banks, sizeof(DRAMBank));
+    dram->ranks = (DRAMRank*)calloc((size_t)(config->channels * config->ranks), sizeof(DRAMRank));
+    dram->channels = (DRAMChannel*)calloc((size_t)config->channels, sizeof(DRAMChannel));
+    if (dram->banks == NULL || dram->ranks == NULL || dram->channels == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < dram->num_banks; i++) {
+        dram->banks[i].active_row = -1;
+        dram->banks[i].activated_at = -config->timing.tRAS;
+        dram->banks[i].close_at = -1;
+        dram->banks[i].last_row = -1;
+        dram->banks[i].predictor = 2;
+    }
+    for (int i = 0; i < config->channels * config->ranks; i++) {
+        dram->ranks[i].last_activate = -config->timing.tRRD;
+        for (int j = 0; j < 4; j++) {
+            dram->ranks[i].activates[j] = -config->timing.tFAW;
         }
+        dram->ranks[i].next_refresh = config->timing.tREFI > 0 ? config->timing.tREFI : -1;
     }
+    // The config has been validated, so the mapping compiles
+    compile_address_mapping(config->mapping, dram->channel_bits, dram->rank_bits, dram->bank_bits, &dram->mapping);
+}
 
-    // Add CAS latency for accessing the column
-    latency += CAS_TIME;
-
-    // Send the address and latency to the cache
-    
-    //send_to_cache(address, latency);
-
-    // Update the global time and the bank's last accessed time
-    dram->time += latency;
-    current_bank->time_last_accessed = dram->time;
-
-    // Update the last accessed address
-    last_accessed_address = address;
-
-    *total_latency = latency;
-    return address; // Return the accessed address
+void free_dram(DRAM* dram) {
+    free(dram->banks);
+    free(dram->ranks);
+    free(dram->channels);
+    dram->banks = NULL;
+    dram->ranks = NULL;
+    dram->channels = NULL;
 }
 
-// Function to simulate DRAM access and return address and latency
+static long long max_time(long long a, long long b) {
+    return a > b ? a : b;
+}
 
-int simulate_dram_access(uint32_t address) {
-    static DRAM dram = {0}; // Declare and initialize a DRAM structure (static to retain state across calls)
-    // Initialize DRAM banks if this is the first access
-    if (dram.banks[0].active_row == 0 && dram.banks[0].time_last_accessed == 0 && dram.time == 0) {
-        for (int i = 0; i < BANKS; i++) {
-            dram.banks[i].active_row = -1;
-            dram.banks[i].time_last_accessed = 0;
+// Runs every refresh of the rank due by time t: all of its banks are
+// closed and blocked for tRFC. Returns the earliest time after them.
+static long long refresh_rank(DRAM* dram, int rank_index, long long t) {
+    DRAMRank* rank = &dram->ranks[rank_index];
+    const DramTiming* timing = &dram->config.timing;
+    while (rank->next_refresh >= 0 && rank->next_refresh <= t) {
+        long long done = rank->next_refresh + timing->tRFC;
+        DRAMBank* banks = dram->banks + (size_t)rank_index * (size_t)dram->config.banks;
+        for (int b = 0; b < dram->config.banks; b++) {
+            banks[b].active_row = -1;
+            banks[b].ready = max_time(banks[b].ready, done);
         }
+        t = max_time(t, done);
+        rank->next_refresh += timing->tREFI;
+        dram->stats.refreshes++;
     }
+    return t;
+}
 
-    int total_latency;
-    void (*address_mapping)(uint32_t, int*, int*, int*);
-
-    // Set the address mapping function based on user choice
-    if (strcmp(Mapping_Method, "Row interleaving") == 0) {
-        address_mapping = row_interleaving;
-        //printf("Using Row Interleaving:\n");
-    } else if (strcmp(Mapping_Method, "Cache block interleaving") == 0) {
-        address_mapping = cache_block_interleaving;
-        //printf("Using Cache Block Interleaving:\n");
+// Issues a read of address at cycle issue and returns the cycle its data
+// starts to arrive. The bank opens the row (closing any other after tRAS
+// and tRP) subject to the rank's tRRD and tFAW, then the column read waits
+// tCL and for the channel's data bus.
+long long dram_access_at(DRAM* dram, address_t address, long long issue) {
+    const DramTiming* timing = &dram->config.timing;
+    DramLocation location;
+    map_dram_address(dram, address, &location);
+    int rank_index = location.channel * dram->config.ranks + location.rank;
+    DRAMBank* bank = &dram->banks[dram_bank_index(dram, &location)];
+    DRAMRank* rank = &dram->ranks[rank_index];
+    DRAMChannel* channel = &dram->channels[location.channel];
+
+    long long t = max_time(issue, bank->ready);
+    t = refresh_rank(dram, rank_index, t);
+    long long activate = t;
+    if (bank->active_row != -1 && bank->close_at >= 0 && t >= bank->close_at) {
+        // The page policy closed the row while the bank sat idle
+        activate = max_time(t, max_time(bank->close_at, bank->activated_at + timing->tRAS) + timing->tRP);
+        bank->active_row = -1;
+    }
+    if (bank->last_row >= 0) {
+        int same_row = bank->last_row == location.row;
+        if (same_row && bank->predictor < 3) bank->predictor++;
+        if (!same_row && bank->predictor > 0) bank->predictor--;
+    }
+    bank->last_row = location.row;
+
+    long long column;
+    if (bank->active_row == location.row) {
+        dram->stats.row_hits++;
+#ifdef INSTRUMENT
+        bank->row_hits++;
+#endif
+        column = t;
     } else {
-        printf("Invalid choice. Exiting.\n");
-        return -1;
+        if (bank->active_row != -1) {
+            // Precharge the open row first
+            dram->stats.row_conflicts++;
+#ifdef INSTRUMENT
+            bank->row_conflicts++;
+#endif
+            activate = max_time(t, bank->activated_at + timing->tRAS) + timing->tRP;
+        } else {
+            dram->stats.row_misses++;
+        }
+        activate = max_time(activate, rank->last_activate + timing->tRRD);
+        activate = max_time(activate, rank->activates[rank->next_activate] + timing->tFAW);
+        rank->last_activate = activate;
+        rank->activates[rank->next_activate] = activate;
+        rank->next_activate = (rank->next_activate + 1) % 4;
+        bank->activated_at = activate;
+        bank->active_row = location.row;
+        column = activate + timing->tRCD;
     }
 
-    // Access the address in DRAM
-    access_dram(&dram, address, &total_latency, address_mapping);
+    long long data = max_time(column + timing->tCL, channel->bus_free);
+    channel->bus_free = data + timing->tBURST;
+    channel->busy_cycles += (unsigned long long)timing->tBURST;
+    bank->ready = data - timing->tCL + timing->tBURST;
+    bank->time_last_accessed = data;
+    bank->accesses++;
+    switch (dram->config.page_policy) {
+        case PAGE_OPEN:
+            bank->close_at = -1;
+            break;
+        case PAGE_CLOSED:
+            bank->close_at = column; // Read with auto-precharge
+            break;
+        case PAGE_TIMEOUT:
+            bank->close_at = data + dram->config.page_timeout;
+            break;
+        case PAGE_ADAPTIVE:
+            bank->close_at = bank->predictor >= 2 ? -1 : column;
+            break;
+    }
 
-    return total_latency;
+    dram->stats.accesses++;
+    dram->time = max_time(dram->time, data);
+    // Update the last accessed address
+    dram->last_accessed_address = address;
+    return data;
+}
+
+// Back-to-back access: issues at the completion of the previous request
+// and returns the latency.
+int simulate_dram_access(DRAM* dram, address_t address) {
+    long long issue = dram->time;
+    return (int)(dram_access_at(dram, address, issue) - issue);
 }
 /*/
 // Function to print the state of the DRAM banks
@@ -192,98 +233,11 @@ void print_dram_state(DRAM *dram) {
     printf("-------------------------------------------------------------\n");
     printf("Bank | Active Row | Last Accessed Time\n");
     printf("-------------------------------------------------------------\n");
-    for (int i = 0; i < BANKS; i++) {
-        printf("%-4d | %-10d | %-18d\n", i, dram->banks[i].active_row, dram->banks[i].time_last_accessed);
+    for (int i = 0; i < dram->num_banks; i++) {
+        printf("%-4d | %-10d | %-18lld\n", i, dram->banks[i].active_row, dram->banks[i].time_last_accessed);
     }
     printf("-------------------------------------------------------------\n");
-    printf("Global Time: %d\n", dram->time);
+    printf("Global Time: %lld\n", dram->time);
 }
 
-// Function to read addresses from a file
-int read_addresses_from_file(const char *filename, uint32_t **addresses) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
-        printf("Failed to open file %s\n", filename);
-        return 0;
-    }
-
-    int count = 0;
-    uint32_t address;
-    while (fscanf(file, "%x", &address) != EOF) {
-        count++;
-    }
-
-    rewind(file);
-    *addresses = (uint32_t *)malloc((size_t)count * sizeof(uint32_t)); // Explicitly cast count to size_t
-    for (int i = 0; i < count; i++) {
-        fscanf(file, "%x", &(*addresses)[i]);
-    }
-
-    fclose(file);
-    return count;
-}
-
-// Main function to demonstrate the DRAM access simulation
-int main() {
-    DRAM dram = {0}; // Declare and initialize a DRAM structure
-    // Initialize DRAM banks
-    for (int i = 0; i < BANKS; i++) {
-        dram.banks[i].active_row = -1;
-        dram.banks[i].time_last_accessed = 0;
-    }
-
-    uint32_t *addresses;
-    int num_addresses = read_addresses_from_file("address.txt", &addresses);
-
-    if (num_addresses == 0) {
-        printf("No addresses to process. Exiting.\n");
-        return 1;
-    }
-
-    void (*address_mapping)(uint32_t, int*, int*, int*);
-    // Set the address mapping function based on user choice
-    if (strcmp(Mapping_Method, "Row interleaving") == 0) {
-        address_mapping = row_interleaving;
-        printf("Using Row Interleaving:\n");
-    } else if (strcmp(Mapping_Method, "Cache block interleaving") == 0) {
-        address_mapping = cache_block_interleaving;
-        printf("Using Cache Block Interleaving:\n");
-    } else {
-        printf("Invalid choice. Exiting.\n");
-        free(addresses);
-        return 1;
-    }
-
-    // Add requests to the queue
-    for (int i = 0; i < num_addresses; i++) {
-        add_request(addresses[i], dram.time);
-    }
-
-    // Process the requests
-    while (queue_size > 0) {
-        int next_request_index = get_next_request_index();
-        if (next_request_index == -1) break;
-
-        uint32_t address = request_queue[next_request_index].address;
-        int total_latency;
-        access_dram(&dram, address, &total_latency, address_mapping);
-
-        // Remove the processed request from the queue
-        for (int i = next_request_index; i < queue_size - 1; i++) {
-            request_queue[i] = request_queue[i + 1];
-        }
-        queue_size--;
-    }
-
-    // Print the last accessed address
-    printf("Last accessed address: 0x%08x\n", last_accessed_address);
-
-    // Print the state of the DRAM banks
-    print_dram_state(&dram);
-
-    // Free the allocated memory
-    free(addresses);
-
-    return 0;
-}
 /*/
\ No newline at end of file
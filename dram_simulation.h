@@ -2,8 +2,150 @@
 #define DRAM_SIMULATION_H
 
 #include <stdint.h>
+#include "address.h"
+#include "address_mapping.h"
 
-int simulate_dram_access(uint32_t address);
+#define BUS_WIDTH 4
+#define CHANNELS 1
+#define DIMMS 1
+#define BANKS 4
+#define ROWS 262144 // 2^18 rows
+#define COLUMNS 1024 // 2^10 columns
+#define RAS_TIME 100
+#define CAS_TIME 50
+#define RANK 1
+#define CACHE_BLOCK_SIZE 64 // Assuming 64 bytes cache block
+#define PRECHARGE_TIME 50 // Hypothetical precharge time
+
+// Default timing constraints, in the same cycles as the caches. RAS_TIME,
+// CAS_TIME and PRECHARGE_TIME double as tRCD, tCL and tRP, and the rest
+// are loose enough that back-to-back requests cost what they always did.
+#define TRAS_TIME 150  // ACT to PRE, same bank
+#define TRRD_TIME 15   // ACT to ACT, different banks of a rank
+#define TFAW_TIME 75   // Window holding at most four ACTs per rank
+#define TBURST_TIME 10 // Data bus cycles per cache-block transfer
+#define TREFI_TIME 0   // Refresh interval per rank (0 disables refresh)
+#define TRFC_TIME 0    // Duration of one refresh
+#define PAGE_TIMEOUT_CYCLES 200 // Idle cycles before the timeout policy closes a row
+
+typedef enum {
+    PAGE_OPEN,     // Rows stay open until another row is needed
+    PAGE_CLOSED,   // Every access auto-precharges its row
+    PAGE_TIMEOUT,  // Rows close after page_timeout idle cycles
+    PAGE_ADAPTIVE  // Per-bank 2-bit predictor of whether the next access hits the open row
+} PagePolicy;
+
+typedef struct {
+    int tRCD;   // ACT to READ
+    int tRP;    // PRE to ACT
+    int tCL;    // READ to first data
+    int tRAS;   // ACT to PRE
+    int tRRD;   // ACT to ACT within a rank
+    int tFAW;   // Four-activate window
+    int tBURST; // Data bus occupancy per request
+    int tREFI;  // Refresh interval
+    int tRFC;   // Refresh cycle time
+} DramTiming;
+
+typedef struct {
+    char mapping[MAX_MAPPING_SPEC]; // Built-in mapping name or mapping spec
+    int channels;
+    int ranks; // Per channel
+    int banks; // Per rank
+    DramTiming timing;
+    PagePolicy page_policy;
+    int page_timeout;
+} DramConfig;
+
+// Where an address lands in the DRAM
+typedef struct {
+    int channel;
+    int rank;
+    int bank; // Within the rank
+    int row;
+    int col;
+} DramLocation;
+
+// Structure representing a DRAM bank
+typedef struct {
+    int active_row;              // Currently active row in the bank (-1 if no row is active)
+    long long time_last_accessed; // Time when the bank was last accessed
+    long long ready;             // Earliest cycle the bank takes its next command
+    long long activated_at;      // Cycle of the last ACT, for tRAS
+    unsigned long long accesses;
+    long long close_at;          // Cycle the page policy closes the open row (-1 = stays open)
+    int last_row;                // Row of the previous access, for the adaptive predictor
+    unsigned char predictor;     // 0-1 predict close, 2-3 predict keep open
+#ifdef INSTRUMENT
+    unsigned long long row_hits;
+    unsigned long long row_conflicts;
+#endif
+} DRAMBank;
+
+typedef struct {
+    long long last_activate;  // For tRRD
+    long long activates[4];   // Last four ACTs, for tFAW
+    int next_activate;
+    long long next_refresh;
+} DRAMRank;
+
+typedef struct {
+    long long bus_free; // Cycle the data bus is next idle
+    unsigned long long busy_cycles;
+} DRAMChannel;
+
+typedef struct {
+    unsigned long long accesses;
+    unsigned long long row_hits;      // Row already open
+    unsigned long long row_misses;    // Bank idle, row had to be opened
+    unsigned long long row_conflicts; // Another row had to be closed first
+    unsigned long long refreshes;
+} DramStats;
+
+// Structure representing the entire DRAM. Banks, ranks and channels each
+// track when they are next free, so requests to different banks overlap
+// and only share the command timing of their rank and the data bus of
+// their channel.
+typedef struct {
+    DramConfig config;
+    int num_banks;          // channels * ranks * banks
+    int channel_bits;
+    int rank_bits;
+    int bank_bits;
+    DRAMBank* banks;        // Indexed by dram_bank_index()
+    DRAMRank* ranks;        // channels * ranks
+    DRAMChannel* channels;
+    long long time;         // Completion time of the latest request
+    address_t last_accessed_address;
+    AddressMapping mapping;
+    DramStats stats;
+} DRAM;
+
+static inline void map_dram_address(const DRAM* dram, address_t address, DramLocation* location) {
+    location->channel = map_address_field(&dram->mapping.fields[FIELD_CHANNEL], address);
+    location->rank = map_address_field(&dram->mapping.fields[FIELD_RANK], address);
+    location->bank = map_address_field(&dram->mapping.fields[FIELD_BANK], address);
+    location->row = map_address_field(&dram->mapping.fields[FIELD_ROW], address);
+    location->col = map_address_field(&dram->mapping.fields[FIELD_COL], address);
+}
+
+// Row open in the bank at cycle t under the page policy, or -1.
+static inline int dram_open_row(const DRAM* dram, int bank, long long t) {
+    const DRAMBank* b = &dram->banks[bank];
+    return b->close_at >= 0 && t >= b->close_at ? -1 : b->active_row;
+}
+
+static inline int dram_bank_index(const DRAM* dram, const DramLocation* location) {
+    return (location->channel * dram->config.ranks + location->rank) * dram->config.banks + location->bank;
+}
+
+const char* page_policy_name(PagePolicy policy);
+int parse_page_policy(const char* name, PagePolicy* policy);
+void default_dram_config(DramConfig* config);
+int validate_dram_config(const DramConfig* config);
+void init_dram(DRAM* dram, const DramConfig* config);
+void free_dram(DRAM* dram);
+long long dram_access_at(DRAM* dram, address_t address, long long issue);
+int simulate_dram_access(DRAM* dram, address_t address);
 
 #endif // DRAM_SIMULATION_H
-    
\ No newline at end of file
@@ -3,22 +3,16 @@
 #include <string.h>
 #include <time.h>
 #include "extract_address_trace.h"
-
-#define MAX_LINE_LENGTH 256
-char instruction[5];
-char reg1[3], reg2[3];
-int offset;
-unsigned int address1, address2;
-int count = 0;
+#include "trace_stream.h"
 
 void print_registers(const Register registers[], int num_registers) {
     printf("Initial register addresses:\n");
     for (int i = 0; i < num_registers; i++) {
-        printf("%s: 0x%08X\n", registers[i].name, registers[i].address);
+        printf("%s: 0x" ADDRESS_FORMAT "\n", registers[i].name, registers[i].address);
     }
 }
 
-unsigned int get_register_address(const Register registers[], int num_registers, const char *name) {
+address_t get_register_address(const Register registers[], int num_registers, const char *name) {
     for (int i = 0; i < num_registers; i++) {
         if (strcmp(registers[i].name, name) == 0) {
             return registers[i].address;
@@ -27,7 +21,7 @@ unsigned int get_register_address(const Register registers[], int num_registers,
     return 0;
 }
 
-void update_register_address(Register registers[], int num_registers, const char *name, unsigned int address) {
+void update_register_address(Register registers[], int num_registers, const char *name, address_t address) {
     for (int i = 0; i < num_registers; i++) {
         if (strcmp(registers[i].name, name) == 0) {
             registers[i].address = address;
@@ -36,19 +30,27 @@ void update_register_address(Register registers[], int num_registers, const char
     }
 }
 
-void send_to_cache_simulator(const char *reg_name, unsigned int address) {
-    printf("Register %s: Final address 0x%08X sent to cache memory simulator\n", reg_name, address);
+void send_to_cache_simulator(const char *reg_name, address_t address) {
+    printf("Register %s: Final address 0x" ADDRESS_FORMAT " sent to cache memory simulator\n", reg_name, address);
 }
 
-unsigned int process_command(char *command, Register registers[], int num_registers) {
-    if (sscanf(command, "Info %s %x -> %x", reg1, &address1, &address2) == 3) {
+// Original sscanf-based parser. Kept as the reference that
+// benchmark_trace_parser checks process_command against.
+address_t process_command_sscanf(char *command, Register registers[], int num_registers, int *replaces_previous) {
+    char instruction[MAX_LINE_LENGTH];
+    char reg1[MAX_LINE_LENGTH], reg2[MAX_LINE_LENGTH];
+    int offset;
+    address_t address1, address2;
+
+    *replaces_previous = 0;
+    if (sscanf(command, "Info %s " ADDRESS_SCAN " -> " ADDRESS_SCAN, reg1, &address1, &address2) == 3) {
         update_register_address(registers, num_registers, reg1, address2);
         //send_to_cache_simulator(reg1, address2);
-        count--;
+        *replaces_previous = 1;
         return address2;
     } else if (sscanf(command, "%s %[^,],%d(%[^)])", instruction, reg1, &offset, reg2) == 4) {
-        unsigned int base_address = get_register_address(registers, num_registers, reg2);
-        unsigned int final_address = base_address + (unsigned int)offset;
+        address_t base_address = get_register_address(registers, num_registers, reg2);
+        address_t final_address = base_address + (address_t)offset;
 
         if (strcmp(instruction, "lw") == 0 || strcmp(instruction, "sw") == 0) {
             //send_to_cache_simulator(strcmp(instruction, "lw") == 0 ? reg1 : reg2, final_address);// Send the address to the cache simulator
@@ -63,8 +65,8 @@ unsigned int process_command(char *command, Register registers[], int num_regist
         return final_address;
     } else if (sscanf(command, "%s %[^,],%[^,],%d", instruction, reg1, reg2, &offset) == 4) {
         if (strcmp(instruction, "addi") == 0) {
-            unsigned int src_address = get_register_address(registers, num_registers, reg2);
-            unsigned int new_address = src_address + (unsigned int)offset;
+            address_t src_address = get_register_address(registers, num_registers, reg2);
+            address_t new_address = src_address + (address_t)offset;
             update_register_address(registers, num_registers, reg1, new_address);
             //send_to_cache_simulator(reg1, new_address);  // Send the new address to the cache simulator
             return new_address;
@@ -73,8 +75,255 @@ unsigned int process_command(char *command, Register registers[], int num_regist
     return 0;
 }
 
-int extract_addresses_from_file(const char *filename, unsigned int **addresses) {
-    Register registers[NUM_REGISTERS] = {
+static int is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+static const char* skip_spaces(const char *p) {
+    while (is_space(*p)) {
+        p++;
+    }
+    return p;
+}
+
+// Same token rules as scanf "%s": skips leading whitespace and reads at
+// least one non-whitespace character.
+static const char* scan_word(const char *p, const char **word, size_t *length) {
+    p = skip_spaces(p);
+    const char *start = p;
+    while (*p != '\0' && !is_space(*p)) {
+        p++;
+    }
+    *word = start;
+    *length = (size_t)(p - start);
+    return p == start ? NULL : p;
+}
+
+// Same as scanf "%[^c]": at least one character up to (not including) stop.
+static const char* scan_until(const char *p, char stop, const char **word, size_t *length) {
+    const char *start = p;
+    while (*p != '\0' && *p != stop) {
+        p++;
+    }
+    *word = start;
+    *length = (size_t)(p - start);
+    return p == start ? NULL : p;
+}
+
+// Same as scanf "%d".
+static const char* scan_decimal(const char *p, int *value) {
+    p = skip_spaces(p);
+    int negative = 0;
+    if (*p == '-' || *p == '+') {
+        negative = *p == '-';
+        p++;
+    }
+    if (*p < '0' || *p > '9') {
+        return NULL;
+    }
+    unsigned long long result = 0;
+    while (*p >= '0' && *p <= '9') {
+        result = result * 10 + (unsigned long long)(*p - '0');
+        p++;
+    }
+    *value = (int)(negative ? 0 - result : result);
+    return p;
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Same as scanf "%x", including an optional sign and 0x prefix.
+static const char* scan_hex(const char *p, address_t *value) {
+    p = skip_spaces(p);
+    int negative = 0;
+    if (*p == '-' || *p == '+') {
+        negative = *p == '-';
+        p++;
+    }
+    if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X') && hex_digit(p[2]) >= 0) {
+        p += 2;
+    }
+    if (hex_digit(*p) < 0) {
+        return NULL;
+    }
+    unsigned long long result = 0;
+    int digit;
+    while ((digit = hex_digit(*p)) >= 0) {
+        result = (result << 4) | (unsigned long long)digit;
+        p++;
+    }
+    *value = (address_t)(negative ? 0 - result : result);
+    return p;
+}
+
+// Maps a register name onto its position in init_registers(), or -1.
+int register_index(const char *name, size_t length) {
+    if (length == 2) {
+        char c = name[1];
+        switch (name[0]) {
+            case 'r': return c == 'a' ? 0 : -1;
+            case 's':
+                if (c == 'p') return 1;
+                return (c >= '0' && c <= '9') ? 17 + (c - '0') : -1;
+            case 'a': return (c >= '0' && c <= '7') ? 2 + (c - '0') : -1;
+            case 't': return (c >= '0' && c <= '6') ? 10 + (c - '0') : -1;
+            case 'x': return (c >= '0' && c <= '2') ? 29 + (c - '0') : -1;
+            default: return -1;
+        }
+    }
+    if (length == 3 && name[0] == 's' && name[1] == '1' && (name[2] == '0' || name[2] == '1')) {
+        return 27 + (name[2] - '0');
+    }
+    return -1;
+}
+
+// Load/store width from RISC-V mnemonics such as lw, sd, lbu or fld
+static unsigned char classify_access(const char *word, size_t length) {
+    if (length >= 3 && word[0] == 'f') {
+        word++;
+        length--;
+    }
+    if (length < 2 || length > 3 || (word[0] != 'l' && word[0] != 's')) {
+        return TRACE_ACCESS(ACCESS_OTHER, 0);
+    }
+    if (length == 3 && (word[0] != 'l' || word[2] != 'u')) {
+        return TRACE_ACCESS(ACCESS_OTHER, 0);
+    }
+    int type = word[0] == 'l' ? ACCESS_LOAD : ACCESS_STORE;
+    switch (word[1]) {
+        case 'b': return TRACE_ACCESS(type, 0);
+        case 'h': return TRACE_ACCESS(type, 1);
+        case 'w': return TRACE_ACCESS(type, 2);
+        case 'd': return TRACE_ACCESS(type, 3);
+        default: return TRACE_ACCESS(ACCESS_OTHER, 0);
+    }
+}
+
+// Decodes one trace line in a single pass, without touching register
+// state. Accepts exactly what the three sscanf patterns of
+// process_command_sscanf accept.
+void decode_command(const char *command, TraceOp *op) {
+    const char *word, *reg;
+    size_t word_length, reg_length;
+    const char *p;
+
+    op->opcode = TRACE_OP_NONE;
+    op->dst = -1;
+    op->base = -1;
+    op->access = TRACE_ACCESS(ACCESS_OTHER, 0);
+    op->literal = 0;
+
+    // "Info %s " ADDRESS_SCAN " -> " ADDRESS_SCAN
+    if (strncmp(command, "Info", 4) == 0 && (p = scan_word(command + 4, &reg, &reg_length)) != NULL) {
+        address_t old_value, new_value;
+        if ((p = scan_hex(p, &old_value)) != NULL) {
+            p = skip_spaces(p);
+            if (p[0] == '-' && p[1] == '>' && scan_hex(p + 2, &new_value) != NULL) {
+                op->opcode = TRACE_OP_INFO;
+                op->dst = (signed char)register_index(reg, reg_length);
+                op->literal = new_value;
+                return;
+            }
+        }
+    }
+
+    // Both remaining patterns start with "%s %[^,],"
+    const char *first = scan_word(command, &word, &word_length);
+    if (first == NULL) {
+        return;
+    }
+    first = scan_until(skip_spaces(first), ',', &reg, &reg_length);
+    if (first == NULL || *first != ',') {
+        return;
+    }
+    first++;
+
+    // "%s %[^,],%d(%[^)])"
+    int offset;
+    const char *base;
+    size_t base_length;
+    p = scan_decimal(first, &offset);
+    if (p != NULL && *p == '(' && scan_until(p + 1, ')', &base, &base_length) != NULL) {
+        if (word_length == 2 && word[1] == 'w' && (word[0] == 'l' || word[0] == 's')) {
+            op->opcode = word[0] == 'l' ? TRACE_OP_LOAD : TRACE_OP_STORE;
+            op->dst = (signed char)register_index(reg, reg_length);
+        } else {
+            op->opcode = TRACE_OP_MEMORY;
+        }
+        op->access = classify_access(word, word_length);
+        op->base = (signed char)register_index(base, base_length);
+        op->literal = (address_t)offset;
+        return;
+    }
+
+    // "%s %[^,],%[^,],%d"
+    if (word_length == 4 && strncmp(word, "addi", 4) == 0) {
+        p = scan_until(first, ',', &base, &base_length);
+        if (p != NULL && *p == ',' && scan_decimal(p + 1, &offset) != NULL) {
+            op->opcode = TRACE_OP_ADDI;
+            op->dst = (signed char)register_index(reg, reg_length);
+            op->base = (signed char)register_index(base, base_length);
+            op->literal = (address_t)offset;
+        }
+    }
+}
+
+static address_t read_register(const Register registers[], int num_registers, int index) {
+    return (index >= 0 && index < num_registers) ? registers[index].address : 0;
+}
+
+static void write_register(Register registers[], int num_registers, int index, address_t address) {
+    if (index >= 0 && index < num_registers) {
+        registers[index].address = address;
+    }
+}
+
+// Applies a decoded line to the register file and returns its address.
+// registers[] must be laid out as init_registers() leaves it.
+address_t resolve_trace_op(const TraceOp *op, Register registers[], int num_registers, int *replaces_previous) {
+    *replaces_previous = 0;
+    address_t address;
+    switch (op->opcode) {
+        case TRACE_OP_INFO:
+            write_register(registers, num_registers, op->dst, op->literal);
+            *replaces_previous = 1;
+            return op->literal;
+        case TRACE_OP_LOAD:
+        case TRACE_OP_STORE:
+            address = read_register(registers, num_registers, op->base) + op->literal;
+            write_register(registers, num_registers, op->dst, address);
+            // For 'sw' commands, update the base register address
+            if (op->opcode == TRACE_OP_STORE) {
+                write_register(registers, num_registers, op->base, address);
+            }
+            return address;
+        case TRACE_OP_MEMORY:
+            return read_register(registers, num_registers, op->base) + op->literal;
+        case TRACE_OP_ADDI:
+            address = read_register(registers, num_registers, op->base) + op->literal;
+            write_register(registers, num_registers, op->dst, address);
+            return address;
+        default:
+            return 0;
+    }
+}
+
+// Info lines report the resolved value of the previous instruction, so
+// *replaces_previous is set and the caller overwrites the last address
+// (or drops it when the resolved value is 0).
+address_t process_command(char *command, Register registers[], int num_registers, int *replaces_previous) {
+    TraceOp op;
+    decode_command(command, &op);
+    return resolve_trace_op(&op, registers, num_registers, replaces_previous);
+}
+
+void init_registers(Register registers[]) {
+    static const Register initial_registers[NUM_REGISTERS] = {
         {"ra", 0x00000000}, {"sp", 0xd53a2000}, {"a0", 0x3000598a}, {"a1", 0x4023adc9},
         {"a2", 0xffaac532}, {"a3", 0xff6584ff}, {"a4", 0x1258cddf}, {"a5", 0x89cc2235},
         {"a6", 0x13235eee}, {"a7", 0xabb12899}, {"t0", 0xaa232210}, {"t1", 0xc0035894},
@@ -84,41 +333,183 @@ int extract_addresses_from_file(const char *filename, unsigned int **addresses)
         {"s7", 0x19985520}, {"s8", 0xba61A000}, {"s9", 0x1B0d0334}, {"s10", 0x1C0211fd},
         {"s11", 0x1D045ddf}, {"x0", 0x1E0ffd20}, {"x1", 0xff81F000}, {"x2", 0xfa620000}
     };
+    memcpy(registers, initial_registers, sizeof(initial_registers));
+}
+
+// Collects the whole trace into one array, and the AccessType of each
+// address into *types unless it is NULL. Prefer open_trace_stream() for
+// long traces: this keeps every address in memory at once.
+int extract_addresses_from_file(const char *filename, address_t **addresses, unsigned char **types) {
+    TraceStream *stream = open_trace_stream(filename);
+    if (stream == NULL) {
+        return 0;
+    }
+
+    size_t capacity = TRACE_CHUNK_SIZE;
+    int count = 0;
+    *addresses = (address_t *)malloc(sizeof(address_t) * capacity);
+    if (types != NULL) {
+        *types = (unsigned char *)malloc(capacity);
+    }
+    if (*addresses == NULL || (types != NULL && *types == NULL)) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    const address_t *chunk;
+    const unsigned char *chunk_types;
+    int chunk_count;
+    while ((chunk_count = next_trace_chunk(stream, &chunk, &chunk_types)) > 0) {
+        if ((size_t)count + (size_t)chunk_count > capacity) {
+            capacity *= 2;
+            address_t *grown = (address_t *)realloc(*addresses, sizeof(address_t) * capacity);
+            if (grown == NULL) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(EXIT_FAILURE);
+            }
+            *addresses = grown;
+            if (types != NULL) {
+                unsigned char *grown_types = (unsigned char *)realloc(*types, capacity);
+                if (grown_types == NULL) {
+                    fprintf(stderr, "Memory allocation failed\n");
+                    exit(EXIT_FAILURE);
+                }
+                *types = grown_types;
+            }
+        }
+        memcpy(*addresses + count, chunk, sizeof(address_t) * (size_t)chunk_count);
+        if (types != NULL) {
+            memcpy(*types + count, chunk_types, (size_t)chunk_count);
+        }
+        count += chunk_count;
+    }
+
+    close_trace_stream(stream);
+    return count;
+}
+void init_trace_resolver(TraceResolver *resolver) {
+    init_registers(resolver->registers);
+    resolver->has_pending = 0;
+}
+
+// Feeds one decoded line. Returns 1 and fills *out when an earlier access
+// is final.
+int resolve_trace_line(TraceResolver *resolver, const TraceOp *op, TraceAccess *out) {
+    int replaces_previous;
+    address_t address = resolve_trace_op(op, resolver->registers, NUM_REGISTERS, &replaces_previous);
+    if (replaces_previous) {
+        if (resolver->has_pending) {
+            resolver->pending.address = address;
+            resolver->has_pending = address != 0;
+        }
+        return 0;
+    }
+    if (address == 0) {
+        return 0;
+    }
+    int ready = resolver->has_pending;
+    if (ready) {
+        *out = resolver->pending;
+    }
+    resolver->pending.address = address;
+    resolver->pending.type = (unsigned char)ACCESS_TYPE(op->access);
+    resolver->pending.size = (unsigned char)ACCESS_SIZE(op->access);
+    resolver->has_pending = 1;
+    return ready;
+}
+
+// Returns the access still held back at the end of the trace, if any.
+int flush_trace_resolver(TraceResolver *resolver, TraceAccess *out) {
+    int ready = resolver->has_pending;
+    if (ready) {
+        *out = resolver->pending;
+        resolver->has_pending = 0;
+    }
+    return ready;
+}
 
-    //print_registers(registers, NUM_REGISTERS);  // Print initial register addresses for debugging
+typedef address_t (*CommandParser)(char *command, Register registers[], int num_registers, int *replaces_previous);
 
-    FILE *inputFile = fopen(filename, "r");
+static double time_parser(CommandParser parser, char *lines, size_t num_lines) {
+    Register registers[NUM_REGISTERS];
+    init_registers(registers);
+    address_t checksum = 0;
+    char *line = lines;
+    clock_t start = clock();
+    for (size_t i = 0; i < num_lines; i++) {
+        int replaces_previous;
+        checksum += parser(line, registers, NUM_REGISTERS, &replaces_previous);
+        line += strlen(line) + 1;
+    }
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    if (checksum == 1) {
+        printf(" ");  // Keeps the loop from being optimized away
+    }
+    return seconds;
+}
+
+// Times the sscanf reference against process_command on the same lines
+// (held in memory so file I/O is not measured) and checks that both
+// produce the same address for every line.
+int benchmark_trace_parser(const char *filename) {
+    FILE *inputFile = fopen(filename, "rb");
     if (inputFile == NULL) {
         perror("Error opening input file");
         return 0;
     }
+    fseek(inputFile, 0, SEEK_END);
+    long size = ftell(inputFile);
+    rewind(inputFile);
+    char *lines = (char *)malloc((size_t)size + 1);
+    if (lines == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t length = fread(lines, 1, (size_t)size, inputFile);
+    fclose(inputFile);
 
-    char line[MAX_LINE_LENGTH];
-    
-    unsigned int *temp_addresses = (unsigned int *)malloc(sizeof(unsigned int) * MAX_REQUESTS);
-
-    while (fgets(line, sizeof(line), inputFile)) {
-        if (line[strlen(line) - 1] == '\n') {
-            line[strlen(line) - 1] = '\0';  // Remove newline character
+    size_t num_lines = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (lines[i] == '\n') {
+            lines[i] = '\0';
+            num_lines++;
         }
-        unsigned int address = process_command(line, registers, NUM_REGISTERS);
-        if (address != 0) {
-            temp_addresses[count++] = address;
+    }
+    if (length > 0 && lines[length - 1] != '\0') {
+        num_lines++;
+    }
+    lines[length] = '\0';
+
+    Register reference[NUM_REGISTERS], fast[NUM_REGISTERS];
+    init_registers(reference);
+    init_registers(fast);
+    size_t mismatches = 0;
+    char *line = lines;
+    for (size_t i = 0; i < num_lines; i++) {
+        int reference_replaces, fast_replaces;
+        address_t expected = process_command_sscanf(line, reference, NUM_REGISTERS, &reference_replaces);
+        address_t actual = process_command(line, fast, NUM_REGISTERS, &fast_replaces);
+        if (expected != actual || reference_replaces != fast_replaces) {
+            if (mismatches++ < 10) {
+                printf("Mismatch on line %zu: \"%s\" sscanf 0x" ADDRESS_FORMAT ", fast 0x" ADDRESS_FORMAT "\n", i + 1, line, expected, actual);
+            }
         }
+        line += strlen(line) + 1;
     }
 
-    fclose(inputFile);
+    double sscanf_seconds = time_parser(process_command_sscanf, lines, num_lines);
+    double fast_seconds = time_parser(process_command, lines, num_lines);
+    free(lines);
 
-    *addresses = (unsigned int *)malloc(sizeof(unsigned int) * (size_t)count);
-    memcpy(*addresses, temp_addresses, sizeof(unsigned int) * (size_t)count);
-    free(temp_addresses);
-    
-    return count;
+    printf("Parsed %zu lines, %zu mismatches\n", num_lines, mismatches);
+    printf("sscanf parser: %.0f lines/sec\n", sscanf_seconds > 0 ? (double)num_lines / sscanf_seconds : 0.0);
+    printf("fast parser:   %.0f lines/sec\n", fast_seconds > 0 ? (double)num_lines / fast_seconds : 0.0);
+    return mismatches == 0;
 }
 /*/
 int main() {
-    unsigned int *addresses;
-    extract_addresses_from_file("address.txt", &addresses);
+    address_t *addresses;
+    extract_addresses_from_file("address.txt", &addresses, NULL);
  
     return 0;
 }
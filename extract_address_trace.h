@@ -1,17 +1,73 @@
 #ifndef EXTRACT_ADDRESS_TRACE_H
 #define EXTRACT_ADDRESS_TRACE_H
 
+#include <stddef.h>
 #include <stdint.h>
+#include "address.h"
 
-#define MAX_REQUESTS 100000000
 #define NUM_REGISTERS 32
+#define MAX_LINE_LENGTH 256
 
 typedef struct {
-    char name[3];
-    unsigned int address;
+    char name[4];
+    address_t address;
 } Register;
 
-unsigned int process_command(char *command, Register registers[], int num_registers);
-int extract_addresses_from_file(const char *filename, unsigned int **addresses);
+typedef enum {
+    TRACE_OP_NONE,   // Line produces no address
+    TRACE_OP_INFO,   // Info reg old -> new
+    TRACE_OP_LOAD,   // lw rd,offset(base)
+    TRACE_OP_STORE,  // sw rs,offset(base)
+    TRACE_OP_MEMORY, // Any other op,offset(base): address only
+    TRACE_OP_ADDI    // addi rd,rs,imm
+} TraceOpcode;
+
+typedef enum {
+    ACCESS_OTHER, // Address-producing instruction that is not a load or store (addi, jalr...)
+    ACCESS_LOAD,
+    ACCESS_STORE
+} AccessType;
+
+// AccessType in bits 0-1, log2 of the access size in bytes in bits 2-3
+#define TRACE_ACCESS(type, log2_size) ((unsigned char)((type) | ((log2_size) << 2)))
+#define ACCESS_TYPE(access) ((access) & 3)
+#define ACCESS_SIZE(access) (ACCESS_TYPE(access) == ACCESS_OTHER ? 0 : 1 << ((access) >> 2))
+
+// One decoded trace line. Registers are indices into init_registers()
+// order, -1 when the name is not a known register.
+typedef struct {
+    unsigned char opcode;
+    signed char dst;
+    signed char base;
+    unsigned char access; // TRACE_ACCESS() of the mnemonic
+    address_t literal;    // Offset, immediate or Info value
+} TraceOp;
+
+// One entry of the resolved trace
+typedef struct {
+    address_t address;
+    unsigned char type; // AccessType
+    unsigned char size; // Bytes, 0 for ACCESS_OTHER
+} TraceAccess;
+
+// Turns decoded lines into the resolved trace. The newest access is held
+// back one line, since an Info line that follows it may still replace it.
+typedef struct {
+    Register registers[NUM_REGISTERS];
+    TraceAccess pending;
+    int has_pending;
+} TraceResolver;
+
+void init_registers(Register registers[]);
+int register_index(const char *name, size_t length);
+void decode_command(const char *command, TraceOp *op);
+address_t resolve_trace_op(const TraceOp *op, Register registers[], int num_registers, int *replaces_previous);
+address_t process_command(char *command, Register registers[], int num_registers, int *replaces_previous);
+address_t process_command_sscanf(char *command, Register registers[], int num_registers, int *replaces_previous);
+void init_trace_resolver(TraceResolver *resolver);
+int resolve_trace_line(TraceResolver *resolver, const TraceOp *op, TraceAccess *out);
+int flush_trace_resolver(TraceResolver *resolver, TraceAccess *out);
+int benchmark_trace_parser(const char *filename);
+int extract_addresses_from_file(const char *filename, address_t **addresses, unsigned char **types);
 
 #endif // EXTRACT_ADDRESS_TRACE_H
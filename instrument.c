@@ -0,0 +1,253 @@
+#include "instrument.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef INSTRUMENT
+
+#define HOT_SPOT_INITIAL_CAPACITY 4096
+
+static void* allocate_array(size_t count, size_t size) {
+    void* array = calloc(count, size);
+    if (array == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return array;
+}
+
+static void init_hot_spots(HotSpotTable* table) {
+    table->capacity = HOT_SPOT_INITIAL_CAPACITY;
+    table->count = 0;
+    table->entries = (HotSpot*)allocate_array(table->capacity, sizeof(HotSpot));
+}
+
+static size_t hot_spot_slot(const HotSpotTable* table, address_t key) {
+    return (size_t)(((uint64_t)key * 0x9E3779B97F4A7C15ULL) >> 32) & (table->capacity - 1);
+}
+
+static void grow_hot_spots(HotSpotTable* table) {
+    HotSpot* old = table->entries;
+    size_t old_capacity = table->capacity;
+    table->capacity *= 2;
+    table->entries = (HotSpot*)allocate_array(table->capacity, sizeof(HotSpot));
+    size_t mask = table->capacity - 1;
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old[i].counts[0] != 0) {
+            size_t slot = hot_spot_slot(table, old[i].key);
+            while (table->entries[slot].counts[0] != 0) {
+                slot = (slot + 1) & mask;
+            }
+            table->entries[slot] = old[i];
+        }
+    }
+    free(old);
+}
+
+// Counts one access to key that missed in the first found levels.
+static void count_hot_spot(HotSpotTable* table, address_t key, int found) {
+    if ((table->count + 1) * 4 > table->capacity * 3) {
+        grow_hot_spots(table);
+    }
+    size_t mask = table->capacity - 1;
+    size_t slot = hot_spot_slot(table, key);
+    HotSpot* entry = &table->entries[slot];
+    while (entry->counts[0] != 0 && entry->key != key) {
+        slot = (slot + 1) & mask;
+        entry = &table->entries[slot];
+    }
+    if (entry->counts[0] == 0) {
+        entry->key = key;
+        table->count++;
+    }
+    for (int level = 0; level <= found && level < 4; level++) {
+        entry->counts[level]++;
+    }
+}
+
+Instrumentation* create_instrumentation(const int num_sets[3], int line_bits) {
+    Instrumentation* instrument = (Instrumentation*)allocate_array(1, sizeof(Instrumentation));
+    instrument->line_bits = line_bits;
+    for (int level = 0; level < 3; level++) {
+        instrument->num_sets[level] = num_sets[level];
+        instrument->set_accesses[level] = (unsigned long long*)allocate_array((size_t)num_sets[level], sizeof(unsigned long long));
+        instrument->set_misses[level] = (unsigned long long*)allocate_array((size_t)num_sets[level], sizeof(unsigned long long));
+        instrument->set_evictions[level] = (unsigned long long*)allocate_array((size_t)num_sets[level], sizeof(unsigned long long));
+    }
+    init_hot_spots(&instrument->regions);
+    init_hot_spots(&instrument->lines);
+    return instrument;
+}
+
+void destroy_instrumentation(Instrumentation* instrument) {
+    if (instrument == NULL) {
+        return;
+    }
+    for (int level = 0; level < 3; level++) {
+        free(instrument->set_accesses[level]);
+        free(instrument->set_misses[level]);
+        free(instrument->set_evictions[level]);
+    }
+    free(instrument->regions.entries);
+    free(instrument->lines.entries);
+    free(instrument);
+}
+
+// A demand access looked up level by level: sets holds its set at each
+// level and found is the level that held it (3 = DRAM).
+void record_instrumented_access(Instrumentation* instrument, address_t address, const unsigned int sets[3], int found) {
+    for (int level = 0; level <= found && level < 3; level++) {
+        instrument->set_accesses[level][sets[level]]++;
+        if (level < found) {
+            instrument->set_misses[level][sets[level]]++;
+        }
+    }
+    count_hot_spot(&instrument->regions, address >> INSTRUMENT_REGION_BITS, found);
+    count_hot_spot(&instrument->lines, address >> instrument->line_bits, found);
+}
+
+void record_instrumented_eviction(Instrumentation* instrument, int level, unsigned int set) {
+    instrument->set_evictions[level][set]++;
+}
+
+// Used entries of a table, sorted by compare
+static HotSpot* sorted_hot_spots(const HotSpotTable* table, int (*compare)(const void*, const void*)) {
+    HotSpot* sorted = (HotSpot*)allocate_array(table->count > 0 ? table->count : 1, sizeof(HotSpot));
+    size_t n = 0;
+    for (size_t i = 0; i < table->capacity; i++) {
+        if (table->entries[i].counts[0] != 0) {
+            sorted[n++] = table->entries[i];
+        }
+    }
+    qsort(sorted, n, sizeof(HotSpot), compare);
+    return sorted;
+}
+
+static int by_key(const void* a, const void* b) {
+    address_t x = ((const HotSpot*)a)->key, y = ((const HotSpot*)b)->key;
+    return x < y ? -1 : x > y;
+}
+
+// Most DRAM misses first, then most L1 misses
+static int by_misses(const void* a, const void* b) {
+    const HotSpot* x = (const HotSpot*)a;
+    const HotSpot* y = (const HotSpot*)b;
+    if (x->counts[3] != y->counts[3]) {
+        return x->counts[3] < y->counts[3] ? 1 : -1;
+    }
+    if (x->counts[1] != y->counts[1]) {
+        return x->counts[1] < y->counts[1] ? 1 : -1;
+    }
+    return by_key(a, b);
+}
+
+// One row per level the entry reached: accesses there and misses there
+static void write_hot_spot_csv(FILE* out, const char* section, const HotSpot* spot, int shift) {
+    address_t base = (address_t)((uint64_t)spot->key << shift);
+    for (int level = 1; level <= 3 && spot->counts[level - 1] > 0; level++) {
+        fprintf(out, "%s,%d," ADDRESS_FORMAT ",%llu,%llu,,,\n", section, level, base,
+                spot->counts[level - 1], spot->counts[level]);
+    }
+}
+
+static void write_hot_spot_json(FILE* out, const HotSpot* spot, int shift, int last) {
+    fprintf(out, "    {\"address\": \"" ADDRESS_FORMAT "\", \"accesses\": %llu, \"misses\": [%llu, %llu, %llu]}%s\n",
+            (address_t)((uint64_t)spot->key << shift), spot->counts[0],
+            spot->counts[1], spot->counts[2], spot->counts[3], last ? "" : ",");
+}
+
+static void write_csv(const Instrumentation* instrument, const DRAM* dram, FILE* out,
+                      const HotSpot* regions, const HotSpot* lines, size_t top) {
+    fprintf(out, "section,level,id,accesses,misses,evictions,row_hits,row_conflicts\n");
+    for (int level = 0; level < 3; level++) {
+        for (int set = 0; set < instrument->num_sets[level]; set++) {
+            if (instrument->set_accesses[level][set] > 0 || instrument->set_evictions[level][set] > 0) {
+                fprintf(out, "set,%d,%d,%llu,%llu,%llu,,\n", level + 1, set, instrument->set_accesses[level][set],
+                        instrument->set_misses[level][set], instrument->set_evictions[level][set]);
+            }
+        }
+    }
+    for (size_t i = 0; i < instrument->regions.count; i++) {
+        write_hot_spot_csv(out, "region", &regions[i], INSTRUMENT_REGION_BITS);
+    }
+    for (size_t i = 0; i < top; i++) {
+        write_hot_spot_csv(out, "line", &lines[i], instrument->line_bits);
+    }
+    for (int bank = 0; bank < dram->num_banks; bank++) {
+        const DRAMBank* b = &dram->banks[bank];
+        fprintf(out, "dram_bank,,%d,%llu,%llu,,%llu,%llu\n", bank, b->accesses,
+                b->accesses - b->row_hits - b->row_conflicts, b->row_hits, b->row_conflicts);
+    }
+}
+
+static void write_json(const Instrumentation* instrument, const DRAM* dram, FILE* out,
+                       const HotSpot* regions, const HotSpot* lines, size_t top) {
+    fprintf(out, "{\n  \"region_bytes\": %d,\n  \"line_bytes\": %d,\n  \"sets\": [\n",
+            1 << INSTRUMENT_REGION_BITS, 1 << instrument->line_bits);
+    for (int level = 0; level < 3; level++) {
+        fprintf(out, "    {\"level\": %d, \"accesses\": [", level + 1);
+        for (int set = 0; set < instrument->num_sets[level]; set++) {
+            fprintf(out, "%s%llu", set ? ", " : "", instrument->set_accesses[level][set]);
+        }
+        fprintf(out, "], \"misses\": [");
+        for (int set = 0; set < instrument->num_sets[level]; set++) {
+            fprintf(out, "%s%llu", set ? ", " : "", instrument->set_misses[level][set]);
+        }
+        fprintf(out, "], \"evictions\": [");
+        for (int set = 0; set < instrument->num_sets[level]; set++) {
+            fprintf(out, "%s%llu", set ? ", " : "", instrument->set_evictions[level][set]);
+        }
+        fprintf(out, "]}%s\n", level < 2 ? "," : "");
+    }
+    fprintf(out, "  ],\n  \"regions\": [\n");
+    for (size_t i = 0; i < instrument->regions.count; i++) {
+        write_hot_spot_json(out, &regions[i], INSTRUMENT_REGION_BITS, i + 1 == instrument->regions.count);
+    }
+    fprintf(out, "  ],\n  \"top_lines\": [\n");
+    for (size_t i = 0; i < top; i++) {
+        write_hot_spot_json(out, &lines[i], instrument->line_bits, i + 1 == top);
+    }
+    fprintf(out, "  ],\n  \"dram_banks\": [\n");
+    for (int bank = 0; bank < dram->num_banks; bank++) {
+        const DRAMBank* b = &dram->banks[bank];
+        fprintf(out, "    {\"bank\": %d, \"accesses\": %llu, \"row_hits\": %llu, \"row_conflicts\": %llu}%s\n",
+                bank, b->accesses, b->row_hits, b->row_conflicts, bank + 1 < dram->num_banks ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+// Writes JSON when the file name ends in .json, CSV otherwise ("-" is
+// stdout). Lines are limited to the top_lines with the most misses;
+// regions are listed in address order, for heatmaps. In CSV, set, region
+// and line rows give accesses reaching the level and misses there; DRAM
+// bank rows give row misses under misses.
+int write_instrumentation(const Instrumentation* instrument, const DRAM* dram, const char* filename, int top_lines) {
+    FILE* out = strcmp(filename, "-") == 0 ? stdout : fopen(filename, "w");
+    if (out == NULL) {
+        perror("Error opening output file");
+        return 0;
+    }
+    HotSpot* regions = sorted_hot_spots(&instrument->regions, by_key);
+    HotSpot* lines = sorted_hot_spots(&instrument->lines, by_misses);
+    size_t top = top_lines < 0 ? 0 : (size_t)top_lines;
+    if (top > instrument->lines.count) {
+        top = instrument->lines.count;
+    }
+    while (top > 0 && lines[top - 1].counts[1] == 0) {
+        top--; // Lines that never missed
+    }
+    size_t length = strlen(filename);
+    if (length >= 5 && strcmp(filename + length - 5, ".json") == 0) {
+        write_json(instrument, dram, out, regions, lines, top);
+    } else {
+        write_csv(instrument, dram, out, regions, lines, top);
+    }
+    free(regions);
+    free(lines);
+    if (out != stdout) {
+        fclose(out);
+    }
+    return 1;
+}
+
+#endif // INSTRUMENT
@@ -0,0 +1,46 @@
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <stddef.h>
+#include "address.h"
+#include "dram_simulation.h"
+
+// Hot-spot instrumentation: per-set accesses, misses and evictions of
+// each cache level, per-region and per-line miss counts and per-bank DRAM
+// row-buffer outcomes, exported as CSV or JSON. Only built with
+// -DINSTRUMENT; otherwise the hooks compile to nothing and the counters
+// do not exist.
+
+#define INSTRUMENT_REGION_BITS 12 // Miss heatmap granularity: 4KB pages
+#define INSTRUMENT_TOP_LINES 32   // Default lines listed by miss count
+
+// Per region or line: accesses, then misses at L1, L2 and L3
+typedef struct {
+    address_t key;
+    unsigned long long counts[4]; // counts[0] == 0 marks a free slot
+} HotSpot;
+
+// Open-addressed table keyed by region or line number
+typedef struct {
+    HotSpot* entries;
+    size_t capacity; // Power of two
+    size_t count;
+} HotSpotTable;
+
+typedef struct {
+    int line_bits;
+    int num_sets[3];
+    unsigned long long* set_accesses[3];
+    unsigned long long* set_misses[3];
+    unsigned long long* set_evictions[3]; // Fills that displaced a valid line
+    HotSpotTable regions;
+    HotSpotTable lines;
+} Instrumentation;
+
+Instrumentation* create_instrumentation(const int num_sets[3], int line_bits);
+void destroy_instrumentation(Instrumentation* instrument);
+void record_instrumented_access(Instrumentation* instrument, address_t address, const unsigned int sets[3], int found);
+void record_instrumented_eviction(Instrumentation* instrument, int level, unsigned int set);
+int write_instrumentation(const Instrumentation* instrument, const DRAM* dram, const char* filename, int top_lines);
+
+#endif // INSTRUMENT_H
@@ -0,0 +1,289 @@
+#include "interval_stats.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char* unit_names[] = { "accesses", "cycles" };
+
+const char* interval_unit_name(IntervalUnit unit) {
+    return unit_names[unit];
+}
+
+IntervalRecorder* create_interval_recorder(IntervalUnit unit, unsigned long long length, int line_size) {
+    IntervalRecorder* recorder = (IntervalRecorder*)calloc(1, sizeof(IntervalRecorder));
+    if (recorder == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    recorder->unit = unit;
+    recorder->length = length > 0 ? length : 1;
+    recorder->line_size = line_size;
+    return recorder;
+}
+
+void free_interval_recorder(IntervalRecorder* recorder) {
+    free(recorder->samples);
+    free(recorder);
+}
+
+static unsigned int signature_bucket(address_t address) {
+    address_t region = address >> PHASE_REGION_BITS;
+    return (unsigned int)(((uint64_t)region * 0x9E3779B97F4A7C15ULL) >> 59) % PHASE_SIGNATURE_SIZE;
+}
+
+// Closes the open interval with the hierarchy's counters as they are now
+static void close_interval(IntervalRecorder* recorder, const CacheHierarchy* hierarchy) {
+    const CacheStats* now = &hierarchy->stats;
+    const CacheStats* start = &recorder->start;
+    if (now->total_commands == start->total_commands) {
+        return;
+    }
+    if (recorder->count == recorder->capacity) {
+        recorder->capacity = recorder->capacity ? recorder->capacity * 2 : 256;
+        IntervalSample* samples = (IntervalSample*)realloc(recorder->samples, recorder->capacity * sizeof(IntervalSample));
+        if (samples == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        recorder->samples = samples;
+    }
+    IntervalSample* sample = &recorder->samples[recorder->count++];
+    const DramStats* dram = &hierarchy->dram.stats;
+    sample->first_access = start->total_commands;
+    sample->accesses = now->total_commands - start->total_commands;
+    sample->cycles = now->cycles - start->cycles;
+    sample->hit_L1 = now->hit_L1 - start->hit_L1;
+    sample->hit_L2 = now->hit_L2 - start->hit_L2;
+    sample->hit_L3 = now->hit_L3 - start->hit_L3;
+    sample->misses_L1 = now->misses_L1 - start->misses_L1;
+    sample->misses_L2 = now->misses_L2 - start->misses_L2;
+    sample->misses_L3 = now->misses_L3 - start->misses_L3;
+    sample->dram_accesses = dram->accesses - recorder->dram_start.accesses;
+    sample->dram_row_hits = dram->row_hits - recorder->dram_start.row_hits;
+    sample->dram_bytes = (now->dram_reads + now->dram_writes - start->dram_reads - start->dram_writes) *
+                         (unsigned long long)recorder->line_size;
+    sample->latency_cycles = now->timing.latency_cycles - start->timing.latency_cycles;
+    sample->phase = 0;
+
+    unsigned long long total = 0;
+    for (int i = 0; i < PHASE_SIGNATURE_SIZE; i++) {
+        total += recorder->signature[i];
+    }
+    for (int i = 0; i < PHASE_SIGNATURE_SIZE; i++) {
+        sample->signature[i] = total > 0 ? (float)recorder->signature[i] / (float)total : 0.0f;
+    }
+    memset(recorder->signature, 0, sizeof(recorder->signature));
+    recorder->start = *now;
+    recorder->dram_start = *dram;
+}
+
+// Call after each access has run through hierarchy.
+void record_interval_access(IntervalRecorder* recorder, const CacheHierarchy* hierarchy, address_t address) {
+    recorder->signature[signature_bucket(address)]++;
+    unsigned long long progress = recorder->unit == INTERVAL_ACCESSES
+        ? hierarchy->stats.total_commands - recorder->start.total_commands
+        : hierarchy->stats.cycles - recorder->start.cycles;
+    if (progress >= recorder->length) {
+        close_interval(recorder, hierarchy);
+    }
+}
+
+// Closes the last, possibly shorter, interval.
+void finish_intervals(IntervalRecorder* recorder, const CacheHierarchy* hierarchy) {
+    close_interval(recorder, hierarchy);
+}
+
+static double signature_distance(const float* a, const float* b) {
+    double distance = 0.0;
+    for (int i = 0; i < PHASE_SIGNATURE_SIZE; i++) {
+        double d = (double)a[i] - (double)b[i];
+        distance += d * d;
+    }
+    return distance;
+}
+
+static int nearest_centroid(const float* signature, float centroids[][PHASE_SIGNATURE_SIZE], int k, double* distance) {
+    int best = 0;
+    double best_distance = signature_distance(signature, centroids[0]);
+    for (int c = 1; c < k; c++) {
+        double d = signature_distance(signature, centroids[c]);
+        if (d < best_distance) {
+            best = c;
+            best_distance = d;
+        }
+    }
+    if (distance != NULL) {
+        *distance = best_distance;
+    }
+    return best;
+}
+
+// Groups the intervals into at most num_phases phases with k-means,
+// seeded with the first interval and then each interval farthest from
+// the seeds so far. Sets every sample's phase and each phase's
+// representative interval; returns the number of phases.
+int cluster_phases(IntervalRecorder* recorder, int num_phases) {
+    float centroids[MAX_PHASES][PHASE_SIGNATURE_SIZE];
+    IntervalSample* samples = recorder->samples;
+    size_t n = recorder->count;
+    int k = num_phases < 1 ? 1 : num_phases > MAX_PHASES ? MAX_PHASES : num_phases;
+    if ((size_t)k > n) {
+        k = (int)n;
+    }
+    recorder->num_phases = k;
+    if (k == 0) {
+        return 0;
+    }
+
+    memcpy(centroids[0], samples[0].signature, sizeof(centroids[0]));
+    for (int c = 1; c < k; c++) {
+        size_t farthest = 0;
+        double farthest_distance = -1.0;
+        for (size_t i = 0; i < n; i++) {
+            double d;
+            nearest_centroid(samples[i].signature, centroids, c, &d);
+            if (d > farthest_distance) {
+                farthest = i;
+                farthest_distance = d;
+            }
+        }
+        memcpy(centroids[c], samples[farthest].signature, sizeof(centroids[c]));
+    }
+
+    for (int iteration = 0; iteration < PHASE_MAX_ITERATIONS; iteration++) {
+        int changed = iteration == 0;
+        for (size_t i = 0; i < n; i++) {
+            int phase = nearest_centroid(samples[i].signature, centroids, k, NULL);
+            if (phase != samples[i].phase) {
+                samples[i].phase = phase;
+                changed = 1;
+            }
+        }
+        if (!changed) {
+            break;
+        }
+        for (int c = 0; c < k; c++) {
+            double sum[PHASE_SIGNATURE_SIZE] = { 0 };
+            size_t members = 0;
+            for (size_t i = 0; i < n; i++) {
+                if (samples[i].phase == c) {
+                    for (int j = 0; j < PHASE_SIGNATURE_SIZE; j++) {
+                        sum[j] += samples[i].signature[j];
+                    }
+                    members++;
+                }
+            }
+            if (members > 0) { // An emptied phase keeps its old centroid
+                for (int j = 0; j < PHASE_SIGNATURE_SIZE; j++) {
+                    centroids[c][j] = (float)(sum[j] / (double)members);
+                }
+            }
+        }
+    }
+
+    double best[MAX_PHASES];
+    for (int c = 0; c < k; c++) {
+        best[c] = -1.0;
+        recorder->representatives[c] = 0;
+    }
+    for (size_t i = 0; i < n; i++) {
+        int c = samples[i].phase;
+        double d = signature_distance(samples[i].signature, centroids[c]);
+        if (best[c] < 0.0 || d < best[c]) {
+            best[c] = d;
+            recorder->representatives[c] = i;
+        }
+    }
+    return k;
+}
+
+static double ratio(unsigned long long part, unsigned long long whole) {
+    return whole > 0 ? (double)part / (double)whole : 0.0;
+}
+
+// AMAT of an interval: out-of-order latency when it was timed that way,
+// otherwise cycles per access
+static double sample_amat(const IntervalSample* sample) {
+    return ratio(sample->latency_cycles > 0 ? sample->latency_cycles : sample->cycles, sample->accesses);
+}
+
+// Writes JSON when the file name ends in .json, CSV otherwise ("-" is stdout).
+int write_intervals(const IntervalRecorder* recorder, const char* filename) {
+    FILE* out = strcmp(filename, "-") == 0 ? stdout : fopen(filename, "w");
+    if (out == NULL) {
+        perror("Error opening output file");
+        return 0;
+    }
+    size_t length = strlen(filename);
+    int json = length >= 5 && strcmp(filename + length - 5, ".json") == 0;
+    if (json) {
+        fprintf(out, "[\n");
+    } else {
+        fprintf(out, "interval,first_access,accesses,cycles,l1_hit_rate,l2_hit_rate,l3_hit_rate,amat,"
+                     "dram_row_hit_rate,bytes_per_cycle,phase\n");
+    }
+    for (size_t i = 0; i < recorder->count; i++) {
+        const IntervalSample* s = &recorder->samples[i];
+        double l1 = ratio(s->hit_L1, s->accesses);
+        double l2 = ratio(s->hit_L2, s->misses_L1);
+        double l3 = ratio(s->hit_L3, s->misses_L2);
+        double row_hits = ratio(s->dram_row_hits, s->dram_accesses);
+        double bandwidth = ratio(s->dram_bytes, s->cycles);
+        if (json) {
+            fprintf(out, "  {\"interval\": %zu, \"first_access\": %llu, \"accesses\": %llu, \"cycles\": %llu, "
+                         "\"l1_hit_rate\": %.4f, \"l2_hit_rate\": %.4f, \"l3_hit_rate\": %.4f, \"amat\": %.2f, "
+                         "\"dram_row_hit_rate\": %.4f, \"bytes_per_cycle\": %.4f, \"phase\": %d}%s\n",
+                    i, s->first_access, s->accesses, s->cycles, l1, l2, l3, sample_amat(s), row_hits, bandwidth,
+                    s->phase, i + 1 < recorder->count ? "," : "");
+        } else {
+            fprintf(out, "%zu,%llu,%llu,%llu,%.4f,%.4f,%.4f,%.2f,%.4f,%.4f,%d\n",
+                    i, s->first_access, s->accesses, s->cycles, l1, l2, l3, sample_amat(s), row_hits, bandwidth,
+                    s->phase);
+        }
+    }
+    if (json) {
+        fprintf(out, "]\n");
+    }
+    if (out != stdout) {
+        fclose(out);
+    }
+    return 1;
+}
+
+// Lists each phase with its weight and representative interval, then
+// compares the whole run with the estimate from the representatives alone
+// (each weighted by its phase's share of the accesses).
+void print_phase_summary(const IntervalRecorder* recorder, const CacheHierarchy* hierarchy, FILE* out) {
+    size_t members[MAX_PHASES] = { 0 };
+    unsigned long long accesses[MAX_PHASES] = { 0 };
+    unsigned long long total = 0;
+    for (size_t i = 0; i < recorder->count; i++) {
+        members[recorder->samples[i].phase]++;
+        accesses[recorder->samples[i].phase] += recorder->samples[i].accesses;
+        total += recorder->samples[i].accesses;
+    }
+    fprintf(out, "%zu intervals of %llu %s, %d phases\n", recorder->count, recorder->length,
+            interval_unit_name(recorder->unit), recorder->num_phases);
+    double miss_estimate = 0.0, amat_estimate = 0.0;
+    unsigned long long simulated = 0;
+    for (int c = 0; c < recorder->num_phases; c++) {
+        const IntervalSample* s = &recorder->samples[recorder->representatives[c]];
+        double weight = ratio(accesses[c], total);
+        fprintf(out, "Phase %d: %zu intervals (%.1f%% of accesses), representative %zu (accesses %llu-%llu), "
+                     "L1 hit rate %.4f, DRAM misses/access %.4f, AMAT %.2f\n",
+                c, members[c], 100.0 * weight, recorder->representatives[c], s->first_access,
+                s->first_access + s->accesses - 1, ratio(s->hit_L1, s->accesses),
+                ratio(s->misses_L3, s->accesses), sample_amat(s));
+        miss_estimate += weight * ratio(s->misses_L3, s->accesses);
+        amat_estimate += weight * sample_amat(s);
+        simulated += s->accesses;
+    }
+    const CacheStats* stats = &hierarchy->stats;
+    double miss_actual = ratio(stats->misses_L3, stats->total_commands);
+    double amat_actual = ratio(stats->timing.latency_cycles > 0 ? stats->timing.latency_cycles : stats->cycles,
+                               stats->total_commands);
+    fprintf(out, "Representatives cover %.2f%% of accesses: DRAM misses/access %.4f (actual %.4f, %+.1f%%), "
+                 "AMAT %.2f (actual %.2f, %+.1f%%)\n",
+            100.0 * ratio(simulated, stats->total_commands), miss_estimate, miss_actual,
+            miss_actual > 0.0 ? 100.0 * (miss_estimate - miss_actual) / miss_actual : 0.0,
+            amat_estimate, amat_actual, amat_actual > 0.0 ? 100.0 * (amat_estimate - amat_actual) / amat_actual : 0.0);
+}
@@ -0,0 +1,67 @@
+#ifndef INTERVAL_STATS_H
+#define INTERVAL_STATS_H
+
+#include <stdio.h>
+#include "cache_simulation.h"
+
+#define DEFAULT_INTERVAL 10000   // Accesses (or cycles) per interval
+#define DEFAULT_PHASES 4
+#define MAX_PHASES 64
+#define PHASE_SIGNATURE_SIZE 32  // Buckets of the per-interval region histogram
+#define PHASE_REGION_BITS 12     // Accesses are binned by 4KB region
+#define PHASE_MAX_ITERATIONS 100
+
+typedef enum {
+    INTERVAL_ACCESSES,
+    INTERVAL_CYCLES
+} IntervalUnit;
+
+// One closed interval: counter deltas over it, and the signature used to
+// cluster it into a phase
+typedef struct {
+    unsigned long long first_access;
+    unsigned long long accesses;
+    unsigned long long cycles;
+    unsigned long long hit_L1;
+    unsigned long long hit_L2;
+    unsigned long long hit_L3;
+    unsigned long long misses_L1;
+    unsigned long long misses_L2;
+    unsigned long long misses_L3;
+    unsigned long long dram_accesses;
+    unsigned long long dram_row_hits;
+    unsigned long long dram_bytes;
+    unsigned long long latency_cycles; // Out-of-order AMAT numerator, 0 under serial timing
+    int phase;
+    float signature[PHASE_SIGNATURE_SIZE];
+} IntervalSample;
+
+// Cuts a run into intervals of length accesses or cycles. The traces
+// carry no program counter, so instead of a basic-block vector each
+// interval's signature is a normalised histogram of the 4KB regions it
+// touched, hashed into PHASE_SIGNATURE_SIZE buckets. Phases are k-means
+// clusters of the signatures, as in SimPoint.
+typedef struct {
+    IntervalUnit unit;
+    unsigned long long length;
+    int line_size;
+    CacheStats start;      // Counters when the open interval began
+    DramStats dram_start;
+    unsigned long long signature[PHASE_SIGNATURE_SIZE];
+    IntervalSample* samples;
+    size_t count;
+    size_t capacity;
+    int num_phases;
+    size_t representatives[MAX_PHASES]; // Per phase, the interval closest to its centroid
+} IntervalRecorder;
+
+const char* interval_unit_name(IntervalUnit unit);
+IntervalRecorder* create_interval_recorder(IntervalUnit unit, unsigned long long length, int line_size);
+void record_interval_access(IntervalRecorder* recorder, const CacheHierarchy* hierarchy, address_t address);
+void finish_intervals(IntervalRecorder* recorder, const CacheHierarchy* hierarchy);
+int cluster_phases(IntervalRecorder* recorder, int num_phases);
+int write_intervals(const IntervalRecorder* recorder, const char* filename);
+void print_phase_summary(const IntervalRecorder* recorder, const CacheHierarchy* hierarchy, FILE* out);
+void free_interval_recorder(IntervalRecorder* recorder);
+
+#endif // INTERVAL_STATS_H
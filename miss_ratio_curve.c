@@ -0,0 +1,256 @@
+#include "miss_ratio_curve.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_MAP_CAPACITY 4096
+#define INITIAL_FENWICK_SIZE 65536
+
+static void* allocate_zeroed(size_t count, size_t size) {
+    void* memory = calloc(count, size);
+    if (memory == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return memory;
+}
+
+static size_t hash_line(unsigned long long key, size_t capacity) {
+    key *= 0x9E3779B97F4A7C15ULL;
+    return (size_t)(key >> 32) & (capacity - 1);
+}
+
+// Returns the slot holding key, or the empty slot where it belongs.
+static size_t find_slot(const LineTimeMap* map, unsigned long long key) {
+    size_t slot = hash_line(key, map->capacity);
+    while (map->keys[slot] != 0 && map->keys[slot] != key) {
+        slot = (slot + 1) & (map->capacity - 1);
+    }
+    return slot;
+}
+
+static void grow_map(LineTimeMap* map) {
+    LineTimeMap old = *map;
+    map->capacity = old.capacity * 2;
+    map->keys = (unsigned long long*)allocate_zeroed(map->capacity, sizeof(unsigned long long));
+    map->times = (unsigned int*)allocate_zeroed(map->capacity, sizeof(unsigned int));
+    for (size_t i = 0; i < old.capacity; i++) {
+        if (old.keys[i] != 0) {
+            size_t slot = find_slot(map, old.keys[i]);
+            map->keys[slot] = old.keys[i];
+            map->times[slot] = old.times[i];
+        }
+    }
+    free(old.keys);
+    free(old.times);
+}
+
+static void fenwick_add(MissRatioCurve* mrc, size_t position, int delta) {
+    for (; position <= mrc->fenwick_size; position += position & (~position + 1)) {
+        mrc->fenwick[position] = (unsigned int)((int)mrc->fenwick[position] + delta);
+    }
+}
+
+static unsigned int fenwick_sum(const MissRatioCurve* mrc, size_t position) {
+    unsigned int sum = 0;
+    for (; position > 0; position -= position & (~position + 1)) {
+        sum += mrc->fenwick[position];
+    }
+    return sum;
+}
+
+
+typedef struct {
+    unsigned int time;
+    size_t slot;
+} TimedSlot;
+
+static int compare_timed_slots(const void* a, const void* b) {
+    unsigned int ta = ((const TimedSlot*)a)->time;
+    unsigned int tb = ((const TimedSlot*)b)->time;
+    return (ta > tb) - (ta < tb);
+}
+
+// Timestamps ran out: renumber the live lines 1..count in access order and
+// rebuild the tree, growing it so at least half of it is free again.
+static void compact_timestamps(MissRatioCurve* mrc) {
+    LineTimeMap* map = &mrc->last_access;
+    TimedSlot* slots = (TimedSlot*)allocate_zeroed(map->count > 0 ? map->count : 1, sizeof(TimedSlot));
+    size_t live = 0;
+    for (size_t i = 0; i < map->capacity; i++) {
+        if (map->keys[i] != 0) {
+            slots[live].time = map->times[i];
+            slots[live++].slot = i;
+        }
+    }
+    qsort(slots, live, sizeof(TimedSlot), compare_timed_slots);
+    for (size_t i = 0; i < live; i++) {
+        map->times[slots[i].slot] = (unsigned int)(i + 1);
+    }
+    free(slots);
+
+    if (live * 2 > mrc->fenwick_size) {
+        mrc->fenwick_size = live * 2;
+        free(mrc->fenwick);
+        mrc->fenwick = (unsigned int*)allocate_zeroed(mrc->fenwick_size + 1, sizeof(unsigned int));
+    }
+    // Every position 1..live holds one live line
+    for (size_t i = 1; i <= mrc->fenwick_size; i++) {
+        mrc->fenwick[i] = i <= live ? 1 : 0;
+    }
+    for (size_t i = 1; i <= mrc->fenwick_size; i++) {
+        size_t parent = i + (i & (~i + 1));
+        if (parent <= mrc->fenwick_size) {
+            mrc->fenwick[parent] += mrc->fenwick[i];
+        }
+    }
+    mrc->now = (unsigned int)live;
+}
+
+MissRatioCurve* create_miss_ratio_curve(int line_size, int max_set_bits) {
+    MissRatioCurve* mrc = (MissRatioCurve*)allocate_zeroed(1, sizeof(MissRatioCurve));
+    while ((1 << mrc->offset_bits) < line_size) {
+        mrc->offset_bits++;
+    }
+    mrc->last_access.capacity = INITIAL_MAP_CAPACITY;
+    mrc->last_access.keys = (unsigned long long*)allocate_zeroed(INITIAL_MAP_CAPACITY, sizeof(unsigned long long));
+    mrc->last_access.times = (unsigned int*)allocate_zeroed(INITIAL_MAP_CAPACITY, sizeof(unsigned int));
+    mrc->fenwick_size = INITIAL_FENWICK_SIZE;
+    mrc->fenwick = (unsigned int*)allocate_zeroed(mrc->fenwick_size + 1, sizeof(unsigned int));
+
+    mrc->num_levels = max_set_bits + 1;
+    mrc->levels = (SetStackLevel*)allocate_zeroed((size_t)mrc->num_levels, sizeof(SetStackLevel));
+    for (int i = 0; i < mrc->num_levels; i++) {
+        size_t num_sets = (size_t)1 << i;
+        mrc->levels[i].set_bits = i;
+        mrc->levels[i].lines = (address_t*)allocate_zeroed(num_sets * MRC_MAX_WAYS, sizeof(address_t));
+        mrc->levels[i].depth = (unsigned char*)allocate_zeroed(num_sets, sizeof(unsigned char));
+    }
+    return mrc;
+}
+
+static int distance_bucket(unsigned int distance) {
+    int bucket = 0;
+    while (distance > 0) {
+        distance >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+// Moves line to the front of its set's stack and records how deep it was.
+static void record_set_access(SetStackLevel* level, address_t line) {
+    size_t set = (size_t)((uint64_t)line & ((1ULL << level->set_bits) - 1));
+    address_t* stack = level->lines + set * MRC_MAX_WAYS;
+    int depth = level->depth[set];
+    int position = 0;
+    while (position < depth && stack[position] != line) {
+        position++;
+    }
+    level->histogram[position < depth ? position : MRC_MAX_WAYS]++;
+    if (position == depth) {
+        if (depth < MRC_MAX_WAYS) {
+            level->depth[set]++;
+        } else {
+            position = MRC_MAX_WAYS - 1; // Drop the least recently used line
+        }
+    }
+    memmove(stack + 1, stack, (size_t)position * sizeof(address_t));
+    stack[0] = line;
+}
+
+void record_mrc_access(MissRatioCurve* mrc, address_t address) {
+    address_t line = address >> mrc->offset_bits;
+    mrc->accesses++;
+
+    for (int i = 0; i < mrc->num_levels; i++) {
+        record_set_access(&mrc->levels[i], line);
+    }
+
+    if (mrc->now == mrc->fenwick_size) {
+        compact_timestamps(mrc);
+    }
+    unsigned int now = ++mrc->now;
+
+    LineTimeMap* map = &mrc->last_access;
+    unsigned long long key = (unsigned long long)line + 1;
+    size_t slot = find_slot(map, key);
+    if (map->keys[slot] == 0) {
+        mrc->cold_misses++;
+        map->keys[slot] = key;
+        map->count++;
+    } else {
+        unsigned int previous = map->times[slot];
+        // Distinct lines touched since the previous access to this one
+        unsigned int distance = fenwick_sum(mrc, now - 1) - fenwick_sum(mrc, previous);
+        mrc->histogram[distance_bucket(distance)]++;
+        fenwick_add(mrc, previous, -1);
+    }
+    map->times[slot] = now;
+    fenwick_add(mrc, now, 1);
+
+    if (map->count * 2 > map->capacity) {
+        grow_map(map);
+    }
+}
+
+// Miss ratio of a fully-associative LRU cache; cache_lines must be a power of two.
+double fully_associative_miss_ratio(const MissRatioCurve* mrc, unsigned long long cache_lines) {
+    if (mrc->accesses == 0) {
+        return 0.0;
+    }
+    int first_miss_bucket = distance_bucket((unsigned int)(cache_lines > 0xFFFFFFFFULL ? 0xFFFFFFFFULL : cache_lines));
+    unsigned long long misses = mrc->cold_misses;
+    for (int b = first_miss_bucket; b < MRC_DISTANCE_BUCKETS; b++) {
+        misses += mrc->histogram[b];
+    }
+    return (double)misses / (double)mrc->accesses;
+}
+
+// Miss ratio of an LRU cache with 2^set_bits sets of the given ways.
+double set_associative_miss_ratio(const MissRatioCurve* mrc, int set_bits, int ways) {
+    if (mrc->accesses == 0 || set_bits >= mrc->num_levels || ways > MRC_MAX_WAYS) {
+        return 0.0;
+    }
+    const SetStackLevel* level = &mrc->levels[set_bits];
+    unsigned long long misses = 0;
+    for (int d = ways; d <= MRC_MAX_WAYS; d++) {
+        misses += level->histogram[d];
+    }
+    return (double)misses / (double)mrc->accesses;
+}
+
+// Writes both curves as CSV.
+void print_miss_ratio_curve(const MissRatioCurve* mrc, FILE* out) {
+    unsigned long long line_size = 1ULL << mrc->offset_bits;
+    fprintf(out, "# %llu accesses, %llu distinct lines\n", mrc->accesses, mrc->cold_misses);
+    fprintf(out, "# Fully-associative LRU\n");
+    fprintf(out, "cache_lines,cache_bytes,miss_ratio\n");
+    for (int b = 0; b < MRC_DISTANCE_BUCKETS - 1; b++) {
+        unsigned long long lines = 1ULL << b;
+        fprintf(out, "%llu,%llu,%.6f\n", lines, lines * line_size, fully_associative_miss_ratio(mrc, lines));
+        if (lines >= mrc->cold_misses) {
+            break; // Larger caches only see cold misses
+        }
+    }
+    fprintf(out, "# Set-associative LRU\n");
+    fprintf(out, "sets,ways,cache_bytes,miss_ratio\n");
+    for (int s = 0; s < mrc->num_levels; s++) {
+        for (int ways = 1; ways <= MRC_MAX_WAYS; ways *= 2) {
+            unsigned long long sets = 1ULL << s;
+            fprintf(out, "%llu,%d,%llu,%.6f\n", sets, ways, sets * (unsigned long long)ways * line_size,
+                    set_associative_miss_ratio(mrc, s, ways));
+        }
+    }
+}
+
+void free_miss_ratio_curve(MissRatioCurve* mrc) {
+    for (int i = 0; i < mrc->num_levels; i++) {
+        free(mrc->levels[i].lines);
+        free(mrc->levels[i].depth);
+    }
+    free(mrc->levels);
+    free(mrc->last_access.keys);
+    free(mrc->last_access.times);
+    free(mrc->fenwick);
+    free(mrc);
+}
@@ -0,0 +1,54 @@
+#ifndef MISS_RATIO_CURVE_H
+#define MISS_RATIO_CURVE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "address.h"
+
+#define MRC_MAX_WAYS 32       // Set-associative curves cover 1..MRC_MAX_WAYS ways
+#define MRC_MAX_SET_BITS 24   // Up to 2^24 sets; each level keeps MRC_MAX_WAYS lines per set
+#define MRC_DISTANCE_BUCKETS 40 // log2 buckets of fully-associative stack distance
+
+// Line -> timestamp of its last access (open addressing, key 0 = empty)
+typedef struct {
+    unsigned long long* keys;
+    unsigned int* times;
+    size_t capacity;
+    size_t count;
+} LineTimeMap;
+
+// LRU stacks for one set count: each set keeps its MRC_MAX_WAYS most
+// recently used lines, most recent first.
+typedef struct {
+    int set_bits;
+    address_t* lines;              // num_sets * MRC_MAX_WAYS
+    unsigned char* depth;          // Lines currently in each set's stack
+    unsigned long long histogram[MRC_MAX_WAYS + 1]; // [MRC_MAX_WAYS] = deeper or cold
+} SetStackLevel;
+
+// Computes LRU stack distances for every access in one pass. A Fenwick
+// tree over access timestamps gives the fully-associative distance in
+// O(log n); per-set stacks give the distance within each set for every
+// power-of-two set count. Together they yield the miss ratio of every
+// cache size and associativity without re-running the trace.
+typedef struct {
+    int offset_bits;
+    unsigned long long accesses;
+    unsigned long long cold_misses;
+    unsigned long long histogram[MRC_DISTANCE_BUCKETS]; // Bucket b: distance in [2^(b-1), 2^b)
+    LineTimeMap last_access;
+    unsigned int* fenwick;
+    size_t fenwick_size;
+    unsigned int now;
+    int num_levels;
+    SetStackLevel* levels;
+} MissRatioCurve;
+
+MissRatioCurve* create_miss_ratio_curve(int line_size, int max_set_bits);
+void record_mrc_access(MissRatioCurve* mrc, address_t address);
+double fully_associative_miss_ratio(const MissRatioCurve* mrc, unsigned long long cache_lines);
+double set_associative_miss_ratio(const MissRatioCurve* mrc, int set_bits, int ways);
+void print_miss_ratio_curve(const MissRatioCurve* mrc, FILE* out);
+void free_miss_ratio_curve(MissRatioCurve* mrc);
+
+#endif // MISS_RATIO_CURVE_H
@@ -0,0 +1,361 @@
+#include "multicore.h"
+#include <stdlib.h>
+#include <string.h>
+
+int validate_multicore_config(const SimConfig* config, int num_cores) {
+    if (num_cores < 1 || num_cores > MAX_CORES) {
+        fprintf(stderr, "Between 1 and %d cores can be simulated\n", MAX_CORES);
+        return 0;
+    }
+    if (config->L1.line_size != config->L2.line_size || config->L2.line_size != config->L3.line_size) {
+        fprintf(stderr, "Multi-core runs need the same line size at every level\n");
+        return 0;
+    }
+    // The cores have their own timing and fill path, so these would not be simulated
+    if (config->core.model != CORE_SERIAL) {
+        fprintf(stderr, "Multi-core runs use serial timing; core.model=%s is not supported\n", core_model_name(config->core.model));
+        return 0;
+    }
+    if (config->tlb.enabled) {
+        fprintf(stderr, "Multi-core runs take trace addresses as physical; tlb.enabled is not supported\n");
+        return 0;
+    }
+    if (config->inclusion.policy != INCLUSION_EXCLUSIVE || config->inclusion.victim_entries > 0) {
+        fprintf(stderr, "Multi-core runs support neither inclusion.policy nor a victim cache\n");
+        return 0;
+    }
+    if (config->write.policy != WRITE_BACK || !config->write.allocate) {
+        fprintf(stderr, "Warning: multi-core runs are write-back and write-allocate; write.* is ignored\n");
+    }
+    if (config->L1.prefetch.type != PREFETCH_NONE || config->L2.prefetch.type != PREFETCH_NONE ||
+        config->L3.prefetch.type != PREFETCH_NONE) {
+        fprintf(stderr, "Warning: multi-core runs have no prefetchers; the prefetch settings are ignored\n");
+    }
+    return 1;
+}
+
+static void* allocate_array(size_t count, size_t size) {
+    void* array = calloc(count, size);
+    if (array == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return array;
+}
+
+// The config must already have passed validate_sim_config and
+// validate_multicore_config. Cores start without a trace.
+MulticoreSystem* create_multicore(const SimConfig* config, int num_cores) {
+    MulticoreSystem* system = (MulticoreSystem*)allocate_array(1, sizeof(MulticoreSystem));
+    system->config = *config;
+    system->num_cores = num_cores;
+    system->cores = (Core*)allocate_array((size_t)num_cores, sizeof(Core));
+    for (int c = 0; c < num_cores; c++) {
+        system->cores[c].L1 = initialize_cache(&config->L1);
+        system->cores[c].L2 = initialize_cache(&config->L2);
+    }
+    system->L3 = initialize_cache(&config->L3);
+    system->l3_filler = (unsigned char*)allocate_array((size_t)system->L3->num_lines, 1);
+    init_dram(&system->dram, &config->dram);
+    init_directory(&system->directory);
+    system->line_bits = system->L3->offset_bits;
+    return system;
+}
+
+// relocation is XORed into every address of the trace, so copies of one
+// trace can run as separate processes (0 shares the address space).
+void attach_core_trace(MulticoreSystem* system, int core, const address_t* addresses,
+                       const unsigned char* types, long long length, address_t relocation) {
+    Core* c = &system->cores[core];
+    c->addresses = addresses;
+    c->types = types;
+    c->length = length;
+    c->position = 0;
+    c->relocation = relocation;
+}
+
+// Charges one private miss or upgrade to the requesting core. A snoop is
+// broadcast to every other core; a directory request goes to the
+// directory, which forwards it to targets only.
+static void coherence_request(MulticoreSystem* system, Core* core, uint64_t targets) {
+    const CoherenceConfig* coherence = &system->config.coherence;
+    if (system->num_cores == 1) {
+        return;
+    }
+    unsigned long long cost;
+    if (coherence->mechanism == COHERENCE_SNOOP) {
+        core->stats.coherence_messages += (unsigned long long)(system->num_cores - 1);
+        cost = (unsigned long long)coherence->snoop_latency;
+    } else {
+        core->stats.coherence_messages += 1 + (unsigned long long)__builtin_popcountll(targets);
+        cost = (unsigned long long)coherence->directory_latency;
+    }
+    core->stats.coherence_cycles += cost;
+    core->stats.cycles += cost;
+}
+
+// Drops every copy but core's
+static void invalidate_others(MulticoreSystem* system, int core, DirectoryEntry* entry, address_t address) {
+    uint64_t others = entry->sharers & ~(1ULL << core);
+    while (others) {
+        int other = __builtin_ctzll(others);
+        others &= others - 1;
+        reset_cache(system->cores[other].L1, address);
+        reset_cache(system->cores[other].L2, address);
+        system->cores[other].stats.invalidations_received++;
+        system->cores[core].stats.invalidations_sent++;
+    }
+    entry->sharers &= 1ULL << core;
+}
+
+// Puts a line leaving core's private caches into the shared L3. Dirty L3
+// victims are written to DRAM without stalling anyone.
+static void l3_insert(MulticoreSystem* system, int core, address_t address, int dirty) {
+    Cache* L3 = system->L3;
+    address_t victim;
+    int evicted = update_cache(L3, address, &victim);
+    if (dirty) {
+        mark_dirty(L3, address);
+    }
+    unsigned int set = cache_index(L3, address);
+    size_t slot = (size_t)set * (size_t)L3->ways + (size_t)cache_find_way(L3, set, cache_tag(L3, address));
+    if (evicted) {
+        int filler = system->l3_filler[slot];
+        if (filler != core) {
+            system->stats.cross_core_evictions++;
+            system->cores[filler].stats.llc_displaced++;
+        }
+        if (evicted == CACHE_EVICTED_DIRTY) {
+            dram_access_at(&system->dram, victim, (long long)system->cores[core].stats.cycles);
+            system->stats.dram_writes++;
+        }
+    }
+    system->l3_filler[slot] = (unsigned char)core;
+}
+
+// A line falls out of core's L2: core stops holding it, and a Modified or
+// Owned copy is written back.
+static void evict_private(MulticoreSystem* system, int core, address_t address) {
+    DirectoryEntry* entry = directory_find(&system->directory, address >> system->line_bits);
+    LineState state = line_state(entry, core);
+    int dirty = state == LINE_MODIFIED || state == LINE_OWNED;
+    if (entry != NULL) {
+        entry->sharers &= ~(1ULL << core);
+        if (entry->owner == core) {
+            entry->owner = -1;
+            entry->owner_state = LINE_INVALID;
+        }
+        if (entry->sharers == 0) {
+            directory_remove(&system->directory, entry);
+        }
+    }
+    if (dirty) {
+        system->cores[core].stats.writebacks++;
+    }
+    l3_insert(system, core, address, dirty);
+}
+
+// Fills core's L1; its victim moves to L2 and L2's leaves the core.
+static void private_fill(MulticoreSystem* system, int core, address_t address) {
+    Core* c = &system->cores[core];
+    address_t l1_victim, l2_victim;
+    if (update_cache(c->L1, address, &l1_victim) && update_cache(c->L2, l1_victim, &l2_victim)) {
+        evict_private(system, core, l2_victim);
+    }
+}
+
+static void core_access(MulticoreSystem* system, int core, address_t address, int write) {
+    Core* c = &system->cores[core];
+    CoreStats* stats = &c->stats;
+    const SimConfig* config = &system->config;
+    uint64_t self = 1ULL << core;
+    address_t line = address >> system->line_bits;
+    DirectoryEntry* entry = directory_find(&system->directory, line);
+    LineState state = line_state(entry, core);
+
+    stats->accesses++;
+    if (write) {
+        stats->stores++;
+    }
+
+    if (state != LINE_INVALID) {
+        int in_L1 = is_in_cache(c->L1, address);
+        if (in_L1) {
+            stats->hit_L1++;
+            stats->cycles += (unsigned long long)config->L1.latency;
+            update_cache(c->L1, address, NULL);
+        } else {
+            stats->hit_L2++;
+            stats->cycles += (unsigned long long)(config->L1.latency + config->L2.latency);
+        }
+        if (write && state != LINE_MODIFIED) {
+            if (state != LINE_EXCLUSIVE) {
+                // Shared or Owned: every other copy has to go first
+                coherence_request(system, c, entry->sharers & ~self);
+                invalidate_others(system, core, entry, address);
+                stats->upgrades++;
+            }
+            entry->owner = (signed char)core;
+            entry->owner_state = LINE_MODIFIED;
+        }
+        if (!in_L1) {
+            reset_cache(c->L2, address);
+            private_fill(system, core, address);
+        }
+        return;
+    }
+
+    stats->cycles += (unsigned long long)(config->L1.latency + config->L2.latency);
+    uint64_t others = entry != NULL ? entry->sharers & ~self : 0;
+    if (others) {
+        // Another core's caches supply the line: the owner if there is
+        // one, otherwise any sharer
+        uint64_t targets = write ? others : entry->owner >= 0 ? 1ULL << entry->owner : others & (~others + 1);
+        coherence_request(system, c, targets);
+        stats->transfers++;
+        stats->cycles += (unsigned long long)config->coherence.transfer_latency;
+        if (write) {
+            invalidate_others(system, core, entry, address);
+            entry->sharers = self;
+            entry->owner = (signed char)core;
+            entry->owner_state = LINE_MODIFIED;
+        } else {
+            if (entry->owner >= 0 && entry->owner_state == LINE_MODIFIED) {
+                if (config->coherence.protocol == PROTOCOL_MOESI) {
+                    entry->owner_state = LINE_OWNED;
+                } else {
+                    // MESI cannot share a dirty line: the owner writes it back
+                    system->cores[entry->owner].stats.writebacks++;
+                    l3_insert(system, entry->owner, address, 1);
+                    entry->owner = -1;
+                }
+            } else if (entry->owner >= 0 && entry->owner_state == LINE_EXCLUSIVE) {
+                entry->owner = -1;
+            }
+            entry->sharers |= self;
+        }
+    } else {
+        coherence_request(system, c, 0);
+        stats->cycles += (unsigned long long)config->L3.latency;
+        int dirty = 0;
+        if (is_in_cache(system->L3, address)) {
+            stats->hit_L3++;
+            system->stats.l3_hits++;
+            dirty = is_dirty(system->L3, address);
+            reset_cache(system->L3, address);
+        } else {
+            long long issue = (long long)stats->cycles;
+            stats->dram_reads++;
+            system->stats.l3_misses++;
+            stats->cycles += (unsigned long long)(dram_access_at(&system->dram, address, issue) - issue);
+        }
+        entry = directory_insert(&system->directory, line);
+        entry->sharers = self;
+        entry->owner = (signed char)core;
+        entry->owner_state = write || dirty ? LINE_MODIFIED : LINE_EXCLUSIVE;
+    }
+    private_fill(system, core, address);
+}
+
+// Round-robin: each core runs until its clock passes the end of the
+// current quantum, then the next core takes its turn, so no core gets
+// more than a quantum ahead of the others in the shared L3 and DRAM.
+void run_multicore(MulticoreSystem* system, unsigned long long quantum) {
+    unsigned long long boundary = 0;
+    int running = 1;
+    if (quantum == 0) {
+        quantum = 1;
+    }
+    while (running) {
+        running = 0;
+        boundary += quantum;
+        for (int core = 0; core < system->num_cores; core++) {
+            Core* c = &system->cores[core];
+            while (c->position < c->length && c->stats.cycles < boundary) {
+                long long i = c->position++;
+                core_access(system, core, c->addresses[i] ^ c->relocation,
+                            c->types != NULL && c->types[i] == ACCESS_STORE);
+            }
+            if (c->position < c->length) {
+                running = 1;
+            }
+        }
+    }
+}
+
+static double per_thousand(unsigned long long count, unsigned long long accesses) {
+    return accesses > 0 ? 1000.0 * (double)count / (double)accesses : 0.0;
+}
+
+static void total_core_stats(const MulticoreSystem* system, CoreStats* total) {
+    memset(total, 0, sizeof(CoreStats));
+    for (int core = 0; core < system->num_cores; core++) {
+        const CoreStats* s = &system->cores[core].stats;
+        total->accesses += s->accesses;
+        total->transfers += s->transfers;
+        total->upgrades += s->upgrades;
+        total->invalidations_sent += s->invalidations_sent;
+        total->coherence_messages += s->coherence_messages;
+        total->coherence_cycles += s->coherence_cycles;
+        total->writebacks += s->writebacks;
+        if (s->cycles > total->cycles) {
+            total->cycles = s->cycles; // Makespan
+        }
+    }
+}
+
+void print_multicore_results(const MulticoreSystem* system, FILE* out) {
+    const CoherenceConfig* coherence = &system->config.coherence;
+    fprintf(out, "%d cores, %s over %s\n", system->num_cores,
+            coherence_protocol_name(coherence->protocol), coherence_mechanism_name(coherence->mechanism));
+    for (int core = 0; core < system->num_cores; core++) {
+        const CoreStats* s = &system->cores[core].stats;
+        fprintf(out, "Core %d: accesses %llu (stores %llu), L1 hits %llu, L2 hits %llu, L3 hits %llu, DRAM reads %llu, "
+                     "transfers %llu, upgrades %llu, invalidations sent %llu received %llu, "
+                     "coherence messages %llu (%llu cycles), writebacks %llu, L3 lines displaced %llu, cycles %llu\n",
+                core, s->accesses, s->stores, s->hit_L1, s->hit_L2, s->hit_L3, s->dram_reads,
+                s->transfers, s->upgrades, s->invalidations_sent, s->invalidations_received,
+                s->coherence_messages, s->coherence_cycles, s->writebacks, s->llc_displaced, s->cycles);
+    }
+    const SharedStats* shared = &system->stats;
+    const DramStats* dram = &system->dram.stats;
+    unsigned long long l3_accesses = shared->l3_hits + shared->l3_misses;
+    fprintf(out, "Shared L3: hits %llu, misses %llu (%.2f%% miss ratio), cross-core evictions %llu\n",
+            shared->l3_hits, shared->l3_misses,
+            l3_accesses > 0 ? 100.0 * (double)shared->l3_misses / (double)l3_accesses : 0.0,
+            shared->cross_core_evictions);
+    fprintf(out, "Shared DRAM: reads %llu, writes %llu, row hits %.2f%%\n", shared->l3_misses, shared->dram_writes,
+            dram->accesses > 0 ? 100.0 * (double)dram->row_hits / (double)dram->accesses : 0.0);
+}
+
+// One row of a core-count scaling table; rates are per 1000 accesses.
+void print_multicore_summary(const MulticoreSystem* system, FILE* out, int header) {
+    if (header) {
+        fprintf(out, "cores   accesses  l3_miss%%  cross_evict/1k  coh_msgs/1k  transfers/1k  invals/1k  makespan\n");
+    }
+    CoreStats total;
+    total_core_stats(system, &total);
+    const SharedStats* shared = &system->stats;
+    unsigned long long l3_accesses = shared->l3_hits + shared->l3_misses;
+    fprintf(out, "%5d %10llu %9.2f %15.2f %12.2f %13.2f %10.2f %9llu\n",
+            system->num_cores, total.accesses,
+            l3_accesses > 0 ? 100.0 * (double)shared->l3_misses / (double)l3_accesses : 0.0,
+            per_thousand(shared->cross_core_evictions, total.accesses),
+            per_thousand(total.coherence_messages, total.accesses),
+            per_thousand(total.transfers, total.accesses),
+            per_thousand(total.invalidations_sent, total.accesses),
+            total.cycles);
+}
+
+void destroy_multicore(MulticoreSystem* system) {
+    for (int core = 0; core < system->num_cores; core++) {
+        free_cache(system->cores[core].L1);
+        free_cache(system->cores[core].L2);
+    }
+    free_cache(system->L3);
+    free(system->l3_filler);
+    free_dram(&system->dram);
+    free_directory(&system->directory);
+    free(system->cores);
+    free(system);
+}
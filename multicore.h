@@ -0,0 +1,73 @@
+#ifndef MULTICORE_H
+#define MULTICORE_H
+
+#include <stdio.h>
+#include "sim_config.h"
+#include "coherence.h"
+#include "extract_address_trace.h"
+
+#define DEFAULT_QUANTUM 1000 // Cycles each core runs before the next one's turn
+
+typedef struct {
+    unsigned long long accesses;
+    unsigned long long stores;
+    unsigned long long hit_L1;
+    unsigned long long hit_L2;
+    unsigned long long hit_L3;
+    unsigned long long dram_reads;
+    unsigned long long transfers;      // Lines supplied by another core's caches
+    unsigned long long upgrades;       // Stores to a line held Shared or Owned
+    unsigned long long invalidations_sent;
+    unsigned long long invalidations_received;
+    unsigned long long coherence_messages;
+    unsigned long long coherence_cycles;
+    unsigned long long writebacks;     // Dirty lines leaving the private caches
+    unsigned long long llc_displaced;  // Its L3 lines evicted by other cores' fills
+    unsigned long long cycles;
+} CoreStats;
+
+// One core: private L1/L2, its trace and its clock
+typedef struct {
+    Cache* L1;
+    Cache* L2;
+    const address_t* addresses;
+    const unsigned char* types; // AccessType per address
+    long long length;
+    long long position;
+    address_t relocation; // XORed into every address, to run copies of a trace as separate processes
+    CoreStats stats;
+} Core;
+
+typedef struct {
+    unsigned long long l3_hits;
+    unsigned long long l3_misses;
+    unsigned long long cross_core_evictions; // L3 fills that evicted another core's line
+    unsigned long long dram_writes;
+} SharedStats;
+
+// Cores with private L1/L2 in front of a shared L3 and DRAM, kept
+// coherent by MESI or MOESI over a snoop bus or a directory. The directory
+// table is the simulator's record of which cores hold each line in both
+// cases; the mechanism only decides what each request costs.
+typedef struct {
+    SimConfig config;
+    int num_cores;
+    Core* cores;
+    Cache* L3;
+    unsigned char* l3_filler; // Per L3 line, the core whose fill put it there
+    DRAM dram;
+    Directory directory;
+    int line_bits;
+    SharedStats stats;
+} MulticoreSystem;
+
+int validate_multicore_config(const SimConfig* config, int num_cores);
+MulticoreSystem* create_multicore(const SimConfig* config, int num_cores);
+void attach_core_trace(MulticoreSystem* system, int core, const address_t* addresses,
+                       const unsigned char* types, long long length, address_t relocation);
+void run_multicore(MulticoreSystem* system, unsigned long long quantum);
+void print_multicore_results(const MulticoreSystem* system, FILE* out);
+void print_multicore_summary(const MulticoreSystem* system, FILE* out, int header);
+void destroy_multicore(MulticoreSystem* system);
+
+#endif // MULTICORE_H
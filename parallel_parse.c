@@ -0,0 +1,119 @@
+#include "parallel_parse.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+int default_parse_threads(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int)cores : 1;
+#endif
+}
+
+ParallelParser* create_parallel_parser(int num_threads) {
+    ParallelParser *parser = (ParallelParser *)malloc(sizeof(ParallelParser));
+    ParseWorker *workers = (ParseWorker *)calloc((size_t)num_threads, sizeof(ParseWorker));
+    if (parser == NULL || workers == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    parser->num_threads = num_threads;
+    parser->workers = workers;
+    return parser;
+}
+
+static void append_op(ParseWorker *worker, const TraceOp *op) {
+    if (worker->count == worker->capacity) {
+        worker->capacity = worker->capacity ? worker->capacity * 2 : 4096;
+        worker->ops = (TraceOp *)realloc(worker->ops, worker->capacity * sizeof(TraceOp));
+        if (worker->ops == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    worker->ops[worker->count++] = *op;
+}
+
+// Splits the slice into the same pieces fgets() with a MAX_LINE_LENGTH
+// buffer would return, so the result matches the sequential parser.
+static void* decode_worker(void *arg) {
+    ParseWorker *worker = (ParseWorker *)arg;
+    const char *p = worker->text;
+    const char *end = worker->text + worker->length;
+    char line[MAX_LINE_LENGTH];
+    TraceOp op;
+
+    worker->count = 0;
+    while (p < end) {
+        const char *newline = (const char *)memchr(p, '\n', (size_t)(end - p));
+        size_t remaining = newline ? (size_t)(newline - p) + 1 : (size_t)(end - p);
+        size_t piece = remaining < MAX_LINE_LENGTH - 1 ? remaining : MAX_LINE_LENGTH - 1;
+        memcpy(line, p, piece);
+        line[piece] = '\0';
+        if (piece > 0 && line[piece - 1] == '\n') {
+            line[piece - 1] = '\0';  // Remove newline character
+        }
+        decode_command(line, &op);
+        if (op.opcode != TRACE_OP_NONE) {
+            append_op(worker, &op);
+        }
+        p += piece;
+    }
+    return NULL;
+}
+
+// Decodes a block that ends on a line boundary. Worker i's ops follow
+// worker i-1's in trace order.
+void decode_block(ParallelParser *parser, const char *text, size_t length) {
+    const char *start = text;
+    const char *end = text + length;
+    for (int i = 0; i < parser->num_threads; i++) {
+        const char *split = text + length * (size_t)(i + 1) / (size_t)parser->num_threads;
+        if (split < start) {
+            split = start;
+        }
+        // Move the split just past the next newline
+        if (i < parser->num_threads - 1 && split < end) {
+            const char *newline = (const char *)memchr(split, '\n', (size_t)(end - split));
+            split = newline ? newline + 1 : end;
+        } else {
+            split = end;
+        }
+        parser->workers[i].text = start;
+        parser->workers[i].length = (size_t)(split - start);
+        start = split;
+    }
+
+    int started = 0;
+    for (int i = 1; i < parser->num_threads; i++) {
+        if (pthread_create(&parser->workers[i].thread, NULL, decode_worker, &parser->workers[i]) != 0) {
+            break;
+        }
+        started = i;
+    }
+    decode_worker(&parser->workers[0]);
+    for (int i = 1; i <= started; i++) {
+        pthread_join(parser->workers[i].thread, NULL);
+    }
+    // Slices whose thread could not be started are decoded here
+    for (int i = started + 1; i < parser->num_threads; i++) {
+        decode_worker(&parser->workers[i]);
+    }
+}
+
+void destroy_parallel_parser(ParallelParser *parser) {
+    for (int i = 0; i < parser->num_threads; i++) {
+        free(parser->workers[i].ops);
+    }
+    free(parser->workers);
+    free(parser);
+}
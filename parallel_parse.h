@@ -0,0 +1,33 @@
+#ifndef PARALLEL_PARSE_H
+#define PARALLEL_PARSE_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include "extract_address_trace.h"
+
+#define PARSE_BLOCK_SIZE (8 * 1024 * 1024) // Bytes of text decoded per parallel step
+
+// Phase one of the parallel parser: each worker decodes its share of a
+// block of text into TraceOps. Decoding needs no register state, so the
+// workers are independent; phase two runs the ops through a
+// TraceResolver in order.
+typedef struct {
+    const char *text;
+    size_t length;
+    TraceOp *ops;
+    size_t count;
+    size_t capacity;
+    pthread_t thread;
+} ParseWorker;
+
+typedef struct {
+    int num_threads;
+    ParseWorker *workers;
+} ParallelParser;
+
+int default_parse_threads(void);
+ParallelParser* create_parallel_parser(int num_threads);
+void decode_block(ParallelParser *parser, const char *text, size_t length);
+void destroy_parallel_parser(ParallelParser *parser);
+
+#endif // PARALLEL_PARSE_H
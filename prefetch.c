@@ -0,0 +1,357 @@
+#include "prefetch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STRIDE_TABLE_BITS 8
+#define STRIDE_TABLE_SIZE (1 << STRIDE_TABLE_BITS)
+#define STRIDE_REGION_BITS 12  // Strides are tracked per 4KB region
+#define STREAM_BUFFERS 8
+#define STREAM_WINDOW 16       // Lines a miss may be from a stream and still follow it
+#define BEST_OFFSET_RR_BITS 8 // Recent-requests table of 256 lines
+#define BEST_OFFSET_RR_SIZE (1 << BEST_OFFSET_RR_BITS)
+#define BEST_OFFSET_SCORE_MAX 31
+#define BEST_OFFSET_ROUND_MAX 100
+#define BEST_OFFSET_BAD_SCORE 1 // At or below this the best offset prefetches nothing
+
+static void* allocate_state(size_t size) {
+    void* state = calloc(1, size);
+    if (state == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return state;
+}
+
+static void free_state(void* state) {
+    free(state);
+}
+
+// Fibonacci hash of a line or region number onto a table of 1 << bits entries
+static unsigned int hash_line(address_t line, int bits) {
+    return (unsigned int)(((uint64_t)line * 0x9E3779B97F4A7C15ULL) >> (64 - bits));
+}
+
+// Next-line: each miss, or hit on a prefetched line, fetches the lines after it
+
+typedef struct {
+    int degree;
+} NextLineState;
+
+static void* next_line_create(const PrefetchConfig* config, int line_bits) {
+    (void)line_bits;
+    NextLineState* state = (NextLineState*)allocate_state(sizeof(NextLineState));
+    state->degree = config->degree;
+    return state;
+}
+
+static int next_line_train(void* context, const PrefetchTrigger* trigger, address_t* candidates) {
+    NextLineState* state = (NextLineState*)context;
+    if (!trigger->miss && !trigger->prefetch_hit) {
+        return 0;
+    }
+    for (int i = 0; i < state->degree; i++) {
+        candidates[i] = trigger->line + (address_t)(i + 1);
+    }
+    return state->degree;
+}
+
+// Stride: a reference prediction table. The traces carry no program
+// counter, so entries are keyed by the 4KB region instead of the PC; a
+// stride seen twice in a row in a region is prefetched along.
+
+typedef struct {
+    address_t region;
+    long long last_line;
+    long long stride;
+    int confidence; // 0-3, prefetches from 2
+    int valid;
+} StrideEntry;
+
+typedef struct {
+    int degree;
+    int region_shift; // Line number to region
+    StrideEntry table[STRIDE_TABLE_SIZE];
+} StrideState;
+
+static void* stride_create(const PrefetchConfig* config, int line_bits) {
+    StrideState* state = (StrideState*)allocate_state(sizeof(StrideState));
+    state->degree = config->degree;
+    state->region_shift = line_bits < STRIDE_REGION_BITS ? STRIDE_REGION_BITS - line_bits : 0;
+    return state;
+}
+
+static int stride_train(void* context, const PrefetchTrigger* trigger, address_t* candidates) {
+    StrideState* state = (StrideState*)context;
+    long long line = (long long)trigger->line;
+    address_t region = trigger->line >> state->region_shift;
+    StrideEntry* entry = &state->table[hash_line(region, STRIDE_TABLE_BITS)];
+    if (!entry->valid || entry->region != region) {
+        *entry = (StrideEntry){ region, line, 0, 0, 1 };
+        return 0;
+    }
+    long long delta = line - entry->last_line;
+    if (delta == 0) {
+        return 0;
+    }
+    if (delta == entry->stride) {
+        if (entry->confidence < 3) {
+            entry->confidence++;
+        }
+    } else if (entry->confidence > 0) {
+        entry->confidence--;
+    } else {
+        entry->stride = delta;
+    }
+    entry->last_line = line;
+    if (entry->confidence < 2) {
+        return 0;
+    }
+    for (int i = 0; i < state->degree; i++) {
+        candidates[i] = (address_t)(line + entry->stride * (i + 1));
+    }
+    return state->degree;
+}
+
+// Stream buffers: misses close to a tracked stream advance it, and the
+// stream is kept degree lines ahead of the latest one. A miss near no
+// stream replaces the least recently used.
+
+typedef struct {
+    long long last_line;
+    long long head;   // Furthest line already requested
+    int direction;    // +1 or -1, 0 until a second miss sets it
+    unsigned long long used;
+    int valid;
+} Stream;
+
+typedef struct {
+    int degree;
+    unsigned long long clock;
+    Stream streams[STREAM_BUFFERS];
+} StreamState;
+
+static void* stream_create(const PrefetchConfig* config, int line_bits) {
+    (void)line_bits;
+    StreamState* state = (StreamState*)allocate_state(sizeof(StreamState));
+    state->degree = config->degree;
+    return state;
+}
+
+static int stream_train(void* context, const PrefetchTrigger* trigger, address_t* candidates) {
+    StreamState* state = (StreamState*)context;
+    if (!trigger->miss && !trigger->prefetch_hit) {
+        return 0;
+    }
+    long long line = (long long)trigger->line;
+    Stream* stream = NULL;
+    Stream* oldest = &state->streams[0];
+    for (int i = 0; i < STREAM_BUFFERS; i++) {
+        Stream* s = &state->streams[i];
+        if (s->valid && llabs(line - s->last_line) <= STREAM_WINDOW) {
+            stream = s;
+            break;
+        }
+        if (!s->valid || (oldest->valid && s->used < oldest->used)) {
+            oldest = s;
+        }
+    }
+    state->clock++;
+    if (stream == NULL) {
+        *oldest = (Stream){ line, line, 0, state->clock, 1 };
+        return 0;
+    }
+    if (line == stream->last_line) {
+        return 0;
+    }
+    int direction = line > stream->last_line ? 1 : -1;
+    if (direction != stream->direction) {
+        stream->direction = direction;
+        stream->head = line;
+    }
+    stream->last_line = line;
+    stream->used = state->clock;
+    if ((stream->head - line) * direction < 0) {
+        stream->head = line;
+    }
+    int count = 0;
+    long long target = line + (long long)direction * state->degree;
+    while ((target - stream->head) * direction > 0) {
+        stream->head += direction;
+        candidates[count++] = (address_t)stream->head;
+    }
+    return count;
+}
+
+// Best-offset: each miss tests one offset d from the list, scoring it when
+// line - d was requested recently (so d would have prefetched this line).
+// After a round the best scoring offset becomes the prefetch offset.
+
+static const int best_offsets[] = {
+    1, 2, 3, 4, 5, 6, 8, 9, 10, 12, 15, 16, 18, 20, 24, 25, 27, 30, 32,
+    -1, -2, -3, -4, -6, -8, -16
+};
+#define NUM_BEST_OFFSETS ((int)(sizeof(best_offsets) / sizeof(best_offsets[0])))
+
+typedef struct {
+    int degree;
+    address_t recent[BEST_OFFSET_RR_SIZE]; // line + 1, 0 = empty
+    int scores[NUM_BEST_OFFSETS];
+    int test_index;
+    int round;
+    int offset; // 0 = prefetching off
+} BestOffsetState;
+
+static void* best_offset_create(const PrefetchConfig* config, int line_bits) {
+    (void)line_bits;
+    BestOffsetState* state = (BestOffsetState*)allocate_state(sizeof(BestOffsetState));
+    state->degree = config->degree;
+    state->offset = 1;
+    return state;
+}
+
+static int best_offset_train(void* context, const PrefetchTrigger* trigger, address_t* candidates) {
+    BestOffsetState* state = (BestOffsetState*)context;
+    if (!trigger->miss && !trigger->prefetch_hit) {
+        return 0;
+    }
+    address_t line = trigger->line;
+    address_t base = line - (address_t)best_offsets[state->test_index];
+    int finished = 0;
+    if (state->recent[hash_line(base, BEST_OFFSET_RR_BITS)] == base + 1 &&
+        ++state->scores[state->test_index] >= BEST_OFFSET_SCORE_MAX) {
+        finished = 1;
+    }
+    if (++state->test_index == NUM_BEST_OFFSETS) {
+        state->test_index = 0;
+        finished |= ++state->round == BEST_OFFSET_ROUND_MAX;
+    }
+    if (finished) {
+        int best = 0;
+        for (int i = 1; i < NUM_BEST_OFFSETS; i++) {
+            if (state->scores[i] > state->scores[best]) {
+                best = i;
+            }
+        }
+        state->offset = state->scores[best] > BEST_OFFSET_BAD_SCORE ? best_offsets[best] : 0;
+        memset(state->scores, 0, sizeof(state->scores));
+        state->test_index = 0;
+        state->round = 0;
+    }
+    state->recent[hash_line(line, BEST_OFFSET_RR_BITS)] = line + 1;
+
+    if (state->offset == 0) {
+        return 0;
+    }
+    for (int i = 0; i < state->degree; i++) {
+        candidates[i] = line + (address_t)((long long)state->offset * (i + 1));
+    }
+    return state->degree;
+}
+
+// Indexed by PrefetcherType
+static const PrefetcherOps prefetchers[] = {
+    { "none", NULL, NULL, NULL, 0 },
+    { "nextline", next_line_create, next_line_train, free_state, sizeof(NextLineState) },
+    { "stride", stride_create, stride_train, free_state, sizeof(StrideState) },
+    { "stream", stream_create, stream_train, free_state, sizeof(StreamState) },
+    { "bestoffset", best_offset_create, best_offset_train, free_state, sizeof(BestOffsetState) }
+};
+
+const char* prefetcher_name(PrefetcherType type) {
+    return prefetchers[type].name;
+}
+
+int parse_prefetcher(const char* name, PrefetcherType* type) {
+    for (int i = 0; i < (int)(sizeof(prefetchers) / sizeof(prefetchers[0])); i++) {
+        if (strcmp(name, prefetchers[i].name) == 0) {
+            *type = (PrefetcherType)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Returns NULL for PREFETCH_NONE. line_size must be a power of two.
+Prefetcher* create_prefetcher(const PrefetchConfig* config, int line_size) {
+    if (config->type == PREFETCH_NONE) {
+        return NULL;
+    }
+    Prefetcher* prefetcher = (Prefetcher*)allocate_state(sizeof(Prefetcher));
+    prefetcher->ops = &prefetchers[config->type];
+    while ((1 << prefetcher->line_bits) < line_size) {
+        prefetcher->line_bits++;
+    }
+    prefetcher->state = prefetcher->ops->create(config, prefetcher->line_bits);
+    prefetcher->evicted = (address_t*)allocate_state(sizeof(address_t) * PREFETCH_FILTER_SIZE);
+    return prefetcher;
+}
+
+void destroy_prefetcher(Prefetcher* prefetcher) {
+    if (prefetcher == NULL) {
+        return;
+    }
+    prefetcher->ops->destroy(prefetcher->state);
+    free(prefetcher->evicted);
+    free(prefetcher);
+}
+
+// Runs the algorithm on the pending trigger and clears it.
+int prefetch_candidates(Prefetcher* prefetcher, address_t* lines) {
+    prefetcher->triggered = 0;
+    return prefetcher->ops->train(prefetcher->state, &prefetcher->trigger, lines);
+}
+
+// Retires completed fills; 1 when none of the queue is free.
+int prefetch_queue_full(Prefetcher* prefetcher, long long now) {
+    int kept = 0;
+    for (int i = 0; i < prefetcher->queued; i++) {
+        if (prefetcher->queue[i].ready > now) {
+            prefetcher->queue[kept++] = prefetcher->queue[i];
+        }
+    }
+    prefetcher->queued = kept;
+    return kept == PREFETCH_QUEUE_SIZE;
+}
+
+void prefetch_enqueue(Prefetcher* prefetcher, address_t line, long long ready) {
+    if (prefetcher->queued < PREFETCH_QUEUE_SIZE) {
+        prefetcher->queue[prefetcher->queued++] = (InflightPrefetch){ line, ready };
+    }
+}
+
+// Cycle the fill of line completes if it is still in flight at now, else -1.
+long long prefetch_in_flight(const Prefetcher* prefetcher, address_t line, long long now) {
+    for (int i = 0; i < prefetcher->queued; i++) {
+        if (prefetcher->queue[i].line == line && prefetcher->queue[i].ready > now) {
+            return prefetcher->queue[i].ready;
+        }
+    }
+    return -1;
+}
+
+void remember_prefetch_victim(Prefetcher* prefetcher, address_t line) {
+    prefetcher->evicted[hash_line(line, PREFETCH_FILTER_BITS)] = line + 1;
+}
+
+// 1 (once) when line was last displaced by one of this prefetcher's fills.
+int prefetch_evicted(Prefetcher* prefetcher, address_t line) {
+    address_t* slot = &prefetcher->evicted[hash_line(line, PREFETCH_FILTER_BITS)];
+    if (*slot != line + 1) {
+        return 0;
+    }
+    *slot = 0;
+    return 1;
+}
+
+static double percent(unsigned long long part, unsigned long long whole) {
+    return whole > 0 ? 100.0 * (double)part / (double)whole : 0.0;
+}
+
+// One line of results for the prefetcher of cache level 1-3
+void print_prefetch_stats(const PrefetchStats* stats, PrefetcherType type, int level, FILE* out) {
+    fprintf(out, "  L%d %s prefetch: issued %llu, useful %llu, accuracy %.1f%%, coverage %.1f%%, timely %.1f%%, pollution %llu, dropped %llu\n",
+            level, prefetcher_name(type), stats->issued, stats->useful,
+            percent(stats->useful, stats->issued), percent(stats->useful, stats->useful + stats->demand_misses),
+            percent(stats->useful - stats->late, stats->useful), stats->pollution, stats->dropped);
+}
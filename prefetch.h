@@ -0,0 +1,89 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <stdio.h>
+#include "address.h"
+
+#define PREFETCH_DEGREE 2         // Default lines requested per trigger
+#define MAX_PREFETCH_DEGREE 8
+#define PREFETCH_QUEUE_SIZE 32    // Prefetches in flight per level
+#define PREFETCH_FILTER_BITS 12   // 4096 lines remembered as evicted by prefetch fills
+#define PREFETCH_FILTER_SIZE (1 << PREFETCH_FILTER_BITS)
+
+typedef enum {
+    PREFETCH_NONE,
+    PREFETCH_NEXT_LINE,  // The lines after each miss
+    PREFETCH_STRIDE,     // Per-region stride detection (traces carry no PC)
+    PREFETCH_STREAM,     // Stream buffers following ascending/descending miss runs
+    PREFETCH_BEST_OFFSET // Michaud's best-offset: learns the offset that would have hit most
+} PrefetcherType;
+
+// Prefetcher attached to one cache level
+typedef struct {
+    PrefetcherType type;
+    int degree; // Lines requested per trigger
+} PrefetchConfig;
+
+// Per-level prefetch counters. Accuracy is useful / issued, coverage
+// useful / (useful + demand_misses) and timeliness (useful - late) / useful.
+typedef struct {
+    unsigned long long issued;        // Fills started
+    unsigned long long useful;        // Prefetched lines later hit by a demand access
+    unsigned long long late;          // Useful, but the fill was still in flight
+    unsigned long long dropped;       // Candidates already cached, or the queue was full
+    unsigned long long demand_misses; // Demand misses left at this level
+    unsigned long long pollution;     // Demand misses on lines a prefetch fill evicted
+} PrefetchStats;
+
+// A demand access as the level's prefetcher sees it; line is the address
+// divided by the level's line size
+typedef struct {
+    address_t line;
+    int miss;
+    int prefetch_hit; // Hit a line a prefetch brought in
+} PrefetchTrigger;
+
+// One prefetch algorithm. train sees every demand access of its level and
+// writes up to the configured degree of line numbers to fetch into
+// candidates, returning how many. Adding a prefetcher means writing these
+// three functions and listing them in prefetch.c. State must be one flat
+// block of state_size bytes, so checkpoints can copy it.
+typedef struct {
+    const char* name;
+    void* (*create)(const PrefetchConfig* config, int line_bits);
+    int (*train)(void* state, const PrefetchTrigger* trigger, address_t* candidates);
+    void (*destroy)(void* state);
+    size_t state_size;
+} PrefetcherOps;
+
+typedef struct {
+    address_t line;
+    long long ready; // Cycle the fill completes
+} InflightPrefetch;
+
+// An algorithm attached to a cache level, with the fills it has in flight
+// and the lines its fills displaced
+typedef struct {
+    const PrefetcherOps* ops;
+    void* state;
+    int line_bits;
+    InflightPrefetch queue[PREFETCH_QUEUE_SIZE];
+    int queued;
+    address_t* evicted; // Direct-mapped, line + 1 (0 = empty)
+    PrefetchTrigger trigger; // Last demand access, until run_prefetchers acts on it
+    int triggered;
+} Prefetcher;
+
+const char* prefetcher_name(PrefetcherType type);
+int parse_prefetcher(const char* name, PrefetcherType* type);
+Prefetcher* create_prefetcher(const PrefetchConfig* config, int line_size);
+void destroy_prefetcher(Prefetcher* prefetcher);
+int prefetch_candidates(Prefetcher* prefetcher, address_t* lines);
+int prefetch_queue_full(Prefetcher* prefetcher, long long now);
+void prefetch_enqueue(Prefetcher* prefetcher, address_t line, long long ready);
+long long prefetch_in_flight(const Prefetcher* prefetcher, address_t line, long long now);
+void remember_prefetch_victim(Prefetcher* prefetcher, address_t line);
+int prefetch_evicted(Prefetcher* prefetcher, address_t line);
+void print_prefetch_stats(const PrefetchStats* stats, PrefetcherType type, int level, FILE* out);
+
+#endif // PREFETCH_H
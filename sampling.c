@@ -0,0 +1,287 @@
+#include "sampling.h"
+#include "sim_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static const int confidence_levels[] = { 80, 90, 95, 99 };
+static const double confidence_z[] = { 1.2816, 1.6449, 1.9600, 2.5758 };
+
+static double confidence_to_z(int confidence) {
+    for (int i = 0; i < (int)(sizeof(confidence_levels) / sizeof(confidence_levels[0])); i++) {
+        if (confidence_levels[i] == confidence) {
+            return confidence_z[i];
+        }
+    }
+    return 0.0;
+}
+
+void default_sample_config(SampleConfig* config, SampleMode mode) {
+    config->mode = mode;
+    config->period = SAMPLE_PERIOD;
+    config->window = SAMPLE_WINDOW;
+    config->warm = -1;
+    config->set_ratio = SAMPLE_SET_RATIO;
+    config->batch = SAMPLE_BATCH;
+    config->confidence = SAMPLE_CONFIDENCE;
+}
+
+// Parses "time[,period=N,window=N,warm=N|all]" or "sets[,ratio=N,batch=N]",
+// either with confidence=80|90|95|99.
+int parse_sample_spec(const char* spec, SampleConfig* config) {
+    char buffer[256];
+    strncpy(buffer, spec, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = '\0';
+    char* option = strchr(buffer, ',');
+    if (option != NULL) {
+        *option++ = '\0';
+    }
+    if (strcmp(buffer, "time") == 0) {
+        default_sample_config(config, SAMPLE_TIME);
+    } else if (strcmp(buffer, "sets") == 0) {
+        default_sample_config(config, SAMPLE_SETS);
+    } else {
+        fprintf(stderr, "Unknown sampling mode \"%s\" (time, sets)\n", buffer);
+        return 0;
+    }
+    for (char* key = option != NULL ? strtok(option, ",") : NULL; key != NULL; key = strtok(NULL, ",")) {
+        char* value = strchr(key, '=');
+        int number = 0;
+        if (value == NULL) {
+            fprintf(stderr, "Expected key=value in sampling \"%s\"\n", spec);
+            return 0;
+        }
+        *value++ = '\0';
+        if (strcmp(key, "warm") == 0 && strcmp(value, "all") == 0) {
+            config->warm = -1;
+            continue;
+        }
+        if (!parse_size(value, &number)) {
+            fprintf(stderr, "Invalid value for %s in sampling \"%s\"\n", key, spec);
+            return 0;
+        }
+        if (strcmp(key, "period") == 0) {
+            config->period = number;
+        } else if (strcmp(key, "window") == 0) {
+            config->window = number;
+        } else if (strcmp(key, "warm") == 0) {
+            config->warm = number;
+        } else if (strcmp(key, "ratio") == 0) {
+            config->set_ratio = number;
+        } else if (strcmp(key, "batch") == 0) {
+            config->batch = number;
+        } else if (strcmp(key, "confidence") == 0) {
+            config->confidence = number;
+        } else {
+            fprintf(stderr, "Unknown sampling option \"%s\"\n", key);
+            return 0;
+        }
+    }
+    if (config->window <= 0 || config->period < config->window || config->batch <= 0) {
+        fprintf(stderr, "Sampling needs 0 < window <= period and a positive batch\n");
+        return 0;
+    }
+    if (config->set_ratio <= 0 || (config->set_ratio & (config->set_ratio - 1)) != 0) {
+        fprintf(stderr, "Set sampling ratio must be a power of two\n");
+        return 0;
+    }
+    if (confidence_to_z(config->confidence) == 0.0) {
+        fprintf(stderr, "Confidence must be 80, 90, 95 or 99\n");
+        return 0;
+    }
+    return 1;
+}
+
+// Set sampling keeps the accesses whose line number, at the largest line
+// size, has its low bits all zero. Those bits are part of every level's
+// set index, so every level simulates exactly 1 in set_ratio of its sets,
+// and victims cascade between sampled sets only.
+int init_sampler(Sampler* sampler, const SampleConfig* config, Simulator* simulator) {
+    memset(sampler, 0, sizeof(*sampler));
+    sampler->config = *config;
+    sampler->simulator = simulator;
+    if (config->mode != SAMPLE_SETS) {
+        return 1;
+    }
+    if (simulator->hierarchy.tlb != NULL) {
+        // The sets an access maps to are only known after translation
+        fprintf(stderr, "Set sampling needs physical trace addresses; use time sampling with tlb.enabled\n");
+        return 0;
+    }
+    const Cache* levels[NUM_CACHE_LEVELS] = { simulator->hierarchy.L1, simulator->hierarchy.L2, simulator->hierarchy.L3 };
+    int ratio_bits = 0;
+    while ((1 << ratio_bits) < config->set_ratio) {
+        ratio_bits++;
+    }
+    for (int level = 0; level < NUM_CACHE_LEVELS; level++) {
+        if (levels[level]->offset_bits > sampler->set_shift) {
+            sampler->set_shift = levels[level]->offset_bits;
+        }
+    }
+    for (int level = 0; level < NUM_CACHE_LEVELS; level++) {
+        if (sampler->set_shift + ratio_bits > levels[level]->tag_shift) {
+            fprintf(stderr, "Set sampling ratio %d is too large for L%d's %d sets\n",
+                    config->set_ratio, level + 1, levels[level]->num_sets);
+            return 0;
+        }
+    }
+    sampler->set_mask = (address_t)(config->set_ratio - 1);
+    return 1;
+}
+
+static void add_unit(RatioEstimate* estimate, double n, double y) {
+    estimate->units++;
+    estimate->n += n;
+    estimate->y += y;
+    estimate->nn += n * n;
+    estimate->yy += y * y;
+    estimate->ny += n * y;
+}
+
+// Ratio sum(y) / sum(n) and the half-width of its confidence interval,
+// from the variance of the classic ratio estimator over the units
+static double ratio_interval(const RatioEstimate* estimate, double z, double* half_width) {
+    *half_width = 0.0;
+    if (estimate->n <= 0.0) {
+        return 0.0;
+    }
+    double ratio = estimate->y / estimate->n;
+    long long k = estimate->units;
+    if (k > 1) {
+        double mean_n = estimate->n / (double)k;
+        double residual = estimate->yy - 2.0 * ratio * estimate->ny + ratio * ratio * estimate->nn;
+        double variance = (residual > 0.0 ? residual : 0.0) / ((double)k * (double)(k - 1) * mean_n * mean_n);
+        *half_width = z * sqrt(variance);
+    }
+    return ratio;
+}
+
+static void begin_unit(Sampler* sampler) {
+    const CacheStats* stats = simulator_stats(sampler->simulator);
+    sampler->unit_hits = stats->hits;
+    sampler->unit_commands = stats->total_commands;
+    sampler->unit_cycles = stats->cycles;
+}
+
+static void end_unit(Sampler* sampler) {
+    const CacheStats* stats = simulator_stats(sampler->simulator);
+    double n = (double)(stats->total_commands - sampler->unit_commands);
+    if (n > 0.0) {
+        add_unit(&sampler->hits, n, (double)(stats->hits - sampler->unit_hits));
+        add_unit(&sampler->cycles, n, (double)(stats->cycles - sampler->unit_cycles));
+    }
+}
+
+// Each unit of period accesses is skipped, then functionally warmed for
+// warm accesses, then simulated in detail for its last window accesses.
+static void sample_time_chunk(Sampler* sampler, const address_t* addresses, const unsigned char* types, int count) {
+    long long period = sampler->config.period;
+    long long detail_start = period - sampler->config.window;
+    long long warm = sampler->config.warm;
+    long long warm_start = warm < 0 || warm > detail_start ? 0 : detail_start - warm;
+    int i = 0;
+    while (i < count) {
+        long long phase = sampler->position % period;
+        long long boundary = phase < warm_start ? warm_start : phase < detail_start ? detail_start : period;
+        int run = boundary - phase < count - i ? (int)(boundary - phase) : count - i;
+        if (phase >= detail_start) {
+            if (phase == detail_start) {
+                begin_unit(sampler);
+            }
+            simulator_step_batch(sampler->simulator, addresses + i, types + i, run);
+            sampler->detailed += run;
+            if (phase + run == period) {
+                end_unit(sampler);
+            }
+        } else if (phase >= warm_start) {
+            simulator_warm_batch(sampler->simulator, addresses + i, types + i, run);
+        }
+        i += run;
+        sampler->position += run;
+    }
+}
+
+static void sample_set_chunk(Sampler* sampler, const address_t* addresses, const unsigned char* types, int count) {
+    long long batch = sampler->config.batch;
+    for (int i = 0; i < count; i++) {
+        if (((addresses[i] >> sampler->set_shift) & sampler->set_mask) != 0) {
+            continue;
+        }
+        if (sampler->detailed % batch == 0) {
+            begin_unit(sampler);
+        }
+        simulator_step(sampler->simulator, addresses[i], types[i]);
+        if (++sampler->detailed % batch == 0) {
+            end_unit(sampler);
+        }
+    }
+    sampler->position += count;
+}
+
+// TraceHandler for replay_trace
+void sample_chunk(void* context, const address_t* addresses, const unsigned char* types, int count) {
+    Sampler* sampler = (Sampler*)context;
+    if (sampler->config.mode == SAMPLE_TIME) {
+        sample_time_chunk(sampler, addresses, types, count);
+    } else {
+        sample_set_chunk(sampler, addresses, types, count);
+    }
+}
+
+// Closes a final partial batch. A detailed window cut short by the end of
+// the trace is left out, since its accesses are not a full unit.
+void finish_sampler(Sampler* sampler) {
+    if (sampler->config.mode == SAMPLE_SETS && sampler->detailed % sampler->config.batch != 0) {
+        end_unit(sampler);
+    }
+}
+
+// scale and decimals format actual the way the estimate was printed
+static void print_check(double estimate, double half_width, double actual, double scale, int decimals, const char* unit) {
+    double error = actual != 0.0 ? 100.0 * (estimate - actual) / actual : 0.0;
+    int inside = fabs(estimate - actual) <= half_width;
+    printf("    full run %.*f%s, error %+.2f%% (%s the interval)\n", decimals, scale * actual, unit, error,
+           inside ? "inside" : "outside");
+}
+
+// Estimates for the whole trace from the sampled units; full, when given,
+// holds the counters of a complete run to check them against.
+void print_sample_estimates(const Sampler* sampler, const CacheStats* full) {
+    const SampleConfig* config = &sampler->config;
+    double z = confidence_to_z(config->confidence);
+    double total = (double)sampler->position;
+    if (config->mode == SAMPLE_TIME) {
+        char warm[32];
+        if (config->warm < 0) {
+            snprintf(warm, sizeof(warm), "all");
+        } else {
+            snprintf(warm, sizeof(warm), "%lld", config->warm);
+        }
+        printf("Sampling: time, period %lld, window %lld, warm %s\n", config->period, config->window, warm);
+    } else {
+        printf("Sampling: sets, 1 in %d, batches of %lld\n", config->set_ratio, config->batch);
+    }
+    printf("  %lld units, %lld of %lld accesses in detail (%.2f%%)\n", sampler->hits.units, sampler->detailed,
+           sampler->position, total > 0.0 ? 100.0 * (double)sampler->detailed / total : 0.0);
+    if (sampler->hits.units < 2) {
+        printf("  Too few units for a confidence interval; use a shorter period or batch\n");
+    }
+
+    double hit_width;
+    double cycle_width;
+    double hit_rate = ratio_interval(&sampler->hits, z, &hit_width);
+    double per_access = ratio_interval(&sampler->cycles, z, &cycle_width);
+    printf("  Hit rate        : %.2f%% +/- %.2f%% (%d%% confidence)\n", 100.0 * hit_rate, 100.0 * hit_width, config->confidence);
+    if (full != NULL && full->total_commands > 0) {
+        print_check(hit_rate, hit_width, (double)full->hits / (double)full->total_commands, 100.0, 2, "%");
+    }
+    printf("  Cycles / access : %.2f +/- %.2f\n", per_access, cycle_width);
+    if (full != NULL && full->total_commands > 0) {
+        print_check(per_access, cycle_width, (double)full->cycles / (double)full->total_commands, 1.0, 2, "");
+    }
+    printf("  Total cycles    : %.0f +/- %.0f\n", per_access * total, cycle_width * total);
+    if (full != NULL) {
+        print_check(per_access * total, cycle_width * total, (double)full->cycles, 1.0, 0, "");
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include "simulator.h"
+
+// Defaults of the sampled simulation modes
+#define SAMPLE_PERIOD 20000     // Accesses per time-sampling unit
+#define SAMPLE_WINDOW 1000      // Accesses simulated in detail at the end of each unit
+#define SAMPLE_SET_RATIO 16     // Set sampling simulates 1 in this many sets
+#define SAMPLE_BATCH 1000       // Sampled accesses per batch when set sampling
+#define SAMPLE_CONFIDENCE 95    // Percent
+
+typedef enum {
+    SAMPLE_TIME, // SMARTS: periodic detailed windows, functional warming in between
+    SAMPLE_SETS  // Only the accesses of a fixed subset of the cache sets
+} SampleMode;
+
+typedef struct {
+    SampleMode mode;
+    long long period;
+    long long window;
+    long long warm;   // Accesses warmed before each window; the rest of the unit is skipped (-1 = all)
+    int set_ratio;    // Power of two
+    long long batch;
+    int confidence;   // 80, 90, 95 or 99
+} SampleConfig;
+
+// Ratio estimate over sampling units: the sums needed for sum(y) / sum(n)
+// and its variance, without keeping the units
+typedef struct {
+    long long units;
+    double n, y, nn, yy, ny;
+} RatioEstimate;
+
+// A sampled run over one trace. For time sampling each unit is one
+// detailed window; for set sampling each unit is a batch of consecutive
+// sampled accesses, so the interval reflects how the sampled sets vary
+// over the run.
+typedef struct {
+    SampleConfig config;
+    Simulator* simulator;
+    long long position;       // Trace accesses seen
+    long long detailed;       // Accesses simulated in detail
+    int set_shift;            // Set sampling: address bits above the largest line offset
+    address_t set_mask;
+    unsigned long long unit_hits;     // Counters when the current unit started
+    unsigned long long unit_commands;
+    unsigned long long unit_cycles;
+    RatioEstimate hits;       // Hits per access
+    RatioEstimate cycles;     // Cycles per access
+} Sampler;
+
+void default_sample_config(SampleConfig* config, SampleMode mode);
+int parse_sample_spec(const char* spec, SampleConfig* config);
+int init_sampler(Sampler* sampler, const SampleConfig* config, Simulator* simulator);
+void sample_chunk(void* context, const address_t* addresses, const unsigned char* types, int count);
+void finish_sampler(Sampler* sampler);
+void print_sample_estimates(const Sampler* sampler, const CacheStats* full);
+
+#endif // SAMPLING_H
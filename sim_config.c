@@ -0,0 +1,437 @@
+#include "sim_config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define MAX_CONFIG_LINE 256
+
+void default_sim_config(SimConfig* config) {
+    config->L1 = (CacheConfig){ L1_SIZE, BLOCK_SIZE, 1, L1_cycles, REPLACE_LRU, { PREFETCH_NONE, PREFETCH_DEGREE }, L1_MSHRS };
+    config->L2 = (CacheConfig){ L2_SIZE, BLOCK_SIZE, 1, L2_cycles, REPLACE_LRU, { PREFETCH_NONE, PREFETCH_DEGREE }, L2_MSHRS };
+    config->L3 = (CacheConfig){ L3_SIZE, BLOCK_SIZE, 1, L3_cycles, REPLACE_LRU, { PREFETCH_NONE, PREFETCH_DEGREE }, L3_MSHRS };
+    default_dram_config(&config->dram);
+    config->write = (WriteConfig){ WRITE_BACK, 1 };
+    default_coherence_config(&config->coherence);
+    config->core = (CoreConfig){ CORE_SERIAL, CORE_ROB_SIZE, CORE_WIDTH };
+    config->inclusion = (InclusionConfig){ INCLUSION_EXCLUSIVE, 0, VICTIM_CACHE_LATENCY, BACK_INVALIDATE_CYCLES };
+    default_tlb_config(&config->tlb);
+}
+
+// Parses "64", "32K", "2M" or "1G" into bytes.
+int parse_size(const char* text, int* value) {
+    char* end;
+    long long number = strtoll(text, &end, 0);
+    switch (toupper((unsigned char)*end)) {
+        case 'K': number *= 1024; end++; break;
+        case 'M': number *= 1024 * 1024; end++; break;
+        case 'G': number *= 1024 * 1024 * 1024; end++; break;
+        default: break;
+    }
+    if (toupper((unsigned char)*end) == 'B') {
+        end++;
+    }
+    if (end == text || *end != '\0' || number < 0 || number > 0x7FFFFFFF) {
+        return 0;
+    }
+    *value = (int)number;
+    return 1;
+}
+
+static char* trim(char* text) {
+    while (isspace((unsigned char)*text)) {
+        text++;
+    }
+    char* end = text + strlen(text);
+    while (end > text && isspace((unsigned char)end[-1])) {
+        *--end = '\0';
+    }
+    return text;
+}
+
+static CacheConfig* find_level(SimConfig* config, const char* name) {
+    if (strcmp(name, "l1") == 0 || strcmp(name, "L1") == 0) return &config->L1;
+    if (strcmp(name, "l2") == 0 || strcmp(name, "L2") == 0) return &config->L2;
+    if (strcmp(name, "l3") == 0 || strcmp(name, "L3") == 0) return &config->L3;
+    return NULL;
+}
+
+static int* find_dram_field(DramConfig* dram, const char* name) {
+    if (strcmp(name, "channels") == 0) return &dram->channels;
+    if (strcmp(name, "ranks") == 0) return &dram->ranks;
+    if (strcmp(name, "banks") == 0) return &dram->banks;
+    if (strcmp(name, "trcd") == 0) return &dram->timing.tRCD;
+    if (strcmp(name, "trp") == 0) return &dram->timing.tRP;
+    if (strcmp(name, "tcl") == 0) return &dram->timing.tCL;
+    if (strcmp(name, "tras") == 0) return &dram->timing.tRAS;
+    if (strcmp(name, "trrd") == 0) return &dram->timing.tRRD;
+    if (strcmp(name, "tfaw") == 0) return &dram->timing.tFAW;
+    if (strcmp(name, "tburst") == 0) return &dram->timing.tBURST;
+    if (strcmp(name, "trefi") == 0) return &dram->timing.tREFI;
+    if (strcmp(name, "trfc") == 0) return &dram->timing.tRFC;
+    if (strcmp(name, "page_timeout") == 0) return &dram->page_timeout;
+    return NULL;
+}
+
+static int* find_coherence_field(CoherenceConfig* coherence, const char* name) {
+    if (strcmp(name, "snoop_latency") == 0) return &coherence->snoop_latency;
+    if (strcmp(name, "directory_latency") == 0) return &coherence->directory_latency;
+    if (strcmp(name, "transfer_latency") == 0) return &coherence->transfer_latency;
+    return NULL;
+}
+
+static int* find_core_field(CoreConfig* core, const char* name) {
+    if (strcmp(name, "rob") == 0) return &core->rob_size;
+    if (strcmp(name, "width") == 0) return &core->width;
+    return NULL;
+}
+
+static int* find_inclusion_field(InclusionConfig* inclusion, const char* name) {
+    if (strcmp(name, "victim_entries") == 0) return &inclusion->victim_entries;
+    if (strcmp(name, "victim_latency") == 0) return &inclusion->victim_latency;
+    if (strcmp(name, "back_invalidate") == 0) return &inclusion->back_invalidate_latency;
+    return NULL;
+}
+
+static int* find_tlb_field(TlbConfig* tlb, const char* name) {
+    if (strcmp(name, "enabled") == 0) return &tlb->enabled;
+    if (strcmp(name, "l1_entries") == 0) return &tlb->l1_entries;
+    if (strcmp(name, "l1_assoc") == 0) return &tlb->l1_assoc;
+    if (strcmp(name, "l2_entries") == 0) return &tlb->l2_entries;
+    if (strcmp(name, "l2_assoc") == 0) return &tlb->l2_assoc;
+    if (strcmp(name, "l2_latency") == 0) return &tlb->l2_latency;
+    if (strcmp(name, "memory_mb") == 0) return &tlb->memory_mb;
+    if (strcmp(name, "seed") == 0) return &tlb->seed;
+    return NULL;
+}
+
+// Applies one "key=value" setting, e.g. "l2.size=256K" or "l1.assoc=1".
+// Cache keys are <level>.size, .line, .assoc, .latency, .policy, .prefetch
+// (none, nextline, stride, stream, bestoffset), .prefetch_degree and .mshrs;
+// dram.mapping selects the DRAM address mapping, by name or as a spec (see
+// address_mapping.c); dram.channels, .ranks and
+// .banks its organisation and dram.trcd, .trp, .tcl, .tras, .trrd, .tfaw,
+// .tburst, .trefi and .trfc its timing in cycles; dram.page_policy and
+// dram.page_timeout its row-buffer management. write.policy (writeback,
+// writethrough) and write.allocate (1, 0) select how stores are handled.
+// coherence.protocol (mesi, moesi), coherence.mechanism (snoop, directory)
+// and coherence.snoop_latency, .directory_latency and .transfer_latency
+// apply to multi-core runs. core.model (serial, ooo) selects the timing
+// model and core.rob and core.width size the out-of-order window.
+// inclusion.policy (exclusive, inclusive, nine) selects how the levels
+// share lines, inclusion.back_invalidate the cycles per line an inclusive
+// eviction removes above, and inclusion.victim_entries and
+// .victim_latency the victim cache behind L1 (0 entries = none).
+// tlb.enabled=1 translates trace addresses before L1: tlb.page (4k, 2m,
+// 1g) and tlb.allocator (identity, sequential, random) select the page
+// size and how frames are handed out, tlb.l1_entries, .l1_assoc,
+// .l2_entries, .l2_assoc and .l2_latency size the TLBs, and
+// tlb.memory_mb and tlb.seed set up the allocator.
+int set_sim_option(SimConfig* config, const char* assignment) {
+    char buffer[MAX_CONFIG_LINE];
+    strncpy(buffer, assignment, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = '\0';
+
+    char* equals = strchr(buffer, '=');
+    if (equals == NULL) {
+        fprintf(stderr, "Expected key=value, got \"%s\"\n", assignment);
+        return 0;
+    }
+    *equals = '\0';
+    char* key = trim(buffer);
+    char* value = trim(equals + 1);
+
+    if (strcmp(key, "dram.mapping") == 0) {
+        // Checked against the organisation in validate_sim_config
+        if (strlen(value) >= sizeof(config->dram.mapping)) {
+            fprintf(stderr, "DRAM mapping too long in \"%s\"\n", assignment);
+            return 0;
+        }
+        strcpy(config->dram.mapping, value);
+        return 1;
+    }
+
+    if (strcmp(key, "write.policy") == 0) {
+        if (!parse_write_policy(value, &config->write.policy)) {
+            fprintf(stderr, "Unknown write policy in \"%s\" (writeback, writethrough)\n", assignment);
+            return 0;
+        }
+        return 1;
+    }
+    if (strcmp(key, "inclusion.policy") == 0) {
+        if (!parse_inclusion_policy(value, &config->inclusion.policy)) {
+            fprintf(stderr, "Unknown inclusion policy in \"%s\" (exclusive, inclusive, nine)\n", assignment);
+            return 0;
+        }
+        return 1;
+    }
+    if (strcmp(key, "tlb.page") == 0) {
+        if (!parse_page_size(value, &config->tlb.page_size)) {
+            fprintf(stderr, "Unknown page size in \"%s\" (4k, 2m, 1g)\n", assignment);
+            return 0;
+        }
+        return 1;
+    }
+    if (strcmp(key, "tlb.allocator") == 0) {
+        if (!parse_frame_allocator(value, &config->tlb.allocator)) {
+            fprintf(stderr, "Unknown frame allocator in \"%s\" (identity, sequential, random)\n", assignment);
+            return 0;
+        }
+        return 1;
+    }
+    if (strcmp(key, "write.allocate") == 0) {
+        if (strcmp(value, "1") != 0 && strcmp(value, "0") != 0) {
+            fprintf(stderr, "Expected 1 or 0 in \"%s\"\n", assignment);
+            return 0;
+        }
+        config->write.allocate = value[0] == '1';
+        return 1;
+    }
+    if (strcmp(key, "dram.page_policy") == 0) {
+        if (!parse_page_policy(value, &config->dram.page_policy)) {
+            fprintf(stderr, "Unknown page policy in \"%s\" (open, closed, timeout, adaptive)\n", assignment);
+            return 0;
+        }
+        return 1;
+    }
+    if (strcmp(key, "coherence.protocol") == 0) {
+        if (!parse_coherence_protocol(value, &config->coherence.protocol)) {
+            fprintf(stderr, "Unknown coherence protocol in \"%s\" (mesi, moesi)\n", assignment);
+            return 0;
+        }
+        return 1;
+    }
+    if (strcmp(key, "coherence.mechanism") == 0) {
+        if (!parse_coherence_mechanism(value, &config->coherence.mechanism)) {
+            fprintf(stderr, "Unknown coherence mechanism in \"%s\" (snoop, directory)\n", assignment);
+            return 0;
+        }
+        return 1;
+    }
+    if (strcmp(key, "core.model") == 0) {
+        if (!parse_core_model(value, &config->core.model)) {
+            fprintf(stderr, "Unknown core model in \"%s\" (serial, ooo)\n", assignment);
+            return 0;
+        }
+        return 1;
+    }
+    if (strncmp(key, "core.", 5) == 0) {
+        int* field = find_core_field(&config->core, key + 5);
+        int number;
+        if (field == NULL) {
+            fprintf(stderr, "Unknown setting \"%s\"\n", assignment);
+            return 0;
+        }
+        if (!parse_size(value, &number)) {
+            fprintf(stderr, "Invalid value in \"%s\"\n", assignment);
+            return 0;
+        }
+        *field = number;
+        return 1;
+    }
+    if (strncmp(key, "inclusion.", 10) == 0) {
+        int* field = find_inclusion_field(&config->inclusion, key + 10);
+        int number;
+        if (field == NULL) {
+            fprintf(stderr, "Unknown setting \"%s\"\n", assignment);
+            return 0;
+        }
+        if (!parse_size(value, &number)) {
+            fprintf(stderr, "Invalid value in \"%s\"\n", assignment);
+            return 0;
+        }
+        *field = number;
+        return 1;
+    }
+    if (strncmp(key, "tlb.", 4) == 0) {
+        int* field = find_tlb_field(&config->tlb, key + 4);
+        int number;
+        if (field == NULL) {
+            fprintf(stderr, "Unknown setting \"%s\"\n", assignment);
+            return 0;
+        }
+        if (!parse_size(value, &number)) {
+            fprintf(stderr, "Invalid value in \"%s\"\n", assignment);
+            return 0;
+        }
+        *field = number;
+        return 1;
+    }
+    if (strncmp(key, "coherence.", 10) == 0) {
+        int* field = find_coherence_field(&config->coherence, key + 10);
+        int number;
+        if (field == NULL) {
+            fprintf(stderr, "Unknown setting \"%s\"\n", assignment);
+            return 0;
+        }
+        if (!parse_size(value, &number)) {
+            fprintf(stderr, "Invalid value in \"%s\"\n", assignment);
+            return 0;
+        }
+        *field = number;
+        return 1;
+    }
+    if (strncmp(key, "dram.", 5) == 0) {
+        int* field = find_dram_field(&config->dram, key + 5);
+        int number;
+        if (field == NULL) {
+            fprintf(stderr, "Unknown setting \"%s\"\n", assignment);
+            return 0;
+        }
+        if (!parse_size(value, &number)) {
+            fprintf(stderr, "Invalid value in \"%s\"\n", assignment);
+            return 0;
+        }
+        *field = number;
+        return 1;
+    }
+
+    char* dot = strchr(key, '.');
+    CacheConfig* level = NULL;
+    if (dot != NULL) {
+        *dot = '\0';
+        level = find_level(config, key);
+        key = dot + 1;
+    }
+    if (level == NULL) {
+        fprintf(stderr, "Unknown setting \"%s\"\n", assignment);
+        return 0;
+    }
+
+    if (strcmp(key, "policy") == 0) {
+        if (!parse_replacement_policy(value, &level->policy)) {
+            fprintf(stderr, "Unknown replacement policy in \"%s\" (lru, plru, srrip, brrip)\n", assignment);
+            return 0;
+        }
+        return 1;
+    }
+    if (strcmp(key, "prefetch") == 0) {
+        if (!parse_prefetcher(value, &level->prefetch.type)) {
+            fprintf(stderr, "Unknown prefetcher in \"%s\" (none, nextline, stride, stream, bestoffset)\n", assignment);
+            return 0;
+        }
+        return 1;
+    }
+
+    int number;
+    if (!parse_size(value, &number)) {
+        fprintf(stderr, "Invalid value in \"%s\"\n", assignment);
+        return 0;
+    }
+    if (strcmp(key, "size") == 0) {
+        level->size = number;
+    } else if (strcmp(key, "line") == 0) {
+        level->line_size = number;
+    } else if (strcmp(key, "assoc") == 0) {
+        level->associativity = number;
+    } else if (strcmp(key, "latency") == 0) {
+        level->latency = number;
+    } else if (strcmp(key, "prefetch_degree") == 0) {
+        level->prefetch.degree = number;
+    } else if (strcmp(key, "mshrs") == 0) {
+        level->mshrs = number;
+    } else {
+        fprintf(stderr, "Unknown setting \"%s\"\n", assignment);
+        return 0;
+    }
+    return 1;
+}
+
+// Reads key=value lines; blank lines and lines starting with # are skipped.
+int load_sim_config(SimConfig* config, const char* filename) {
+    FILE* file = fopen(filename, "r");
+    if (file == NULL) {
+        perror("Error opening config file");
+        return 0;
+    }
+    char line[MAX_CONFIG_LINE];
+    int line_number = 0;
+    int ok = 1;
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+        char* text = trim(line);
+        if (*text == '\0' || *text == '#') {
+            continue;
+        }
+        if (!set_sim_option(config, text)) {
+            fprintf(stderr, "%s:%d: bad setting\n", filename, line_number);
+            ok = 0;
+        }
+    }
+    fclose(file);
+    return ok;
+}
+
+int validate_sim_config(const SimConfig* config) {
+    return validate_cache_config(&config->L1, "L1") &
+           validate_cache_config(&config->L2, "L2") &
+           validate_cache_config(&config->L3, "L3") &
+           validate_dram_config(&config->dram) &
+           validate_core_config(&config->core) &
+           validate_inclusion_config(&config->inclusion) &
+           validate_tlb_config(&config->tlb);
+}
+
+static void print_level(const CacheConfig* level, const char* name) {
+    printf("%s: %d bytes, %d-byte lines, %d-way %s, %d cycles",
+           name, level->size, level->line_size, level->associativity,
+           replacement_policy_name(level->policy), level->latency);
+    if (level->prefetch.type != PREFETCH_NONE) {
+        printf(", %s prefetch x%d", prefetcher_name(level->prefetch.type), level->prefetch.degree);
+    }
+    printf("\n");
+}
+
+void print_sim_config(const SimConfig* config) {
+    print_level(&config->L1, "L1");
+    print_level(&config->L2, "L2");
+    print_level(&config->L3, "L3");
+    const DramTiming* t = &config->dram.timing;
+    printf("DRAM: %s, %d channels x %d ranks x %d banks, tRCD %d tRP %d tCL %d tRAS %d tRRD %d tFAW %d tBURST %d tREFI %d tRFC %d, %s pages",
+           config->dram.mapping, config->dram.channels, config->dram.ranks, config->dram.banks,
+           t->tRCD, t->tRP, t->tCL, t->tRAS, t->tRRD, t->tFAW, t->tBURST, t->tREFI, t->tRFC,
+           page_policy_name(config->dram.page_policy));
+    if (config->dram.page_policy == PAGE_TIMEOUT) {
+        printf(" (%d cycles)", config->dram.page_timeout);
+    }
+    printf("\n");
+    printf("Stores: %s, %s\n", write_policy_name(config->write.policy),
+           config->write.allocate ? "write-allocate" : "no-write-allocate");
+    printf("Coherence: %s over %s, snoop %d directory %d transfer %d cycles\n",
+           coherence_protocol_name(config->coherence.protocol),
+           coherence_mechanism_name(config->coherence.mechanism),
+           config->coherence.snoop_latency, config->coherence.directory_latency,
+           config->coherence.transfer_latency);
+    printf("Inclusion: %s", inclusion_policy_name(config->inclusion.policy));
+    if (config->inclusion.policy == INCLUSION_INCLUSIVE) {
+        printf(", %d cycles per back-invalidation", config->inclusion.back_invalidate_latency);
+    }
+    if (config->inclusion.victim_entries > 0) {
+        printf(", %d-entry victim cache (+%d cycles)", config->inclusion.victim_entries, config->inclusion.victim_latency);
+    }
+    printf("\n");
+    if (config->core.model == CORE_OOO) {
+        printf("Core: out-of-order, %d-entry ROB, %d wide, %d/%d/%d MSHRs\n", config->core.rob_size, config->core.width,
+               config->L1.mshrs, config->L2.mshrs, config->L3.mshrs);
+    } else {
+        printf("Core: serial\n");
+    }
+    if (config->tlb.enabled) {
+        printf("TLB: %s pages, L1 %d entries %d-way, L2 %d entries %d-way (+%d cycles), %s frames from %d MB\n",
+               page_size_name(config->tlb.page_size), config->tlb.l1_entries, config->tlb.l1_assoc,
+               config->tlb.l2_entries, config->tlb.l2_assoc, config->tlb.l2_latency,
+               frame_allocator_name(config->tlb.allocator), config->tlb.memory_mb);
+    } else {
+        printf("TLB: none, trace addresses are physical\n");
+    }
+}
+
+void init_hierarchy_from_config(CacheHierarchy* hierarchy, const SimConfig* config) {
+    init_hierarchy(hierarchy, &config->L1, &config->L2, &config->L3, &config->dram, &config->write);
+    set_inclusion(hierarchy, &config->inclusion);
+    set_translation(hierarchy, &config->tlb);
+    if (config->core.model == CORE_OOO) {
+        int mshrs[NUM_CACHE_LEVELS] = { config->L1.mshrs, config->L2.mshrs, config->L3.mshrs };
+        hierarchy->core = create_core_model(&config->core, mshrs);
+    }
+}
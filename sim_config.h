@@ -0,0 +1,29 @@
+#ifndef SIM_CONFIG_H
+#define SIM_CONFIG_H
+
+#include "cache_simulation.h"
+#include "coherence.h"
+
+// Everything a run can be configured with. Defaults come from the macros
+// in cache_simulation.h; --config <file> and --set key=value override them.
+typedef struct {
+    CacheConfig L1;
+    CacheConfig L2;
+    CacheConfig L3;
+    DramConfig dram;
+    WriteConfig write;
+    CoherenceConfig coherence; // Multi-core runs only
+    CoreConfig core;
+    InclusionConfig inclusion;
+    TlbConfig tlb;
+} SimConfig;
+
+int parse_size(const char* text, int* value);
+void default_sim_config(SimConfig* config);
+int set_sim_option(SimConfig* config, const char* assignment);
+int load_sim_config(SimConfig* config, const char* filename);
+int validate_sim_config(const SimConfig* config);
+void print_sim_config(const SimConfig* config);
+void init_hierarchy_from_config(CacheHierarchy* hierarchy, const SimConfig* config);
+
+#endif // SIM_CONFIG_H
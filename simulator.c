@@ -0,0 +1,65 @@
+#include "simulator.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// The config must already have passed validate_sim_config.
+Simulator* create_simulator(const SimConfig* config) {
+    Simulator* simulator = (Simulator*)malloc(sizeof(Simulator));
+    if (simulator == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    simulator->config = *config;
+    init_hierarchy_from_config(&simulator->hierarchy, config);
+    init_trace_resolver(&simulator->resolver);
+    return simulator;
+}
+
+// Runs one resolved address through the hierarchy; type is its AccessType.
+void simulator_step(Simulator* simulator, address_t address, unsigned char type) {
+    full_cache_logic(&simulator->hierarchy, address, type == ACCESS_STORE);
+}
+
+// types may be NULL, in which case every access is treated as a load.
+void simulator_step_batch(Simulator* simulator, const address_t* addresses, const unsigned char* types, int count) {
+    for (int i = 0; i < count; i++) {
+        full_cache_logic(&simulator->hierarchy, addresses[i], types != NULL && types[i] == ACCESS_STORE);
+    }
+}
+
+// Fast-forwards through accesses: the caches warm up but no cycles pass
+// and no statistics are collected.
+void simulator_warm_batch(Simulator* simulator, const address_t* addresses, const unsigned char* types, int count) {
+    for (int i = 0; i < count; i++) {
+        warm_access(&simulator->hierarchy, addresses[i], types != NULL && types[i] == ACCESS_STORE);
+    }
+}
+
+// Feeds one raw text trace line (without its newline). Because an Info
+// line can still replace the previous access, each access is simulated
+// one line late; call simulator_finish after the last line.
+void simulator_step_line(Simulator* simulator, const char* line) {
+    TraceOp op;
+    TraceAccess access;
+    decode_command(line, &op);
+    if (resolve_trace_line(&simulator->resolver, &op, &access)) {
+        full_cache_logic(&simulator->hierarchy, access.address, access.type == ACCESS_STORE);
+    }
+}
+
+// Simulates the access still held back by simulator_step_line, if any.
+void simulator_finish(Simulator* simulator) {
+    TraceAccess access;
+    if (flush_trace_resolver(&simulator->resolver, &access)) {
+        full_cache_logic(&simulator->hierarchy, access.address, access.type == ACCESS_STORE);
+    }
+}
+
+const CacheStats* simulator_stats(const Simulator* simulator) {
+    return &simulator->hierarchy.stats;
+}
+
+void destroy_simulator(Simulator* simulator) {
+    free_hierarchy(&simulator->hierarchy);
+    free(simulator);
+}
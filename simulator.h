@@ -0,0 +1,26 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include "sim_config.h"
+#include "extract_address_trace.h"
+
+// A complete, self-contained simulation: cache levels, DRAM model,
+// counters and the trace parser's register file. Nothing is shared
+// between simulators, so any number can run side by side on different
+// threads.
+typedef struct {
+    SimConfig config;
+    CacheHierarchy hierarchy;
+    TraceResolver resolver;
+} Simulator;
+
+Simulator* create_simulator(const SimConfig* config);
+void simulator_step(Simulator* simulator, address_t address, unsigned char type);
+void simulator_step_batch(Simulator* simulator, const address_t* addresses, const unsigned char* types, int count);
+void simulator_warm_batch(Simulator* simulator, const address_t* addresses, const unsigned char* types, int count);
+void simulator_step_line(Simulator* simulator, const char* line);
+void simulator_finish(Simulator* simulator);
+const CacheStats* simulator_stats(const Simulator* simulator);
+void destroy_simulator(Simulator* simulator);
+
+#endif // SIMULATOR_H
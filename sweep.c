@@ -0,0 +1,338 @@
+#include "sweep.h"
+#include "simulator.h"
+#include "trace_stream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+// Per-worker job queue. The owner takes jobs from the bottom; idle workers
+// steal from the top, so long-running configurations do not leave the
+// other threads waiting.
+typedef struct {
+    int* jobs;
+    int top;
+    int bottom;
+    pthread_mutex_t lock;
+} JobDeque;
+
+typedef struct {
+    SweepJob* jobs;
+    const address_t* addresses;
+    const unsigned char* types; // AccessType per address
+    long long num_addresses;
+    int num_workers;
+    JobDeque* deques;
+} SweepPool;
+
+typedef struct {
+    SweepPool* pool;
+    int id;
+    pthread_t thread;
+} SweepWorker;
+
+static char* trim(char* text) {
+    while (*text == ' ' || *text == '\t') {
+        text++;
+    }
+    char* end = text + strlen(text);
+    while (end > text && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\n' || end[-1] == '\r')) {
+        *--end = '\0';
+    }
+    return text;
+}
+
+// Each non-blank line not starting with # is one job: whitespace-separated
+// key=value settings applied on top of the base configuration. Returns the
+// number of jobs, or -1 on error.
+int load_sweep_jobs(const char* filename, const SimConfig* base, SweepJob** jobs) {
+    FILE* file = fopen(filename, "r");
+    if (file == NULL) {
+        perror("Error opening sweep file");
+        return -1;
+    }
+    int capacity = 16;
+    int count = 0;
+    *jobs = (SweepJob*)malloc(sizeof(SweepJob) * (size_t)capacity);
+    if (*jobs == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    char line[MAX_SWEEP_LABEL];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+        char* text = trim(line);
+        if (*text == '\0' || *text == '#') {
+            continue;
+        }
+        if (count == capacity) {
+            capacity *= 2;
+            *jobs = (SweepJob*)realloc(*jobs, sizeof(SweepJob) * (size_t)capacity);
+            if (*jobs == NULL) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        SweepJob* job = &(*jobs)[count];
+        memset(job, 0, sizeof(SweepJob));
+        strcpy(job->label, text);
+        job->config = *base;
+
+        char settings[MAX_SWEEP_LABEL];
+        strcpy(settings, text);
+        for (char* setting = strtok(settings, " \t"); setting != NULL; setting = strtok(NULL, " \t")) {
+            if (!set_sim_option(&job->config, setting)) {
+                fprintf(stderr, "%s:%d: bad setting\n", filename, line_number);
+                fclose(file);
+                free(*jobs);
+                return -1;
+            }
+        }
+        if (!validate_sim_config(&job->config)) {
+            fprintf(stderr, "%s:%d: invalid configuration\n", filename, line_number);
+            fclose(file);
+            free(*jobs);
+            return -1;
+        }
+        count++;
+    }
+    fclose(file);
+    return count;
+}
+
+static double wall_seconds(void) {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+// Each job gets its own simulator; the trace is shared read-only.
+static void run_job(SweepPool* pool, SweepJob* job) {
+    double start = wall_seconds();
+    Simulator* simulator = create_simulator(&job->config);
+    for (long long i = 0; i < pool->num_addresses; i += TRACE_CHUNK_SIZE) {
+        long long count = pool->num_addresses - i < TRACE_CHUNK_SIZE ? pool->num_addresses - i : TRACE_CHUNK_SIZE;
+        simulator_step_batch(simulator, pool->addresses + i, pool->types + i, (int)count);
+    }
+    job->stats = *simulator_stats(simulator);
+    job->effective_capacity = effective_capacity(&simulator->hierarchy);
+    destroy_simulator(simulator);
+    job->seconds = wall_seconds() - start;
+}
+
+static int pop_own_job(JobDeque* deque) {
+    int job = -1;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom > deque->top) {
+        job = deque->jobs[--deque->bottom];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return job;
+}
+
+static int steal_job(JobDeque* deque) {
+    int job = -1;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom > deque->top) {
+        job = deque->jobs[deque->top++];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return job;
+}
+
+static void* sweep_worker(void* arg) {
+    SweepWorker* worker = (SweepWorker*)arg;
+    SweepPool* pool = worker->pool;
+    for (;;) {
+        int job = pop_own_job(&pool->deques[worker->id]);
+        // Jobs never spawn jobs, so once every deque is empty we are done
+        for (int i = 1; job < 0 && i < pool->num_workers; i++) {
+            job = steal_job(&pool->deques[(worker->id + i) % pool->num_workers]);
+        }
+        if (job < 0) {
+            return NULL;
+        }
+        run_job(pool, &pool->jobs[job]);
+    }
+}
+
+void run_sweep(SweepJob* jobs, int num_jobs, const address_t* addresses, const unsigned char* types,
+               long long num_addresses, int num_threads) {
+    if (num_threads > num_jobs) {
+        num_threads = num_jobs;
+    }
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+
+    SweepPool pool = { jobs, addresses, types, num_addresses, num_threads, NULL };
+    pool.deques = (JobDeque*)calloc((size_t)num_threads, sizeof(JobDeque));
+    SweepWorker* workers = (SweepWorker*)calloc((size_t)num_threads, sizeof(SweepWorker));
+    if (pool.deques == NULL || workers == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    // Deal the jobs out round-robin
+    for (int w = 0; w < num_threads; w++) {
+        JobDeque* deque = &pool.deques[w];
+        deque->jobs = (int*)malloc(sizeof(int) * (size_t)(num_jobs / num_threads + 1));
+        if (deque->jobs == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int j = w; j < num_jobs; j += num_threads) {
+            deque->jobs[deque->bottom++] = j;
+        }
+        pthread_mutex_init(&deque->lock, NULL);
+    }
+
+    for (int w = 0; w < num_threads; w++) {
+        workers[w].pool = &pool;
+        workers[w].id = w;
+    }
+    int started = 0;
+    for (int w = 1; w < num_threads; w++) {
+        if (pthread_create(&workers[w].thread, NULL, sweep_worker, &workers[w]) != 0) {
+            break;
+        }
+        started = w;
+    }
+    // The calling thread is worker 0; it also steals the jobs of any worker
+    // that could not be started
+    sweep_worker(&workers[0]);
+    for (int w = 1; w <= started; w++) {
+        pthread_join(workers[w].thread, NULL);
+    }
+
+    for (int w = 0; w < num_threads; w++) {
+        pthread_mutex_destroy(&pool.deques[w].lock);
+        free(pool.deques[w].jobs);
+    }
+    free(pool.deques);
+    free(workers);
+}
+
+// Prefetch counters summed over the levels
+static PrefetchStats total_prefetch_stats(const CacheStats* stats) {
+    PrefetchStats total = { 0, 0, 0, 0, 0, 0 };
+    for (int level = 0; level < NUM_CACHE_LEVELS; level++) {
+        total.issued += stats->prefetch[level].issued;
+        total.useful += stats->prefetch[level].useful;
+        total.late += stats->prefetch[level].late;
+        total.dropped += stats->prefetch[level].dropped;
+        total.demand_misses += stats->prefetch[level].demand_misses;
+        total.pollution += stats->prefetch[level].pollution;
+    }
+    return total;
+}
+
+// AMAT and achieved MLP of an out-of-order run; a serial core waits out
+// every access, so its AMAT is cycles per access and its MLP 1.
+static double average_latency(const CacheStats* stats) {
+    if (stats->timing.accesses > 0) {
+        return (double)stats->timing.latency_cycles / (double)stats->timing.accesses;
+    }
+    return stats->total_commands > 0 ? (double)stats->cycles / (double)stats->total_commands : 0.0;
+}
+
+static double achieved_mlp(const CacheStats* stats) {
+    if (stats->timing.dram_busy_cycles > 0) {
+        return (double)stats->timing.dram_miss_cycles / (double)stats->timing.dram_busy_cycles;
+    }
+    return stats->misses > 0 ? 1.0 : 0.0;
+}
+
+static const char* page_label(const SimConfig* config) {
+    return config->tlb.enabled ? page_size_name(config->tlb.page_size) : "none";
+}
+
+static void write_csv(const SweepJob* jobs, int num_jobs, FILE* out) {
+    fprintf(out, "settings,l1_size,l1_assoc,l1_policy,l1_prefetch,l2_size,l2_assoc,l2_policy,l2_prefetch,"
+                 "l3_size,l3_assoc,l3_policy,l3_prefetch,"
+                 "dram_mapping,write_policy,write_allocate,accesses,hits,misses,cycles,hit_l1,hit_l2,hit_l3,misses_l1,misses_l2,misses_l3,"
+                 "stores,dram_reads,dram_writes,prefetch_issued,prefetch_useful,prefetch_late,core_model,amat,mlp,"
+                 "inclusion,victim_entries,victim_hits,back_invalidations,effective_capacity,tlb_page,tlb_walks,translation_cycles,seconds\n");
+    for (int i = 0; i < num_jobs; i++) {
+        const SweepJob* job = &jobs[i];
+        const SimConfig* c = &job->config;
+        const CacheStats* s = &job->stats;
+        PrefetchStats p = total_prefetch_stats(s);
+        fprintf(out, "\"%s\",%d,%d,%s,%s,%d,%d,%s,%s,%d,%d,%s,%s,\"%s\",%s,%d,"
+                     "%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%s,%.2f,%.2f,"
+                     "%s,%d,%llu,%llu,%llu,%s,%llu,%llu,%.3f\n",
+                job->label,
+                c->L1.size, c->L1.associativity, replacement_policy_name(c->L1.policy), prefetcher_name(c->L1.prefetch.type),
+                c->L2.size, c->L2.associativity, replacement_policy_name(c->L2.policy), prefetcher_name(c->L2.prefetch.type),
+                c->L3.size, c->L3.associativity, replacement_policy_name(c->L3.policy), prefetcher_name(c->L3.prefetch.type),
+                c->dram.mapping, write_policy_name(c->write.policy), c->write.allocate,
+                s->total_commands, s->hits, s->misses, s->cycles,
+                s->hit_L1, s->hit_L2, s->hit_L3, s->misses_L1, s->misses_L2, s->misses_L3,
+                s->stores, s->dram_reads, s->dram_writes, p.issued, p.useful, p.late,
+                core_model_name(c->core.model), average_latency(s), achieved_mlp(s),
+                inclusion_policy_name(c->inclusion.policy), c->inclusion.victim_entries, s->victim_hits,
+                s->back_invalidations, job->effective_capacity, page_label(c), s->tlb.walks, s->tlb.busy_cycles,
+                job->seconds);
+    }
+}
+
+static void write_json_level(FILE* out, const char* name, const CacheConfig* level, const PrefetchStats* prefetch) {
+    fprintf(out, "\"%s\": {\"size\": %d, \"line\": %d, \"assoc\": %d, \"latency\": %d, \"policy\": \"%s\", "
+                 "\"prefetch\": \"%s\", \"prefetch_degree\": %d, \"prefetch_issued\": %llu, \"prefetch_useful\": %llu, "
+                 "\"prefetch_late\": %llu, \"prefetch_pollution\": %llu}, ",
+            name, level->size, level->line_size, level->associativity, level->latency,
+            replacement_policy_name(level->policy), prefetcher_name(level->prefetch.type), level->prefetch.degree,
+            prefetch->issued, prefetch->useful, prefetch->late, prefetch->pollution);
+}
+
+static void write_json(const SweepJob* jobs, int num_jobs, FILE* out) {
+    fprintf(out, "[\n");
+    for (int i = 0; i < num_jobs; i++) {
+        const SweepJob* job = &jobs[i];
+        const CacheStats* s = &job->stats;
+        fprintf(out, "  {\"settings\": \"%s\", ", job->label);
+        write_json_level(out, "l1", &job->config.L1, &s->prefetch[0]);
+        write_json_level(out, "l2", &job->config.L2, &s->prefetch[1]);
+        write_json_level(out, "l3", &job->config.L3, &s->prefetch[2]);
+        fprintf(out, "\"dram_mapping\": \"%s\", ", job->config.dram.mapping);
+        fprintf(out, "\"write_policy\": \"%s\", \"write_allocate\": %d, ",
+                write_policy_name(job->config.write.policy), job->config.write.allocate);
+        fprintf(out, "\"accesses\": %llu, \"hits\": %llu, \"misses\": %llu, \"cycles\": %llu, "
+                     "\"hit_l1\": %llu, \"hit_l2\": %llu, \"hit_l3\": %llu, "
+                     "\"misses_l1\": %llu, \"misses_l2\": %llu, \"misses_l3\": %llu, "
+                     "\"stores\": %llu, \"dram_reads\": %llu, \"dram_writes\": %llu, "
+                     "\"core_model\": \"%s\", \"amat\": %.2f, \"mlp\": %.2f, "
+                     "\"inclusion\": \"%s\", \"victim_entries\": %d, \"victim_hits\": %llu, "
+                     "\"back_invalidations\": %llu, \"effective_capacity\": %llu, "
+                     "\"tlb_page\": \"%s\", \"tlb_walks\": %llu, \"translation_cycles\": %llu, \"seconds\": %.3f}%s\n",
+                s->total_commands, s->hits, s->misses, s->cycles,
+                s->hit_L1, s->hit_L2, s->hit_L3, s->misses_L1, s->misses_L2, s->misses_L3,
+                s->stores, s->dram_reads, s->dram_writes,
+                core_model_name(job->config.core.model), average_latency(s), achieved_mlp(s),
+                inclusion_policy_name(job->config.inclusion.policy), job->config.inclusion.victim_entries,
+                s->victim_hits, s->back_invalidations, job->effective_capacity,
+                page_label(&job->config), s->tlb.walks, s->tlb.busy_cycles, job->seconds, i + 1 < num_jobs ? "," : "");
+    }
+    fprintf(out, "]\n");
+}
+
+// Writes JSON when the file name ends in .json, CSV otherwise ("-" is stdout).
+int write_sweep_results(const SweepJob* jobs, int num_jobs, const char* filename) {
+    FILE* out = strcmp(filename, "-") == 0 ? stdout : fopen(filename, "w");
+    if (out == NULL) {
+        perror("Error opening output file");
+        return 0;
+    }
+    size_t length = strlen(filename);
+    if (length >= 5 && strcmp(filename + length - 5, ".json") == 0) {
+        write_json(jobs, num_jobs, out);
+    } else {
+        write_csv(jobs, num_jobs, out);
+    }
+    if (out != stdout) {
+        fclose(out);
+    }
+    return 1;
+}
@@ -0,0 +1,22 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include "sim_config.h"
+
+#define MAX_SWEEP_LABEL 256
+
+// One configuration of a design-space sweep and, once run, its results
+typedef struct {
+    char label[MAX_SWEEP_LABEL]; // The settings line that produced it
+    SimConfig config;
+    CacheStats stats;
+    unsigned long long effective_capacity; // Bytes of distinct lines held at the end
+    double seconds;
+} SweepJob;
+
+int load_sweep_jobs(const char* filename, const SimConfig* base, SweepJob** jobs);
+void run_sweep(SweepJob* jobs, int num_jobs, const address_t* addresses, const unsigned char* types,
+               long long num_addresses, int num_threads);
+int write_sweep_results(const SweepJob* jobs, int num_jobs, const char* filename);
+
+#endif // SWEEP_H
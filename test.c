@@ -1,42 +1,708 @@
 #define _CRT_SECURE_NO_WARNINGS
 #include "dram_simulation.h" // Include the new header file for dram_simulation.c
 #include "extract_address_trace.h" // Include the new header file for extract_address_trace.c
+#include "trace_stream.h" // Streaming trace ingestion
+#include "binary_trace.h" // Pre-converted binary traces
+#include "miss_ratio_curve.h" // Single-pass miss-ratio curves
+#include "parallel_parse.h" // Multi-threaded trace decoding
 #include <stdio.h>
 #include <stdint.h> // for uint32_t
 #include <stdlib.h> // for malloc and free
+#include <string.h>
 #include "cache_simulation.h" // Include the new header file for cache_simulation.h
+#include "sim_config.h" // Cache geometry from the command line or a config file
+#include "sweep.h" // Multi-threaded design-space sweeps
+#include "simulator.h" // Self-contained simulator instances
+#include "dram_scheduler.h" // Memory-controller request scheduling
+#include "multicore.h" // Private L1/L2 per core, shared L3, coherence
+#include "interval_stats.h" // Per-interval time series and phases
+#include "workload.h" // Synthetic address streams
+#include "benchmark.h" // Simulator throughput against a baseline
+#include "checkpoint.h" // Snapshots of the whole simulator for warm starts
+#include "sampling.h" // Approximate runs with confidence intervals
+#include <time.h>
+#include <ctype.h>
 
 
-int main() {
-    
-    unsigned int* addresses;
-    int num_addresses = extract_addresses_from_file("linpack_val.txt", &addresses);
+// Process each chunk of addresses through the cache simulation while
+// the parser thread reads ahead
+void simulate_chunk(void* context, const address_t* addresses, const unsigned char* types, int num_addresses) {
+    simulator_step_batch((Simulator*)context, addresses, types, num_addresses);
+}
+
+// Positions in the trace, counted in accesses, that split a run into
+// what a restored checkpoint already covered, a fast-forward that only
+// warms the caches, and detailed simulation up to an optional stop
+typedef struct {
+    Simulator* simulator;
+    long long position;   // Accesses seen so far
+    long long skip;       // Accesses before this were simulated before the checkpoint
+    long long warm_until; // Accesses before this only warm the caches
+    long long stop_at;    // Accesses from here on are ignored (-1 = none)
+} ReplayWindow;
+
+void simulate_window_chunk(void* context, const address_t* addresses, const unsigned char* types, int num_addresses) {
+    ReplayWindow* window = (ReplayWindow*)context;
+    long long start = window->position;
+    long long end = start + num_addresses;
+    window->position = end;
+    if (window->stop_at >= 0 && window->stop_at < end) {
+        end = window->stop_at;
+    }
+    long long warm_from = window->skip > start ? window->skip : start;
+    long long warm_to = window->warm_until < end ? window->warm_until : end;
+    if (warm_to > warm_from) {
+        simulator_warm_batch(window->simulator, addresses + (warm_from - start), types + (warm_from - start),
+                             (int)(warm_to - warm_from));
+    }
+    long long from = window->warm_until > warm_from ? window->warm_until : warm_from;
+    if (end > from) {
+        simulator_step_batch(window->simulator, addresses + (from - start), types + (from - start), (int)(end - from));
+    }
+}
+
+void record_mrc_chunk(void* context, const address_t* addresses, const unsigned char* types, int num_addresses) {
+    (void)types;
+    MissRatioCurve* mrc = (MissRatioCurve*)context;
+    for (int i = 0; i < num_addresses; i++) {
+        record_mrc_access(mrc, addresses[i]);
+    }
+}
+
+// One pass over the trace gives the miss ratio of every cache size and
+// associativity, instead of one simulation per configuration
+int run_miss_ratio_curve(const char* trace_file, int parse_threads, const SimConfig* config,
+                         int max_set_bits, const char* output_file) {
+    MissRatioCurve* mrc = create_miss_ratio_curve(config->L1.line_size, max_set_bits);
+    long long total_addresses = replay_trace(trace_file, parse_threads, record_mrc_chunk, mrc);
+    if (total_addresses == 0) {
+        printf("No addresses extracted. Exiting.\n");
+        free_miss_ratio_curve(mrc);
+        return 1;
+    }
+    FILE* out = strcmp(output_file, "-") == 0 ? stdout : fopen(output_file, "w");
+    if (out == NULL) {
+        perror("Error opening output file");
+        free_miss_ratio_curve(mrc);
+        return 1;
+    }
+    print_miss_ratio_curve(mrc, out);
+    if (out != stdout) {
+        fclose(out);
+    }
+    free_miss_ratio_curve(mrc);
+    return 0;
+}
+
+// Loads the trace once and runs every configuration of the sweep file
+// against it on a pool of threads
+int run_design_sweep(const char* trace_file, int parse_threads, const SimConfig* config,
+                     const char* sweep_file, int sweep_threads, const char* output_file) {
+    SweepJob* jobs;
+    int num_jobs = load_sweep_jobs(sweep_file, config, &jobs);
+    if (num_jobs < 0) {
+        return 1;
+    }
+    address_t* addresses;
+    unsigned char* types;
+    long long num_addresses = load_trace(trace_file, parse_threads, &addresses, &types);
     if (num_addresses == 0) {
         printf("No addresses extracted. Exiting.\n");
+        free(addresses);
+        free(types);
+        free(jobs);
+        return 1;
+    }
+    run_sweep(jobs, num_jobs, addresses, types, num_addresses, sweep_threads);
+    int ok = write_sweep_results(jobs, num_jobs, output_file);
+    free(addresses);
+    free(types);
+    free(jobs);
+    return ok ? 0 : 1;
+}
+
+// Runs the trace through the caches once, recording the DRAM request
+// stream, then replays that stream through the memory controller under
+// each scheduling policy (or just the one named)
+int record_dram_requests(const char* trace_file, int parse_threads, const SimConfig* config, DramRequestLog* log) {
+    // Recorded with serial timing; the controller supplies the overlap
+    SimConfig serial = *config;
+    serial.core.model = CORE_SERIAL;
+    init_dram_request_log(log);
+    Simulator* simulator = create_simulator(&serial);
+    simulator->hierarchy.dram_log = log;
+    long long total_addresses = replay_trace(trace_file, parse_threads, simulate_chunk, simulator);
+    destroy_simulator(simulator);
+    if (total_addresses == 0) {
+        printf("No addresses extracted. Exiting.\n");
+        free_dram_request_log(log);
+        return 0;
+    }
+    printf("%zu DRAM requests over %lld cycles of cache activity\n", log->count,
+           log->count > 0 ? log->requests[log->count - 1].arrival : 0LL);
+    return 1;
+}
+
+int run_dram_scheduling(const char* trace_file, int parse_threads, const SimConfig* config, const char* policy_name) {
+    SchedulerPolicy only = SCHED_FCFS;
+    int all = strcmp(policy_name, "all") == 0;
+    if (!all && !parse_scheduler_policy(policy_name, &only)) {
+        fprintf(stderr, "Unknown scheduler \"%s\" (fcfs, frfcfs, batch, all)\n", policy_name);
+        return 1;
+    }
+    DramRequestLog log;
+    if (!record_dram_requests(trace_file, parse_threads, config, &log)) {
+        return 1;
+    }
+    for (int policy = SCHED_FCFS; policy <= SCHED_BATCH; policy++) {
+        if (!all && policy != (int)only) {
+            continue;
+        }
+        DramScheduler* scheduler = create_dram_scheduler(&config->dram, (SchedulerPolicy)policy, SCHEDULER_BATCH_CAP);
+        run_dram_schedule(scheduler, log.requests, log.count);
+        print_scheduler_stats(scheduler, stdout);
+        destroy_dram_scheduler(scheduler);
+    }
+    free_dram_request_log(&log);
+    return 0;
+}
+
+// The DRAM request stream does not depend on the mapping, so it is
+// recorded once and replayed (FR-FCFS) under each mapping. mappings holds
+// names or specs separated by ';', where "all" stands for every built-in one
+int run_mapping_comparison(const char* trace_file, int parse_threads, const SimConfig* config, const char* mappings) {
+    char list[1024] = "";
+    char requested[1024];
+    strncpy(requested, mappings, sizeof(requested) - 1);
+    requested[sizeof(requested) - 1] = '\0';
+    for (char* name = strtok(requested, ";"); name != NULL; name = strtok(NULL, ";")) {
+        for (int i = 0; strcmp(name, "all") == 0 ? builtin_mapping_name(i) != NULL : i == 0; i++) {
+            const char* spec = strcmp(name, "all") == 0 ? builtin_mapping_name(i) : name;
+            if (strlen(list) + strlen(spec) + 2 > sizeof(list)) {
+                fprintf(stderr, "Too many DRAM mappings\n");
+                return 1;
+            }
+            strcat(list, *list ? ";" : "");
+            strcat(list, spec);
+        }
+    }
+    // Check every mapping before spending time on the trace
+    SimConfig mapped = *config;
+    for (char* spec = list; spec != NULL; spec = strchr(spec, ';') ? strchr(spec, ';') + 1 : NULL) {
+        size_t length = strcspn(spec, ";");
+        if (length >= sizeof(mapped.dram.mapping)) {
+            fprintf(stderr, "DRAM mapping too long\n");
+            return 1;
+        }
+        memcpy(mapped.dram.mapping, spec, length);
+        mapped.dram.mapping[length] = '\0';
+        if (!validate_dram_config(&mapped.dram)) {
+            return 1;
+        }
+    }
+
+    DramRequestLog log;
+    if (!record_dram_requests(trace_file, parse_threads, config, &log)) {
+        return 1;
+    }
+    for (char* spec = strtok(list, ";"); spec != NULL; spec = strtok(NULL, ";")) {
+        strcpy(mapped.dram.mapping, spec);
+        DramScheduler* scheduler = create_dram_scheduler(&mapped.dram, SCHED_FR_FCFS, SCHEDULER_BATCH_CAP);
+        run_dram_schedule(scheduler, log.requests, log.count);
+        print_mapping_stats(scheduler, stdout);
+        destroy_dram_scheduler(scheduler);
+    }
+    free_dram_request_log(&log);
+    return 0;
+}
+
+// Replays the recorded DRAM request stream (FR-FCFS) under every
+// row-buffer management policy
+int run_page_policy_comparison(const char* trace_file, int parse_threads, const SimConfig* config) {
+    DramRequestLog log;
+    if (!record_dram_requests(trace_file, parse_threads, config, &log)) {
         return 1;
     }
+    double open_latency = 0.0;
+    for (int policy = PAGE_OPEN; policy <= PAGE_ADAPTIVE; policy++) {
+        DramConfig dram = config->dram;
+        dram.page_policy = (PagePolicy)policy;
+        DramScheduler* scheduler = create_dram_scheduler(&dram, SCHED_FR_FCFS, SCHEDULER_BATCH_CAP);
+        run_dram_schedule(scheduler, log.requests, log.count);
+        if (policy == PAGE_OPEN && scheduler->stats.requests > 0) {
+            open_latency = (double)scheduler->stats.total_latency / (double)scheduler->stats.requests;
+        }
+        print_page_policy_stats(scheduler, open_latency, stdout);
+        destroy_dram_scheduler(scheduler);
+    }
+    free_dram_request_log(&log);
+    return 0;
+}
 
-    
-    CacheLine* L1 = initialize_cache(L1_SIZE);
-    CacheLine* L2 = initialize_cache(L2_SIZE);
-    CacheLine* L3 = initialize_cache(L3_SIZE);
+// Simulates the trace without translation, then with the configured TLBs
+// and allocator under each page size, to show what huge pages would save
+int run_page_size_comparison(const char* trace_file, int parse_threads, const SimConfig* config) {
+    SimConfig paged = *config;
+    paged.tlb.enabled = 1;
+    for (int size = PAGE_4K; size <= PAGE_1G; size++) {
+        paged.tlb.page_size = (PageSize)size;
+        if (!validate_tlb_config(&paged.tlb)) {
+            return 1;
+        }
+    }
+    printf("Page sizes: %d/%d-entry TLBs, %s frames from %d MB\n", config->tlb.l1_entries, config->tlb.l2_entries,
+           frame_allocator_name(config->tlb.allocator), config->tlb.memory_mb);
+    unsigned long long small_cycles = 0;
+    for (int size = -1; size <= PAGE_1G; size++) {
+        paged.tlb.enabled = size >= 0;
+        paged.tlb.page_size = size >= 0 ? (PageSize)size : PAGE_4K;
+        Simulator* simulator = create_simulator(&paged);
+        if (replay_trace(trace_file, parse_threads, simulate_chunk, simulator) == 0) {
+            printf("No addresses extracted. Exiting.\n");
+            destroy_simulator(simulator);
+            return 1;
+        }
+        const CacheStats* stats = simulator_stats(simulator);
+        const TlbStats* tlb = &stats->tlb;
+        if (size < 0) {
+            printf("  physical : %llu cycles\n", stats->cycles);
+            destroy_simulator(simulator);
+            continue;
+        }
+        double accesses = tlb->accesses > 0 ? (double)tlb->accesses : 1.0;
+        printf("  %-8s : %llu cycles, %llu walks (%.3f%% of accesses), %llu walk reads, %.2f%% of cycles translating",
+               page_size_name((PageSize)size), stats->cycles, tlb->walks, 100.0 * (double)tlb->walks / accesses,
+               tlb->walk_reads, stats->cycles > 0 ? 100.0 * (double)tlb->busy_cycles / (double)stats->cycles : 0.0);
+        if (size == PAGE_4K) {
+            small_cycles = stats->cycles;
+        } else if (small_cycles > 0) {
+            printf(", saves %.2f%% over 4k", 100.0 * ((double)small_cycles - (double)stats->cycles) / (double)small_cycles);
+        }
+        printf("\n");
+        destroy_simulator(simulator);
+    }
+    return 0;
+}
 
-   
+typedef struct {
+    Simulator* simulator;
+    IntervalRecorder* recorder;
+} IntervalRun;
 
-    // Process each address through the cache simulation
+void simulate_interval_chunk(void* context, const address_t* addresses, const unsigned char* types, int num_addresses) {
+    IntervalRun* run = (IntervalRun*)context;
     for (int i = 0; i < num_addresses; i++) {
-        full_cache_logic(L1, L2, L3, addresses[i]);
-        //print_index_and_tag(addresses[i],L1_SIZE,"L1");
+        simulator_step(run->simulator, addresses[i], types != NULL ? types[i] : ACCESS_LOAD);
+        record_interval_access(run->recorder, &run->simulator->hierarchy, addresses[i]);
+    }
+}
+
+// Simulates the trace once, snapshotting the counters every interval
+// accesses or cycles, then clusters the intervals into phases
+int run_intervals(const char* trace_file, int parse_threads, const SimConfig* config, unsigned long long interval,
+                  IntervalUnit unit, int phases, const char* output_file) {
+    IntervalRun run;
+    run.simulator = create_simulator(config);
+    run.recorder = create_interval_recorder(unit, interval, config->L3.line_size);
+    long long total_addresses = replay_trace(trace_file, parse_threads, simulate_interval_chunk, &run);
+    int ok = total_addresses > 0;
+    if (!ok) {
+        printf("No addresses extracted. Exiting.\n");
+    } else {
+        finish_intervals(run.recorder, &run.simulator->hierarchy);
+        cluster_phases(run.recorder, phases);
+        ok = write_intervals(run.recorder, output_file);
+        if (ok) {
+            print_phase_summary(run.recorder, &run.simulator->hierarchy, strcmp(output_file, "-") == 0 ? stderr : stdout);
+        }
+    }
+    free_interval_recorder(run.recorder);
+    destroy_simulator(run.simulator);
+    return ok ? 0 : 1;
+}
+
+// Runs a system of cores over one trace each. cores is either a number of
+// copies of trace_file, each relocated into its own address space, or a
+// comma-separated list of trace files sharing one address space. With
+// scaling set, the same traces run on 1, 2, 4, ... cores up to all of them.
+int run_multicore_traces(const char* trace_file, const char* cores, int parse_threads, const SimConfig* config,
+                         unsigned long long quantum, int scaling) {
+    const char* files[MAX_CORES];
+    char list[1024];
+    int num_traces = 0;
+    int copies = -1; // Set when cores is a count rather than a list of traces
+    char* end;
+    long requested = isdigit((unsigned char)cores[0]) ? strtol(cores, &end, 10) : 0;
+    if (isdigit((unsigned char)cores[0]) && *end == '\0') {
+        copies = requested > MAX_CORES ? MAX_CORES + 1 : (int)requested;
+        num_traces = 1;
+        files[0] = trace_file;
+    } else {
+        strncpy(list, cores, sizeof(list) - 1);
+        list[sizeof(list) - 1] = '\0';
+        for (char* name = strtok(list, ","); name != NULL; name = strtok(NULL, ",")) {
+            if (num_traces == MAX_CORES) {
+                fprintf(stderr, "At most %d traces can be run\n", MAX_CORES);
+                return 1;
+            }
+            files[num_traces++] = name;
+        }
+    }
+    int num_cores = copies >= 0 ? copies : num_traces;
+    if (!validate_multicore_config(config, num_cores)) {
+        return 1;
+    }
+
+    address_t* addresses[MAX_CORES];
+    unsigned char* types[MAX_CORES];
+    long long lengths[MAX_CORES];
+    int loaded = 0;
+    int ok = 1;
+    for (; loaded < num_traces && ok; loaded++) {
+        lengths[loaded] = load_trace(files[loaded], parse_threads, &addresses[loaded], &types[loaded]);
+        if (lengths[loaded] == 0) {
+            printf("No addresses extracted from %s. Exiting.\n", files[loaded]);
+            ok = 0;
+        }
+    }
+
+    for (int count = scaling ? 1 : num_cores; ok && count <= num_cores; count = count == num_cores ? count + 1 : count * 2 > num_cores ? num_cores : count * 2) {
+        MulticoreSystem* system = create_multicore(config, count);
+        for (int core = 0; core < count; core++) {
+            int trace = copies >= 0 ? 0 : core;
+            address_t relocation = copies >= 0 ? (address_t)core << (ADDRESS_BITS - 6) : 0;
+            attach_core_trace(system, core, addresses[trace], types[trace], lengths[trace], relocation);
+        }
+        run_multicore(system, quantum);
+        if (scaling) {
+            print_multicore_summary(system, stdout, count == 1);
+        } else {
+            print_multicore_results(system, stdout);
+        }
+        destroy_multicore(system);
+    }
+    for (int i = 0; i < loaded; i++) {
+        free(addresses[i]);
+        free(types[i]);
+    }
+    return ok ? 0 : 1;
+}
+
+static double wall_seconds(void) {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+// Estimates hit rate and cycles from a sample of the trace. With check the
+// full simulation runs too, to show the actual error and the speedup.
+int run_sampled_simulation(const char* trace_file, int parse_threads, const SimConfig* config, const char* spec, int check) {
+    SampleConfig sample;
+    Sampler sampler;
+    if (!parse_sample_spec(spec, &sample)) {
+        return 1;
+    }
+    Simulator* simulator = create_simulator(config);
+    if (!init_sampler(&sampler, &sample, simulator)) {
+        destroy_simulator(simulator);
+        return 1;
+    }
+    double start = wall_seconds();
+    long long total_addresses = replay_trace(trace_file, parse_threads, sample_chunk, &sampler);
+    double sampled_seconds = wall_seconds() - start;
+    if (total_addresses == 0) {
+        printf("No addresses extracted. Exiting.\n");
+        destroy_simulator(simulator);
+        return 1;
+    }
+    finish_sampler(&sampler);
+
+    Simulator* full = NULL;
+    double full_seconds = 0.0;
+    if (check) {
+        full = create_simulator(config);
+        start = wall_seconds();
+        replay_trace(trace_file, parse_threads, simulate_chunk, full);
+        full_seconds = wall_seconds() - start;
+    }
+    print_sample_estimates(&sampler, full != NULL ? simulator_stats(full) : NULL);
+    printf("  Sampled run %.3f s", sampled_seconds);
+    if (full != NULL) {
+        printf(", full run %.3f s (%.1fx faster)", full_seconds, sampled_seconds > 0.0 ? full_seconds / sampled_seconds : 0.0);
+        destroy_simulator(full);
+    }
+    printf("\n");
+    destroy_simulator(simulator);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    // test --parse-bench <trace> compares the trace parsers
+    if (argc >= 3 && strcmp(argv[1], "--parse-bench") == 0) {
+        return benchmark_trace_parser(argv[2]) ? 0 : 1;
+    }
+    // test --convert <text trace> <binary trace> parses a trace once for later runs
+    if (argc >= 4 && strcmp(argv[1], "--convert") == 0) {
+        long long records = convert_trace_to_binary(argv[2], argv[3]);
+        if (records < 0) {
+            return 1;
+        }
+        printf("Wrote %lld records to %s\n", records, argv[3]);
+        return 0;
+    }
+
+    // test [--parse-threads N] [--config file] [--set key=value ...] [--print-config]
+    //      [--mrc output.csv|- [--mrc-set-bits N]]
+    //      [--sweep jobs.txt [--sweep-output results.csv|.json] [--sweep-threads N]]
+    //      [--dram-schedule fcfs|frfcfs|batch|all] [--compare-mappings all|spec;spec...]
+    //      [--compare-page-policies] [--compare-page-sizes]
+    //      [--cores N|trace,trace... [--quantum cycles] [--core-scaling]]
+    //      [--instrument output.csv|.json|- [--instrument-top N]]
+    //      [--intervals N [--interval-cycles] [--phases K] [--intervals-output file.csv|.json|-]]
+    //      [--workload name[,key=value...]]
+    //      [--warmup N] [--checkpoint file [--checkpoint-at N]] [--restore file]
+    //      [--sample time[,period=N,window=N,warm=N|all]|sets[,ratio=N,batch=N] [--sample-check]]
+    //      [--bench [--bench-accesses N] [--bench-save file.csv] [--bench-baseline file.csv]
+    //       [--bench-tolerance percent]] [trace]
+    const char* trace_file = "linpack_val.txt";
+    const char* mrc_output = NULL;
+    const char* sweep_file = NULL;
+    const char* sweep_output = "-";
+    const char* dram_schedule = NULL;
+    const char* compare_mappings = NULL;
+    int compare_page_policies = 0;
+    int compare_page_sizes = 0;
+    const char* cores = NULL;
+    unsigned long long quantum = DEFAULT_QUANTUM;
+    int core_scaling = 0;
+    const char* instrument_output = NULL;
+    int instrument_top = INSTRUMENT_TOP_LINES;
+    unsigned long long interval = 0;
+    IntervalUnit interval_unit = INTERVAL_ACCESSES;
+    int phases = DEFAULT_PHASES;
+    const char* intervals_output = "-";
+    const char* workload_spec = NULL;
+    const char* sample_spec = NULL;
+    int sample_check = 0;
+    long long warmup = 0;
+    const char* checkpoint_file = NULL;
+    long long checkpoint_at = -1;
+    const char* restore_file = NULL;
+    int bench = 0;
+    long long bench_accesses = WORKLOAD_ACCESSES;
+    const char* bench_save = NULL;
+    const char* bench_baseline = NULL;
+    double bench_tolerance = BENCH_TOLERANCE;
+    int sweep_threads = default_parse_threads();
+    int mrc_set_bits = 16;
+    int parse_threads = 1;
+    int print_config = 0;
+    SimConfig config;
+    default_sim_config(&config);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+            if (!load_sim_config(&config, argv[++i])) {
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--set") == 0 && i + 1 < argc) {
+            if (!set_sim_option(&config, argv[++i])) {
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--print-config") == 0) {
+            print_config = 1;
+        } else if (strcmp(argv[i], "--mrc") == 0 && i + 1 < argc) {
+            mrc_output = argv[++i];
+        } else if (strcmp(argv[i], "--mrc-set-bits") == 0 && i + 1 < argc) {
+            char* end;
+            long bits = strtol(argv[++i], &end, 10);
+            if (end == argv[i] || *end != '\0' || bits < 0 || bits > MRC_MAX_SET_BITS) {
+                fprintf(stderr, "--mrc-set-bits must be 0 to %d\n", MRC_MAX_SET_BITS);
+                return 1;
+            }
+            mrc_set_bits = (int)bits;
+        } else if (strcmp(argv[i], "--sweep") == 0 && i + 1 < argc) {
+            sweep_file = argv[++i];
+        } else if (strcmp(argv[i], "--sweep-output") == 0 && i + 1 < argc) {
+            sweep_output = argv[++i];
+        } else if (strcmp(argv[i], "--sweep-threads") == 0 && i + 1 < argc) {
+            sweep_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--dram-schedule") == 0 && i + 1 < argc) {
+            dram_schedule = argv[++i];
+        } else if (strcmp(argv[i], "--compare-mappings") == 0 && i + 1 < argc) {
+            compare_mappings = argv[++i];
+        } else if (strcmp(argv[i], "--compare-page-policies") == 0) {
+            compare_page_policies = 1;
+        } else if (strcmp(argv[i], "--compare-page-sizes") == 0) {
+            compare_page_sizes = 1;
+        } else if (strcmp(argv[i], "--cores") == 0 && i + 1 < argc) {
+            cores = argv[++i];
+        } else if (strcmp(argv[i], "--quantum") == 0 && i + 1 < argc) {
+            quantum = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--core-scaling") == 0) {
+            core_scaling = 1;
+        } else if (strcmp(argv[i], "--instrument") == 0 && i + 1 < argc) {
+            instrument_output = argv[++i];
+        } else if (strcmp(argv[i], "--instrument-top") == 0 && i + 1 < argc) {
+            instrument_top = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--intervals") == 0 && i + 1 < argc) {
+            interval = strtoull(argv[++i], NULL, 0);
+            if (interval == 0) {
+                interval = DEFAULT_INTERVAL;
+            }
+        } else if (strcmp(argv[i], "--interval-cycles") == 0) {
+            interval_unit = INTERVAL_CYCLES;
+        } else if (strcmp(argv[i], "--phases") == 0 && i + 1 < argc) {
+            phases = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--intervals-output") == 0 && i + 1 < argc) {
+            intervals_output = argv[++i];
+        } else if (strcmp(argv[i], "--workload") == 0 && i + 1 < argc) {
+            workload_spec = argv[++i];
+        } else if (strcmp(argv[i], "--sample") == 0 && i + 1 < argc) {
+            sample_spec = argv[++i];
+        } else if (strcmp(argv[i], "--sample-check") == 0) {
+            sample_check = 1;
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            warmup = strtoll(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            checkpoint_file = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint-at") == 0 && i + 1 < argc) {
+            checkpoint_at = strtoll(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--restore") == 0 && i + 1 < argc) {
+            restore_file = argv[++i];
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            bench = 1;
+        } else if (strcmp(argv[i], "--bench-accesses") == 0 && i + 1 < argc) {
+            bench_accesses = strtoll(argv[++i], NULL, 0);
+            if (bench_accesses <= 0) {
+                bench_accesses = WORKLOAD_ACCESSES;
+            }
+        } else if (strcmp(argv[i], "--bench-save") == 0 && i + 1 < argc) {
+            bench_save = argv[++i];
+        } else if (strcmp(argv[i], "--bench-baseline") == 0 && i + 1 < argc) {
+            bench_baseline = argv[++i];
+        } else if (strcmp(argv[i], "--bench-tolerance") == 0 && i + 1 < argc) {
+            bench_tolerance = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--parse-threads") == 0 && i + 1 < argc) {
+            parse_threads = atoi(argv[++i]);
+            if (parse_threads <= 0) {
+                parse_threads = default_parse_threads();
+            }
+        } else {
+            trace_file = argv[i];
+        }
     }
-    
+    if (!validate_sim_config(&config)) {
+        return 1;
+    }
+    if (print_config) {
+        print_sim_config(&config);
+    }
+#ifndef INSTRUMENT
+    if (instrument_output != NULL) {
+        fprintf(stderr, "--instrument needs a build with -DINSTRUMENT\n");
+        return 1;
+    }
+    (void)instrument_top;
+#endif
+    if (bench) {
+        return run_benchmarks(&config, trace_file, bench_accesses, bench_baseline, bench_save, bench_tolerance);
+    }
+    if (mrc_output != NULL) {
+        return run_miss_ratio_curve(trace_file, parse_threads, &config, mrc_set_bits, mrc_output);
+    }
+    if (sweep_file != NULL) {
+        return run_design_sweep(trace_file, parse_threads, &config, sweep_file, sweep_threads, sweep_output);
+    }
+
+    if (compare_page_policies) {
+        return run_page_policy_comparison(trace_file, parse_threads, &config);
+    }
+    if (compare_page_sizes) {
+        return run_page_size_comparison(trace_file, parse_threads, &config);
+    }
+    if (compare_mappings != NULL) {
+        return run_mapping_comparison(trace_file, parse_threads, &config, compare_mappings);
+    }
+    if (dram_schedule != NULL) {
+        return run_dram_scheduling(trace_file, parse_threads, &config, dram_schedule);
+    }
+    if (interval > 0) {
+        return run_intervals(trace_file, parse_threads, &config, interval, interval_unit, phases, intervals_output);
+    }
+    if (cores != NULL) {
+        return run_multicore_traces(trace_file, cores, parse_threads, &config, quantum, core_scaling);
+    }
+    if (sample_spec != NULL) {
+        return run_sampled_simulation(trace_file, parse_threads, &config, sample_spec, sample_check);
+    }
+
+    ReplayWindow window = { NULL, 0, 0, 0, checkpoint_at };
+    if (restore_file != NULL) {
+        // The checkpoint carries its own configuration
+        window.simulator = load_checkpoint(restore_file, &window.skip);
+        if (window.simulator == NULL) {
+            return 1;
+        }
+        printf("Restored %s at access %lld\n", restore_file, window.skip);
+    } else {
+        window.simulator = create_simulator(&config);
+    }
+    Simulator* simulator = window.simulator;
+    window.warm_until = window.skip + warmup;
+    if (checkpoint_file != NULL && window.stop_at < 0 && warmup > 0) {
+        window.stop_at = window.warm_until;
+    }
+
+    long long total_addresses;
+    if (workload_spec != NULL) {
+        WorkloadConfig workload;
+        if (!parse_workload_spec(workload_spec, &workload)) {
+            destroy_simulator(simulator);
+            return 1;
+        }
+        address_t* addresses;
+        unsigned char* types;
+        total_addresses = generate_workload(&workload, &addresses, &types);
+        for (long long i = 0; i < total_addresses; i += TRACE_CHUNK_SIZE) {
+            int chunk = total_addresses - i < TRACE_CHUNK_SIZE ? (int)(total_addresses - i) : TRACE_CHUNK_SIZE;
+            simulate_window_chunk(&window, addresses + i, types + i, chunk);
+        }
+        free(addresses);
+        free(types);
+    } else {
+        total_addresses = replay_trace(trace_file, parse_threads, simulate_window_chunk, &window);
+    }
+
+    if (total_addresses == 0) {
+        printf("No addresses extracted. Exiting.\n");
+        destroy_simulator(simulator);
+        return 1;
+    }
+    if (window.skip > total_addresses) {
+        fprintf(stderr, "Warning: the checkpoint is at access %lld but the trace has only %lld\n",
+                window.skip, total_addresses);
+    }
+    if (checkpoint_file != NULL) {
+        long long offset = window.stop_at >= 0 && window.stop_at < total_addresses ? window.stop_at : total_addresses;
+        if (!save_checkpoint(simulator, offset, checkpoint_file)) {
+            destroy_simulator(simulator);
+            return 1;
+        }
+        printf("Checkpoint at access %lld written to %s\n", offset, checkpoint_file);
+    }
+
     // Print final simulation results
-    print_simulation_results();
+    print_simulation_results(&simulator->hierarchy);
+#ifdef INSTRUMENT
+    if (instrument_output != NULL &&
+        !write_instrumentation(simulator->hierarchy.instrument, &simulator->hierarchy.dram, instrument_output, instrument_top)) {
+        destroy_simulator(simulator);
+        return 1;
+    }
+#endif
 
     // Free the allocated memory
-    free(L1);
-    free(L2);
-    free(L3);
-    //free(addresses);
+    destroy_simulator(simulator);
 
     return 0;
 }
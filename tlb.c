@@ -0,0 +1,371 @@
+#include "tlb.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define PAGE_MAP_INITIAL 1024
+#define PAGE_MAP_LEAF 7 // Key tag of a page mapping; page-table nodes use their level 1-3
+
+static const char* page_size_names[] = { "4k", "2m", "1g" };
+static const int page_shifts[] = { 12, 21, 30 };
+static const char* allocator_names[] = { "identity", "sequential", "random" };
+
+const char* page_size_name(PageSize size) {
+    return page_size_names[size];
+}
+
+int parse_page_size(const char* name, PageSize* size) {
+    for (int i = 0; i < (int)(sizeof(page_size_names) / sizeof(page_size_names[0])); i++) {
+        if (strcmp(name, page_size_names[i]) == 0) {
+            *size = (PageSize)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+const char* frame_allocator_name(FrameAllocator allocator) {
+    return allocator_names[allocator];
+}
+
+int parse_frame_allocator(const char* name, FrameAllocator* allocator) {
+    for (int i = 0; i < (int)(sizeof(allocator_names) / sizeof(allocator_names[0])); i++) {
+        if (strcmp(name, allocator_names[i]) == 0) {
+            *allocator = (FrameAllocator)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void default_tlb_config(TlbConfig* config) {
+    config->enabled = 0;
+    config->page_size = PAGE_4K;
+    config->allocator = FRAMES_SEQUENTIAL;
+    config->l1_entries = TLB_L1_ENTRIES;
+    config->l1_assoc = TLB_L1_ASSOC;
+    config->l2_entries = TLB_L2_ENTRIES;
+    config->l2_assoc = TLB_L2_ASSOC;
+    config->l2_latency = TLB_L2_LATENCY;
+    config->memory_mb = TLB_MEMORY_MB;
+    config->seed = TLB_SEED;
+}
+
+static uint64_t memory_bytes(const TlbConfig* config) {
+    return (uint64_t)config->memory_mb << 20;
+}
+
+static int validate_level(int entries, int assoc, const char* name) {
+    if (entries < 1 || assoc < 1 || entries % assoc != 0) {
+        fprintf(stderr, "tlb: %s needs a positive entry count that is a multiple of its associativity\n", name);
+        return 0;
+    }
+    int sets = entries / assoc;
+    if ((sets & (sets - 1)) != 0) {
+        fprintf(stderr, "tlb: %s has %d sets, which is not a power of two\n", name, sets);
+        return 0;
+    }
+    return 1;
+}
+
+// Returns 1 if the translation stage can be simulated, otherwise prints why not.
+int validate_tlb_config(const TlbConfig* config) {
+    if (!validate_level(config->l1_entries, config->l1_assoc, "L1") ||
+        !validate_level(config->l2_entries, config->l2_assoc, "L2")) {
+        return 0;
+    }
+    if (config->l2_latency < 0) {
+        fprintf(stderr, "tlb: L2 latency cannot be negative\n");
+        return 0;
+    }
+    if (config->memory_mb < 1 || (sizeof(address_t) < 8 && config->memory_mb > 4096)) {
+        fprintf(stderr, "tlb: memory must be 1 to %d MB in this build\n", sizeof(address_t) < 8 ? 4096 : 0x7FFFFFFF);
+        return 0;
+    }
+    uint64_t memory = memory_bytes(config);
+    if ((memory - memory / PAGE_TABLE_SHARE) >> page_shifts[config->page_size] == 0) {
+        fprintf(stderr, "tlb: %d MB of memory holds no %s page\n", config->memory_mb, page_size_name(config->page_size));
+        return 0;
+    }
+    return 1;
+}
+
+static void* allocate_array(size_t count, size_t size) {
+    void* array = calloc(count, size);
+    if (array == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return array;
+}
+
+// splitmix64, as in workload.c
+static uint64_t next_random(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static size_t map_slot(const PageMap* map, uint64_t key) {
+    size_t mask = map->capacity - 1;
+    size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+    while (map->keys[slot] != 0 && map->keys[slot] != key) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// Rehashes the map into capacity slots, a power of two
+void resize_page_map(PageMap* map, size_t capacity) {
+    PageMap old = *map;
+    map->keys = (uint64_t*)allocate_array(capacity, sizeof(uint64_t));
+    map->values = (uint64_t*)allocate_array(capacity, sizeof(uint64_t));
+    map->capacity = capacity;
+    map->count = 0;
+    for (size_t i = 0; i < old.capacity; i++) {
+        if (old.keys[i] != 0) {
+            size_t slot = map_slot(map, old.keys[i]);
+            map->keys[slot] = old.keys[i];
+            map->values[slot] = old.values[i];
+            map->count++;
+        }
+    }
+    free(old.keys);
+    free(old.values);
+}
+
+// The value stored under key; *added is set when the key was new and the
+// caller has to fill it in
+static uint64_t* map_entry(PageMap* map, uint64_t key, int* added) {
+    if ((map->count + 1) * 2 > map->capacity) {
+        resize_page_map(map, map->capacity * 2);
+    }
+    size_t slot = map_slot(map, key);
+    *added = map->keys[slot] == 0;
+    if (*added) {
+        map->keys[slot] = key;
+        map->count++;
+    }
+    return &map->values[slot];
+}
+
+static void init_level(TlbLevel* level, int entries, int ways) {
+    level->entries = entries;
+    level->ways = ways;
+    level->sets = entries / ways;
+    level->pages = (uint64_t*)allocate_array((size_t)entries, sizeof(uint64_t));
+    level->frames = (uint64_t*)allocate_array((size_t)entries, sizeof(uint64_t));
+    level->used = (unsigned long long*)allocate_array((size_t)entries, sizeof(unsigned long long));
+}
+
+static void free_level(TlbLevel* level) {
+    free(level->pages);
+    free(level->frames);
+    free(level->used);
+}
+
+// Physical memory is split in two: data frames from address 0, and the
+// page-table area in the top 1/PAGE_TABLE_SHARE, where nodes are handed
+// out in the order walks first need them. The root node is the first.
+Tlb* create_tlb(const TlbConfig* config) {
+    Tlb* tlb = (Tlb*)allocate_array(1, sizeof(Tlb));
+    uint64_t memory = memory_bytes(config);
+    tlb->config = *config;
+    tlb->page_shift = page_shifts[config->page_size];
+    tlb->leaf_level = PAGE_TABLE_LEVELS - 1 - (int)config->page_size;
+    init_level(&tlb->l1, config->l1_entries, config->l1_assoc);
+    init_level(&tlb->l2, config->l2_entries, config->l2_assoc);
+    resize_page_map(&tlb->map, PAGE_MAP_INITIAL);
+    tlb->table_base = memory - memory / PAGE_TABLE_SHARE;
+    tlb->root = tlb->table_base;
+    tlb->table_next = tlb->table_base + PAGE_TABLE_NODE;
+    tlb->num_frames = tlb->table_base >> tlb->page_shift;
+    if (config->allocator == FRAMES_RANDOM) {
+        tlb->frame_used = (uint8_t*)allocate_array((size_t)(tlb->num_frames / 8 + 1), 1);
+    }
+    tlb->rng = (uint64_t)config->seed;
+    return tlb;
+}
+
+void destroy_tlb(Tlb* tlb) {
+    if (tlb == NULL) {
+        return;
+    }
+    free_level(&tlb->l1);
+    free_level(&tlb->l2);
+    free(tlb->map.keys);
+    free(tlb->map.values);
+    free(tlb->frame_used);
+    free(tlb);
+}
+
+static int tlb_find(const TlbLevel* level, uint64_t page) {
+    int first = (int)(page & (uint64_t)(level->sets - 1)) * level->ways;
+    for (int way = 0; way < level->ways; way++) {
+        if (level->pages[first + way] == page + 1) {
+            return first + way;
+        }
+    }
+    return -1;
+}
+
+// Fills the empty or least recently used way of the page's set
+static void tlb_insert(TlbLevel* level, uint64_t page, uint64_t frame, unsigned long long stamp) {
+    int first = (int)(page & (uint64_t)(level->sets - 1)) * level->ways;
+    int victim = first;
+    for (int way = 0; way < level->ways; way++) {
+        int slot = first + way;
+        if (level->pages[slot] == 0) {
+            victim = slot;
+            break;
+        }
+        if (level->used[slot] < level->used[victim]) {
+            victim = slot;
+        }
+    }
+    level->pages[victim] = page + 1;
+    level->frames[victim] = frame;
+    level->used[victim] = stamp;
+}
+
+static uint64_t allocate_frame(Tlb* tlb, uint64_t page) {
+    uint64_t frame;
+    switch (tlb->config.allocator) {
+    case FRAMES_IDENTITY:
+        return page;
+    case FRAMES_SEQUENTIAL:
+        frame = tlb->next_frame++ % tlb->num_frames;
+        break;
+    default:
+        frame = next_random(&tlb->rng) % tlb->num_frames;
+        if (tlb->pages_mapped < tlb->num_frames) {
+            // Probe for a free frame; one is left, so this ends
+            while ((tlb->frame_used[frame / 8] >> (frame % 8)) & 1) {
+                frame = (frame + 1) % tlb->num_frames;
+            }
+            tlb->frame_used[frame / 8] |= (uint8_t)(1 << (frame % 8));
+        }
+        break;
+    }
+    if (tlb->pages_mapped >= tlb->num_frames) {
+        tlb->overcommitted++;
+    }
+    return frame;
+}
+
+// Node of the given level (1 to 3) on the path to address; its key is
+// the level and the address bits above the ones the node indexes
+static uint64_t table_node(Tlb* tlb, uint64_t address, int level) {
+    int shift = 12 + PAGE_TABLE_BITS * (PAGE_TABLE_LEVELS - level);
+    int added;
+    uint64_t* node = map_entry(&tlb->map, ((address >> shift) << 3) | (uint64_t)level, &added);
+    if (added) {
+        if (tlb->table_next + PAGE_TABLE_NODE > memory_bytes(&tlb->config)) {
+            // The area is full: later nodes share memory with earlier ones
+            tlb->table_next = tlb->table_base + PAGE_TABLE_NODE;
+            tlb->overcommitted++;
+        }
+        *node = tlb->table_next;
+        tlb->table_next += PAGE_TABLE_NODE;
+    }
+    return *node;
+}
+
+// Walks the radix tree from the root to the level that maps the page,
+// creating missing nodes and the mapping itself on first touch. Returns
+// the frame; the entries read go into translation->walk.
+static uint64_t walk_page_table(Tlb* tlb, uint64_t address, Translation* translation) {
+    uint64_t node = tlb->root;
+    for (int level = 0; level <= tlb->leaf_level; level++) {
+        if (level > 0) {
+            node = table_node(tlb, address, level);
+        }
+        int shift = 12 + PAGE_TABLE_BITS * (PAGE_TABLE_LEVELS - 1 - level);
+        uint64_t index = (address >> shift) & ((1u << PAGE_TABLE_BITS) - 1);
+        translation->walk[level] = (address_t)(node + index * PTE_SIZE);
+    }
+    translation->steps = tlb->leaf_level + 1;
+
+    uint64_t page = address >> tlb->page_shift;
+    int added;
+    uint64_t* frame = map_entry(&tlb->map, (page << 3) | PAGE_MAP_LEAF, &added);
+    if (added) {
+        *frame = allocate_frame(tlb, page);
+        tlb->pages_mapped++;
+    }
+    return *frame;
+}
+
+// Translates one access through the L1 and L2 TLBs, walking the page
+// table when both miss. The caller charges the L2 lookup and reads the
+// walk's entries. stats may be NULL, e.g. when warming.
+void translate(Tlb* tlb, address_t address, Translation* translation, TlbStats* stats) {
+    uint64_t virtual_address = (uint64_t)address;
+    uint64_t page = virtual_address >> tlb->page_shift;
+    unsigned long long stamp = ++tlb->clock;
+    uint64_t frame;
+    int slot = tlb_find(&tlb->l1, page);
+    translation->steps = 0;
+    if (slot >= 0) {
+        translation->level = 0;
+        frame = tlb->l1.frames[slot];
+        tlb->l1.used[slot] = stamp;
+    } else if ((slot = tlb_find(&tlb->l2, page)) >= 0) {
+        translation->level = 1;
+        frame = tlb->l2.frames[slot];
+        tlb->l2.used[slot] = stamp;
+        tlb_insert(&tlb->l1, page, frame, stamp);
+    } else {
+        translation->level = 2;
+        frame = walk_page_table(tlb, virtual_address, translation);
+        tlb_insert(&tlb->l2, page, frame, stamp);
+        tlb_insert(&tlb->l1, page, frame, stamp);
+    }
+    uint64_t offset = virtual_address & ((1ULL << tlb->page_shift) - 1);
+    translation->physical = (address_t)((frame << tlb->page_shift) | offset);
+    if (stats != NULL) {
+        stats->accesses++;
+        if (translation->level == 0) {
+            stats->l1_hits++;
+        } else if (translation->level == 1) {
+            stats->l2_hits++;
+        } else {
+            stats->walks++;
+        }
+    }
+}
+
+// Counts one translation that ran from start to done. Translations start
+// in dispatch order, so the busy time is the union of [start, done) grown
+// from its end; it never exceeds the run's cycles, even when out-of-order
+// accesses translate at the same time.
+void record_translation(Tlb* tlb, TlbStats* stats, unsigned long long start, unsigned long long done) {
+    stats->delay_cycles += done - start;
+    unsigned long long from = start > tlb->busy_until ? start : tlb->busy_until;
+    if (done > from) {
+        stats->busy_cycles += done - from;
+        tlb->busy_until = done;
+    }
+}
+
+static double percent(unsigned long long part, unsigned long long whole) {
+    return whole > 0 ? 100.0 * (double)part / (double)whole : 0.0;
+}
+
+// cycles is the run's total, to put the translation time in proportion
+void print_tlb_stats(const Tlb* tlb, const TlbStats* stats, unsigned long long cycles, FILE* out) {
+    fprintf(out, "  TLB : %s pages, %s frames, L1 Hits : %.2f%%, L2 Hits : %.2f%%, Walks : %llu (%.3f%% of accesses), "
+                 "%llu pages mapped",
+            page_size_name(tlb->config.page_size), frame_allocator_name(tlb->config.allocator),
+            percent(stats->l1_hits, stats->accesses), percent(stats->l2_hits, stats->accesses), stats->walks,
+            percent(stats->walks, stats->accesses), tlb->pages_mapped);
+    if (tlb->overcommitted > 0) {
+        fprintf(out, ", %llu overcommitted", tlb->overcommitted);
+    }
+    fprintf(out, "\n");
+    fprintf(out, "  Page Walks : %llu reads (L1 %llu, L2 %llu, L3 %llu, DRAM %llu), Translation Delay : %.2f cycles per access, "
+                 "Translating : %.2f%% of cycles\n",
+            stats->walk_reads, stats->walk_served[0], stats->walk_served[1], stats->walk_served[2], stats->walk_served[3],
+            stats->accesses > 0 ? (double)stats->delay_cycles / (double)stats->accesses : 0.0,
+            percent(stats->busy_cycles, cycles));
+}
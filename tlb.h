@@ -0,0 +1,123 @@
+#ifndef TLB_H
+#define TLB_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "address.h"
+
+// Default translation stage, used once tlb.enabled=1
+#define TLB_L1_ENTRIES 64
+#define TLB_L1_ASSOC 4
+#define TLB_L2_ENTRIES 1536
+#define TLB_L2_ASSOC 12
+#define TLB_L2_LATENCY 7     // Cycles an L1 TLB miss adds; L1 TLB hits overlap the L1 cache access
+#define TLB_MEMORY_MB 4096   // Physical memory the allocator hands frames out of
+#define TLB_SEED 1
+
+#define PAGE_TABLE_LEVELS 4  // x86-64 style radix tree, 9 index bits per level
+#define PAGE_TABLE_BITS 9
+#define PAGE_TABLE_NODE 4096 // Bytes per page-table node, 512 entries
+#define PTE_SIZE 8
+#define PAGE_TABLE_SHARE 64  // The top 1/64 of physical memory holds the page table
+
+typedef enum {
+    PAGE_4K, // Walks read all four levels
+    PAGE_2M, // The third level maps the page; three reads per walk
+    PAGE_1G  // The second level maps the page; two reads per walk
+} PageSize;
+
+typedef enum {
+    FRAMES_IDENTITY,   // Physical address = virtual address
+    FRAMES_SEQUENTIAL, // Frames handed out in first-touch order
+    FRAMES_RANDOM      // Frames scattered over physical memory, as after long uptime
+} FrameAllocator;
+
+typedef struct {
+    int enabled; // 0: trace addresses go to the caches as physical addresses
+    PageSize page_size;
+    FrameAllocator allocator;
+    int l1_entries;
+    int l1_assoc;
+    int l2_entries;
+    int l2_assoc;
+    int l2_latency;
+    int memory_mb;
+    int seed;    // Random allocator
+} TlbConfig;
+
+typedef struct {
+    unsigned long long accesses;
+    unsigned long long l1_hits;
+    unsigned long long l2_hits;
+    unsigned long long walks;
+    unsigned long long walk_reads;     // Page-table entries read
+    unsigned long long walk_served[4]; // Walk reads served by L1, L2, L3 and DRAM
+    unsigned long long delay_cycles;   // Per access, cycles from the lookup to the physical address, summed
+    unsigned long long busy_cycles;    // Cycles with at least one translation in progress
+} TlbStats;
+
+// One set-associative TLB level with LRU replacement. Entries hold the
+// virtual page number + 1 (0 = empty) and the frame it maps to.
+typedef struct {
+    int entries;
+    int ways;
+    int sets;
+    uint64_t* pages;
+    uint64_t* frames;
+    unsigned long long* used; // Recency stamps
+} TlbLevel;
+
+// Open-addressing hash from keys to physical addresses, holding both the
+// page-table nodes and the page mappings (see tlb.c)
+typedef struct {
+    uint64_t* keys; // 0 = empty slot
+    uint64_t* values;
+    size_t capacity; // Power of two
+    size_t count;
+} PageMap;
+
+// The translation stage: the TLBs, the page table they cache and the
+// allocator that backs it with frames
+typedef struct {
+    TlbConfig config;
+    int page_shift;
+    int leaf_level;        // Page-table level that maps a page
+    TlbLevel l1;
+    TlbLevel l2;
+    unsigned long long clock;
+    PageMap map;
+    uint64_t root;         // Physical address of the top-level node
+    uint64_t num_frames;   // Data frames below the page-table area
+    uint64_t next_frame;   // Sequential allocator
+    uint8_t* frame_used;   // Random allocator, one bit per frame
+    uint64_t table_base;   // Page-table area: nodes are carved out upwards
+    uint64_t table_next;
+    uint64_t rng;
+    unsigned long long pages_mapped;
+    unsigned long long overcommitted; // Pages mapped onto a frame already in use
+    unsigned long long busy_until;    // End of the latest translation
+} Tlb;
+
+// One translated access: the physical address, where it was found, and
+// the page-table entries a walk read, root first
+typedef struct {
+    address_t physical;
+    int level; // 0: L1 TLB hit, 1: L2 TLB hit, 2: page walk
+    int steps;
+    address_t walk[PAGE_TABLE_LEVELS];
+} Translation;
+
+const char* page_size_name(PageSize size);
+int parse_page_size(const char* name, PageSize* size);
+const char* frame_allocator_name(FrameAllocator allocator);
+int parse_frame_allocator(const char* name, FrameAllocator* allocator);
+void default_tlb_config(TlbConfig* config);
+int validate_tlb_config(const TlbConfig* config);
+Tlb* create_tlb(const TlbConfig* config);
+void destroy_tlb(Tlb* tlb);
+void resize_page_map(PageMap* map, size_t capacity);
+void translate(Tlb* tlb, address_t address, Translation* translation, TlbStats* stats);
+void record_translation(Tlb* tlb, TlbStats* stats, unsigned long long start, unsigned long long done);
+void print_tlb_stats(const Tlb* tlb, const TlbStats* stats, unsigned long long cycles, FILE* out);
+
+#endif // TLB_H
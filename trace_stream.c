@@ -0,0 +1,312 @@
+#include "trace_stream.h"
+#include <stdlib.h>
+#include <string.h>
+#include "parallel_parse.h"
+#include "binary_trace.h"
+
+// Waits for a free slot at the head of the ring. Returns NULL if the
+// simulator closed the stream.
+static TraceChunk* acquire_chunk(TraceStream *stream) {
+    pthread_mutex_lock(&stream->lock);
+    while (stream->filled == TRACE_RING_SIZE && !stream->stop) {
+        pthread_cond_wait(&stream->slot_free, &stream->lock);
+    }
+    TraceChunk *chunk = stream->stop ? NULL : &stream->ring[stream->head];
+    pthread_mutex_unlock(&stream->lock);
+    if (chunk != NULL) {
+        chunk->count = 0;
+    }
+    return chunk;
+}
+
+static void publish_chunk(TraceStream *stream) {
+    pthread_mutex_lock(&stream->lock);
+    stream->head = (stream->head + 1) % TRACE_RING_SIZE;
+    stream->filled++;
+    pthread_cond_signal(&stream->chunk_ready);
+    pthread_mutex_unlock(&stream->lock);
+}
+
+// Appends one access, handing the chunk over once it is full.
+static TraceChunk* append_access(TraceStream *stream, TraceChunk *chunk, const TraceAccess *access) {
+    chunk->addresses[chunk->count] = access->address;
+    chunk->types[chunk->count++] = access->type;
+    if (chunk->count == TRACE_CHUNK_SIZE) {
+        publish_chunk(stream);
+        chunk = acquire_chunk(stream);
+    }
+    return chunk;
+}
+
+static TraceChunk* parse_sequential(TraceStream *stream, TraceChunk *chunk) {
+    char line[MAX_LINE_LENGTH];
+    TraceOp op;
+    TraceAccess access;
+
+    while (chunk != NULL && fgets(line, sizeof(line), stream->file)) {
+        size_t length = strlen(line);
+        if (length > 0 && line[length - 1] == '\n') {
+            line[length - 1] = '\0';  // Remove newline character
+        }
+        decode_command(line, &op);
+        if (resolve_trace_line(&stream->resolver, &op, &access)) {
+            chunk = append_access(stream, chunk, &access);
+        }
+    }
+    return chunk;
+}
+
+// Reads the file in PARSE_BLOCK_SIZE blocks cut at line boundaries. Worker
+// threads decode each block (phase one), then the ops are resolved against
+// the register file in trace order here (phase two).
+static TraceChunk* parse_parallel(TraceStream *stream, TraceChunk *chunk) {
+    ParallelParser *parser = create_parallel_parser(stream->num_parse_threads);
+    char *block = (char *)malloc(PARSE_BLOCK_SIZE);
+    if (block == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t carried = 0;
+    TraceAccess access;
+
+    while (chunk != NULL) {
+        size_t length = carried + fread(block + carried, 1, PARSE_BLOCK_SIZE - carried, stream->file);
+        if (length == 0) {
+            break;
+        }
+        int at_end = length < PARSE_BLOCK_SIZE;
+        size_t usable = length;
+        if (!at_end) {
+            // Keep the trailing partial line for the next block
+            while (usable > 0 && block[usable - 1] != '\n') {
+                usable--;
+            }
+            if (usable == 0) {
+                usable = length;
+            }
+        }
+
+        decode_block(parser, block, usable);
+        for (int i = 0; i < parser->num_threads && chunk != NULL; i++) {
+            const ParseWorker *worker = &parser->workers[i];
+            for (size_t j = 0; j < worker->count && chunk != NULL; j++) {
+                if (resolve_trace_line(&stream->resolver, &worker->ops[j], &access)) {
+                    chunk = append_access(stream, chunk, &access);
+                }
+            }
+        }
+
+        carried = length - usable;
+        memmove(block, block + usable, carried);
+        if (at_end) {
+            break;
+        }
+    }
+
+    free(block);
+    destroy_parallel_parser(parser);
+    return chunk;
+}
+
+static void* parser_thread(void *arg) {
+    TraceStream *stream = (TraceStream *)arg;
+    TraceAccess access;
+
+    TraceChunk *chunk = acquire_chunk(stream);
+    if (stream->num_parse_threads > 1) {
+        chunk = parse_parallel(stream, chunk);
+    } else {
+        chunk = parse_sequential(stream, chunk);
+    }
+
+    if (chunk != NULL && flush_trace_resolver(&stream->resolver, &access)) {
+        chunk = append_access(stream, chunk, &access);
+    }
+    if (chunk != NULL && chunk->count > 0) {
+        publish_chunk(stream);
+    }
+
+    pthread_mutex_lock(&stream->lock);
+    stream->finished = 1;
+    pthread_cond_broadcast(&stream->chunk_ready);
+    pthread_mutex_unlock(&stream->lock);
+    return NULL;
+}
+
+TraceStream* open_trace_stream(const char *filename) {
+    return open_trace_stream_parallel(filename, 1);
+}
+
+// Same as open_trace_stream, but decodes lines on num_parse_threads
+// worker threads when it is above 1.
+TraceStream* open_trace_stream_parallel(const char *filename, int num_parse_threads) {
+    FILE *inputFile = fopen(filename, "r");
+    if (inputFile == NULL) {
+        perror("Error opening input file");
+        return NULL;
+    }
+
+    TraceStream *stream = (TraceStream *)malloc(sizeof(TraceStream));
+    if (stream == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    stream->file = inputFile;
+    init_trace_resolver(&stream->resolver);
+    stream->num_parse_threads = num_parse_threads;
+    stream->head = 0;
+    stream->tail = 0;
+    stream->filled = 0;
+    stream->holding = 0;
+    stream->finished = 0;
+    stream->stop = 0;
+    pthread_mutex_init(&stream->lock, NULL);
+    pthread_cond_init(&stream->chunk_ready, NULL);
+    pthread_cond_init(&stream->slot_free, NULL);
+
+    if (pthread_create(&stream->parser, NULL, parser_thread, stream) != 0) {
+        fprintf(stderr, "Failed to start trace parser thread\n");
+        pthread_mutex_destroy(&stream->lock);
+        pthread_cond_destroy(&stream->chunk_ready);
+        pthread_cond_destroy(&stream->slot_free);
+        fclose(inputFile);
+        free(stream);
+        return NULL;
+    }
+    return stream;
+}
+
+// Returns the next chunk of addresses and their access types, blocking
+// until the parser has one ready. The chunk stays valid until the next
+// call; 0 means end of trace.
+int next_trace_chunk(TraceStream *stream, const address_t **addresses, const unsigned char **types) {
+    pthread_mutex_lock(&stream->lock);
+    if (stream->holding) {
+        stream->tail = (stream->tail + 1) % TRACE_RING_SIZE;
+        stream->filled--;
+        stream->holding = 0;
+        pthread_cond_signal(&stream->slot_free);
+    }
+    while (stream->filled == 0 && !stream->finished) {
+        pthread_cond_wait(&stream->chunk_ready, &stream->lock);
+    }
+    int count = 0;
+    if (stream->filled > 0) {
+        stream->holding = 1;
+        *addresses = stream->ring[stream->tail].addresses;
+        *types = stream->ring[stream->tail].types;
+        count = stream->ring[stream->tail].count;
+    }
+    pthread_mutex_unlock(&stream->lock);
+    return count;
+}
+
+void close_trace_stream(TraceStream *stream) {
+    pthread_mutex_lock(&stream->lock);
+    stream->stop = 1;
+    pthread_cond_broadcast(&stream->slot_free);
+    pthread_mutex_unlock(&stream->lock);
+
+    pthread_join(stream->parser, NULL);
+    fclose(stream->file);
+    pthread_mutex_destroy(&stream->lock);
+    pthread_cond_destroy(&stream->chunk_ready);
+    pthread_cond_destroy(&stream->slot_free);
+    free(stream);
+}
+
+// Feeds every address of a text or binary trace to handler, in chunks of
+// at most TRACE_CHUNK_SIZE. Returns the number of addresses.
+long long replay_trace(const char *filename, int num_parse_threads, TraceHandler handler, void *context) {
+    long long total_addresses = 0;
+    if (is_binary_trace(filename)) {
+        BinaryTrace *trace = open_binary_trace(filename);
+        if (trace == NULL) {
+            return 0;
+        }
+        address_t *addresses = (address_t *)malloc(sizeof(address_t) * TRACE_CHUNK_SIZE);
+        unsigned char *types = (unsigned char *)malloc(TRACE_CHUNK_SIZE);
+        if (addresses == NULL || types == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        TraceAccess access;
+        int count = 0;
+        int status;
+        while ((status = next_binary_access(trace, &access)) > 0) {
+            addresses[count] = access.address;
+            types[count++] = access.type;
+            if (count == TRACE_CHUNK_SIZE) {
+                handler(context, addresses, types, count);
+                total_addresses += count;
+                count = 0;
+            }
+        }
+        if (count > 0 && status == 0) {
+            handler(context, addresses, types, count);
+            total_addresses += count;
+        }
+        free(addresses);
+        free(types);
+        close_binary_trace(trace);
+        // A damaged trace counts as no trace rather than a shorter one
+        return status < 0 ? 0 : total_addresses;
+    }
+
+    TraceStream *stream = open_trace_stream_parallel(filename, num_parse_threads);
+    if (stream == NULL) {
+        return 0;
+    }
+    const address_t *addresses;
+    const unsigned char *types;
+    int count;
+    while ((count = next_trace_chunk(stream, &addresses, &types)) > 0) {
+        handler(context, addresses, types, count);
+        total_addresses += count;
+    }
+    close_trace_stream(stream);
+    return total_addresses;
+}
+
+typedef struct {
+    address_t *addresses;
+    unsigned char *types; // Only collected when want_types is set
+    int want_types;
+    size_t count;
+    size_t capacity;
+} AddressArray;
+
+static void append_chunk(void *context, const address_t *addresses, const unsigned char *types, int count) {
+    AddressArray *array = (AddressArray *)context;
+    if (array->count + (size_t)count > array->capacity) {
+        while (array->count + (size_t)count > array->capacity) {
+            array->capacity = array->capacity ? array->capacity * 2 : TRACE_CHUNK_SIZE;
+        }
+        array->addresses = (address_t *)realloc(array->addresses, sizeof(address_t) * array->capacity);
+        if (array->want_types) {
+            array->types = (unsigned char *)realloc(array->types, array->capacity);
+        }
+        if (array->addresses == NULL || (array->want_types && array->types == NULL)) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    memcpy(array->addresses + array->count, addresses, sizeof(address_t) * (size_t)count);
+    if (array->want_types) {
+        memcpy(array->types + array->count, types, (size_t)count);
+    }
+    array->count += (size_t)count;
+}
+
+// Loads a whole text or binary trace into one array, for runs that replay
+// it many times. types, when not NULL, receives a parallel array of
+// AccessTypes. Returns the number of addresses.
+long long load_trace(const char *filename, int num_parse_threads, address_t **addresses, unsigned char **types) {
+    AddressArray array = { NULL, NULL, types != NULL, 0, 0 };
+    long long count = replay_trace(filename, num_parse_threads, append_chunk, &array);
+    *addresses = array.addresses;
+    if (types != NULL) {
+        *types = array.types;
+    }
+    return count;
+}
@@ -0,0 +1,47 @@
+#ifndef TRACE_STREAM_H
+#define TRACE_STREAM_H
+
+#include <stdio.h>
+#include <pthread.h>
+#include "extract_address_trace.h"
+
+#define TRACE_CHUNK_SIZE 65536 // Addresses per chunk
+#define TRACE_RING_SIZE 8 // Chunks in flight between the parser and the simulator
+
+typedef struct {
+    address_t addresses[TRACE_CHUNK_SIZE];
+    unsigned char types[TRACE_CHUNK_SIZE]; // AccessType of each address
+    int count;
+} TraceChunk;
+
+// A parser thread fills a ring of chunks while the simulator drains it, so
+// memory stays at TRACE_RING_SIZE chunks no matter how long the trace is.
+typedef struct {
+    FILE *file;
+    TraceResolver resolver;
+    int num_parse_threads;
+    TraceChunk ring[TRACE_RING_SIZE];
+    int head;     // Chunk the parser is filling
+    int tail;     // Oldest chunk not yet released by the simulator
+    int filled;   // Chunks published to the simulator (including the one it holds)
+    int holding;  // Simulator is still reading ring[tail]
+    int finished; // Parser reached the end of the file
+    int stop;     // Simulator closed the stream early
+    pthread_t parser;
+    pthread_mutex_t lock;
+    pthread_cond_t chunk_ready;
+    pthread_cond_t slot_free;
+} TraceStream;
+
+// Receives consecutive runs of trace addresses, and the AccessType of
+// each, from replay_trace
+typedef void (*TraceHandler)(void *context, const address_t *addresses, const unsigned char *types, int count);
+
+TraceStream* open_trace_stream(const char *filename);
+TraceStream* open_trace_stream_parallel(const char *filename, int num_parse_threads);
+int next_trace_chunk(TraceStream *stream, const address_t **addresses, const unsigned char **types);
+void close_trace_stream(TraceStream *stream);
+long long replay_trace(const char *filename, int num_parse_threads, TraceHandler handler, void *context);
+long long load_trace(const char *filename, int num_parse_threads, address_t **addresses, unsigned char **types);
+
+#endif // TRACE_STREAM_H
@@ -0,0 +1,211 @@
+#include "workload.h"
+#include "sim_config.h"
+#include "extract_address_trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static const char* workload_names[] = { "sequential", "stride", "randomstride", "uniform", "pointerchase", "zipf" };
+
+const char* workload_name(WorkloadType type) {
+    return workload_names[type];
+}
+
+int parse_workload(const char* name, WorkloadType* type) {
+    for (int i = 0; i < NUM_WORKLOADS; i++) {
+        if (strcmp(name, workload_names[i]) == 0) {
+            *type = (WorkloadType)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void default_workload_config(WorkloadConfig* config, WorkloadType type) {
+    config->type = type;
+    config->accesses = WORKLOAD_ACCESSES;
+    config->footprint = WORKLOAD_FOOTPRINT;
+    config->stride = WORKLOAD_STRIDE_BYTES;
+    config->theta = WORKLOAD_ZIPF_THETA;
+    config->store_percent = WORKLOAD_STORE_PERCENT;
+    config->seed = 1;
+}
+
+// Parses "name[,key=value...]", e.g. "zipf,theta=0.8,footprint=16M". Keys
+// are accesses, footprint, stride, theta, stores (percent) and seed.
+int parse_workload_spec(const char* spec, WorkloadConfig* config) {
+    char buffer[256];
+    strncpy(buffer, spec, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = '\0';
+    char* option = strchr(buffer, ',');
+    if (option != NULL) {
+        *option++ = '\0';
+    }
+    WorkloadType type;
+    if (!parse_workload(buffer, &type)) {
+        fprintf(stderr, "Unknown workload \"%s\" (sequential, stride, randomstride, uniform, pointerchase, zipf)\n", buffer);
+        return 0;
+    }
+    default_workload_config(config, type);
+    for (char* key = option != NULL ? strtok(option, ",") : NULL; key != NULL; key = strtok(NULL, ",")) {
+        char* value = strchr(key, '=');
+        int number = 0;
+        if (value == NULL) {
+            fprintf(stderr, "Expected key=value in workload \"%s\"\n", spec);
+            return 0;
+        }
+        *value++ = '\0';
+        if (strcmp(key, "theta") == 0) {
+            char* end;
+            config->theta = strtod(value, &end);
+            if (end == value || *end != '\0' || config->theta < 0.0 || config->theta >= 1.0) {
+                fprintf(stderr, "Zipf theta must be in [0, 1) in workload \"%s\"\n", spec);
+                return 0;
+            }
+            continue;
+        }
+        if (!parse_size(value, &number)) {
+            fprintf(stderr, "Invalid value for %s in workload \"%s\"\n", key, spec);
+            return 0;
+        }
+        if (strcmp(key, "accesses") == 0) {
+            config->accesses = number;
+        } else if (strcmp(key, "footprint") == 0) {
+            config->footprint = number;
+        } else if (strcmp(key, "stride") == 0) {
+            config->stride = number;
+        } else if (strcmp(key, "stores") == 0) {
+            config->store_percent = number;
+        } else if (strcmp(key, "seed") == 0) {
+            config->seed = (unsigned long long)number;
+        } else {
+            fprintf(stderr, "Unknown workload option \"%s\"\n", key);
+            return 0;
+        }
+    }
+    if (config->footprint < WORKLOAD_LINE || config->stride < 8 || config->store_percent > 100) {
+        fprintf(stderr, "Workload \"%s\" needs a footprint of at least %d bytes, a stride of at least 8 and stores up to 100%%\n",
+                spec, WORKLOAD_LINE);
+        return 0;
+    }
+    return 1;
+}
+
+// splitmix64: fast, and the same sequence on every platform
+static uint64_t next_random(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static double random_unit(uint64_t* state) {
+    return (double)(next_random(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static void* allocate_array(size_t count, size_t size) {
+    void* array = malloc(count * size);
+    if (array == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return array;
+}
+
+// Gray et al.'s constant-time zipfian sampler over ranks 0..n-1
+typedef struct {
+    uint64_t n;
+    double theta;
+    double alpha;
+    double zetan;
+    double eta;
+} ZipfSampler;
+
+static void init_zipf(ZipfSampler* zipf, uint64_t n, double theta) {
+    double zeta2 = 1.0 + pow(0.5, theta);
+    zipf->n = n;
+    zipf->theta = theta;
+    zipf->zetan = 0.0;
+    for (uint64_t i = 1; i <= n; i++) {
+        zipf->zetan += 1.0 / pow((double)i, theta);
+    }
+    zipf->alpha = 1.0 / (1.0 - theta);
+    zipf->eta = (1.0 - pow(2.0 / (double)n, 1.0 - theta)) / (1.0 - zeta2 / zipf->zetan);
+}
+
+static uint64_t sample_zipf(const ZipfSampler* zipf, uint64_t* state) {
+    double u = random_unit(state);
+    double uz = u * zipf->zetan;
+    if (uz < 1.0) {
+        return 0;
+    }
+    if (uz < 1.0 + pow(0.5, zipf->theta)) {
+        return 1;
+    }
+    uint64_t rank = (uint64_t)((double)zipf->n * pow(zipf->eta * u - zipf->eta + 1.0, zipf->alpha));
+    return rank < zipf->n ? rank : zipf->n - 1;
+}
+
+// Fills newly allocated arrays with the workload's addresses and
+// AccessTypes; returns how many.
+long long generate_workload(const WorkloadConfig* config, address_t** addresses, unsigned char** types) {
+    size_t count = (size_t)config->accesses;
+    uint64_t footprint = (uint64_t)config->footprint;
+    uint64_t lines = footprint / WORKLOAD_LINE;
+    uint64_t words = footprint / 8;
+    uint64_t state = config->seed;
+    address_t* out = (address_t*)allocate_array(count > 0 ? count : 1, sizeof(address_t));
+    unsigned char* kinds = (unsigned char*)allocate_array(count > 0 ? count : 1, 1);
+
+    uint32_t* next = NULL;
+    ZipfSampler zipf = { 0, 0.0, 0.0, 0.0, 0.0 };
+    if (config->type == WORKLOAD_POINTER_CHASE) {
+        // Sattolo's shuffle gives a single cycle through every line
+        next = (uint32_t*)allocate_array((size_t)lines, sizeof(uint32_t));
+        for (uint64_t i = 0; i < lines; i++) {
+            next[i] = (uint32_t)i;
+        }
+        for (uint64_t i = lines - 1; i > 0; i--) {
+            uint64_t j = next_random(&state) % i;
+            uint32_t t = next[i];
+            next[i] = next[j];
+            next[j] = t;
+        }
+    } else if (config->type == WORKLOAD_ZIPF) {
+        init_zipf(&zipf, lines, config->theta);
+    }
+
+    uint64_t offset = 0;
+    for (size_t i = 0; i < count; i++) {
+        switch (config->type) {
+            case WORKLOAD_SEQUENTIAL:
+                offset = (uint64_t)i * 8 % footprint;
+                break;
+            case WORKLOAD_STRIDE:
+                offset = (uint64_t)i * (uint64_t)config->stride % footprint;
+                break;
+            case WORKLOAD_RANDOM_STRIDE:
+                offset = (offset + 8 * (1 + next_random(&state) % (uint64_t)(config->stride / 4))) % footprint;
+                break;
+            case WORKLOAD_UNIFORM:
+                offset = next_random(&state) % words * 8;
+                break;
+            case WORKLOAD_POINTER_CHASE:
+                offset = (uint64_t)next[offset / WORKLOAD_LINE] * WORKLOAD_LINE;
+                break;
+            case WORKLOAD_ZIPF:
+                // Scatter the ranks so hot lines do not share sets
+                offset = sample_zipf(&zipf, &state) * 2654435761ULL % lines * WORKLOAD_LINE;
+                break;
+            default:
+                break;
+        }
+        out[i] = (address_t)(WORKLOAD_BASE + offset);
+        kinds[i] = (unsigned char)((int)(next_random(&state) % 100) < config->store_percent ? ACCESS_STORE : ACCESS_LOAD);
+    }
+    free(next);
+    *addresses = out;
+    *types = kinds;
+    return (long long)count;
+}
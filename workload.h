@@ -0,0 +1,41 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include "address.h"
+
+// Defaults of the synthetic workloads
+#define WORKLOAD_ACCESSES 1000000
+#define WORKLOAD_FOOTPRINT (64 * 1024 * 1024) // Bytes the addresses range over
+#define WORKLOAD_BASE 0x10000000
+#define WORKLOAD_STRIDE_BYTES 256
+#define WORKLOAD_ZIPF_THETA 0.99
+#define WORKLOAD_STORE_PERCENT 25
+#define WORKLOAD_LINE 64 // Granularity of pointer chasing and zipfian lines
+
+typedef enum {
+    WORKLOAD_SEQUENTIAL,    // 8-byte words in order
+    WORKLOAD_STRIDE,        // Fixed stride
+    WORKLOAD_RANDOM_STRIDE, // Strides drawn uniformly from 8 to twice the stride
+    WORKLOAD_UNIFORM,       // Uniformly random words
+    WORKLOAD_POINTER_CHASE, // A random cycle through every line
+    WORKLOAD_ZIPF,          // Zipfian popularity over lines: a hot set and a long tail
+    NUM_WORKLOADS
+} WorkloadType;
+
+typedef struct {
+    WorkloadType type;
+    long long accesses;
+    int footprint;     // Bytes, wrapped around
+    int stride;        // Bytes
+    double theta;      // Zipf skew
+    int store_percent; // Accesses that are stores
+    unsigned long long seed;
+} WorkloadConfig;
+
+const char* workload_name(WorkloadType type);
+int parse_workload(const char* name, WorkloadType* type);
+void default_workload_config(WorkloadConfig* config, WorkloadType type);
+int parse_workload_spec(const char* spec, WorkloadConfig* config);
+long long generate_workload(const WorkloadConfig* config, address_t** addresses, unsigned char** types);
+
+#endif // WORKLOAD_H